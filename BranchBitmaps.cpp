@@ -0,0 +1,340 @@
+#include "BranchBitmaps.h"
+
+#include <RevisionsCache.h>
+#include <Revision.h>
+
+#include <QElapsedTimer>
+#include <QHash>
+
+#include <QLogger.h>
+
+#include <algorithm>
+
+using namespace QLogger;
+
+RowBitmap RowBitmap::fromRows(QVector<int> rows)
+{
+   std::sort(rows.begin(), rows.end());
+
+   RowBitmap bitmap;
+
+   for (auto row : qAsConst(rows))
+   {
+      if (!bitmap.mEnds.isEmpty() && row <= bitmap.mEnds.last())
+         bitmap.mEnds.last() = qMax(bitmap.mEnds.last(), row + 1);
+      else
+      {
+         bitmap.mStarts.append(row);
+         bitmap.mEnds.append(row + 1);
+      }
+   }
+
+   return bitmap;
+}
+
+bool RowBitmap::contains(int row) const
+{
+   // the last run starting at or before the row
+   const auto it = std::upper_bound(mStarts.constBegin(), mStarts.constEnd(), row);
+
+   if (it == mStarts.constBegin())
+      return false;
+
+   return row < mEnds.at(static_cast<int>(it - mStarts.constBegin()) - 1);
+}
+
+void RowBitmap::insertRows(int row, int count)
+{
+   QVector<int> starts;
+   QVector<int> ends;
+   starts.reserve(mStarts.count() + 1);
+   ends.reserve(mEnds.count() + 1);
+
+   for (auto i = 0; i < mStarts.count(); ++i)
+   {
+      const auto start = mStarts.at(i);
+      const auto end = mEnds.at(i);
+
+      if (start >= row)
+      {
+         starts.append(start + count);
+         ends.append(end + count);
+      }
+      else if (end > row)
+      {
+         // the new rows split the run in two
+         starts.append(start);
+         ends.append(row);
+         starts.append(row + count);
+         ends.append(end + count);
+      }
+      else
+      {
+         starts.append(start);
+         ends.append(end);
+      }
+   }
+
+   mStarts = starts;
+   mEnds = ends;
+}
+
+BranchBitmaps::BranchBitmaps(RevisionsCache *cache, QObject *parent)
+   : QObject(parent)
+   , mCache(cache)
+{
+   mTimer.setSingleShot(true);
+   mTimer.setInterval(0);
+   connect(&mTimer, &QTimer::timeout, this, &BranchBitmaps::build);
+}
+
+void BranchBitmaps::clear()
+{
+   mTimer.stop();
+   mEntries.clear();
+   mPending = 0;
+   mParentStart.clear();
+   mParentRows.clear();
+   stopWalk();
+}
+
+void BranchBitmaps::setBranches(const QVector<Branch> &branches)
+{
+   QHash<QString, int> previous;
+
+   for (auto i = 0; i < mEntries.count(); ++i)
+      previous.insert(mEntries.at(i).branch.name, i);
+
+   QVector<Entry> entries;
+   entries.reserve(branches.count());
+   mPending = 0;
+
+   for (const auto &branch : branches)
+   {
+      Entry entry;
+      entry.branch = branch;
+
+      // a branch that did not move keeps its rows
+      const auto it = previous.constFind(branch.name);
+
+      if (it != previous.constEnd())
+      {
+         const auto &old = mEntries.at(it.value());
+
+         if (old.valid && old.branch.sha == branch.sha && old.branch.remote == branch.remote)
+         {
+            entry.rows = old.rows;
+            entry.valid = true;
+         }
+      }
+
+      if (!entry.valid)
+         ++mPending;
+
+      entries.append(entry);
+   }
+
+   mEntries = entries;
+   stopWalk();
+}
+
+void BranchBitmaps::insertRows(int row, int count)
+{
+   if (count <= 0)
+      return;
+
+   // new commits are never ancestors of the known ones, so the
+   // branches that did not move only see their rows shifted
+   for (auto &entry : mEntries)
+      if (entry.valid)
+         entry.rows.insertRows(row, count);
+
+   stopWalk();
+
+   // a table still being built is simply finished later with the new rows
+   if (mParentStart.count() - 1 != mCache->count() - count)
+   {
+      mParentStart.clear();
+      mParentRows.clear();
+      return;
+   }
+
+   // the parent rows of the known ones only shift, the new rows are added
+   for (auto &parent : mParentRows)
+      if (parent >= row)
+         parent += count;
+
+   QVector<int> parents;
+
+   for (auto i = row; i < row + count; ++i)
+      appendParentRows(i, parents);
+
+   QVector<int> starts;
+   starts.reserve(count);
+
+   const auto offset = mParentStart.at(row);
+   auto added = 0;
+
+   for (auto i = row; i < row + count; ++i)
+   {
+      starts.append(offset + added);
+      added += static_cast<int>(mCache->revLookup(i)->parentsCount());
+   }
+
+   for (auto i = row; i < mParentStart.count(); ++i)
+      mParentStart[i] += added;
+
+   mParentStart.insert(row, count, 0);
+   std::copy(starts.constBegin(), starts.constEnd(), mParentStart.begin() + row);
+   mParentRows.insert(offset, added, -1);
+   std::copy(parents.constBegin(), parents.constEnd(), mParentRows.begin() + offset);
+}
+
+void BranchBitmaps::start()
+{
+   // rows loaded or dropped behind our back make everything stale
+   if (!mParentStart.isEmpty() && mParentStart.count() - 1 != mCache->count())
+      invalidateAll();
+
+   // a stale parent table alone is enough to have queries fall back to git
+   if (mPending > 0 || mParentStart.count() - 1 != mCache->count())
+      mTimer.start();
+}
+
+bool BranchBitmaps::branchesContaining(int row, QVector<Branch> &branches) const
+{
+   branches.clear();
+
+   if (!isComplete() || mParentStart.count() - 1 != mCache->count())
+      return false;
+
+   for (const auto &entry : mEntries)
+      if (entry.rows.contains(row))
+         branches.append(entry.branch);
+
+   return true;
+}
+
+void BranchBitmaps::build()
+{
+   QElapsedTimer elapsed;
+   elapsed.start();
+
+   if (!mParentStart.isEmpty() && mParentStart.count() - 1 > mCache->count())
+      invalidateAll();
+
+   if (!buildParentRows(elapsed))
+   {
+      mTimer.start();
+      return;
+   }
+
+   while (mPending > 0 && elapsed.elapsed() < SLICE_MS)
+   {
+      if (mCurrent == -1)
+      {
+         const auto it = std::find_if(mEntries.constBegin(), mEntries.constEnd(),
+                                      [](const Entry &entry) { return !entry.valid; });
+         const auto current = static_cast<int>(it - mEntries.constBegin());
+         const auto tip = mCache->row(it->branch.sha);
+
+         // the tip is not in the loaded history, nothing to contain
+         if (tip == -1)
+         {
+            mEntries[current].rows = RowBitmap();
+            mEntries[current].valid = true;
+            --mPending;
+            continue;
+         }
+
+         mCurrent = current;
+         mVisited.resize(mCache->count());
+         mVisited[tip] = ++mWalk;
+         mStack = { tip };
+         mReached.clear();
+      }
+
+      if (walk(elapsed))
+      {
+         mEntries[mCurrent].rows = RowBitmap::fromRows(mReached);
+         mEntries[mCurrent].valid = true;
+         --mPending;
+         stopWalk();
+      }
+   }
+
+   if (mPending > 0)
+      mTimer.start();
+   else
+      QLog_Debug("Git", QString("Reachability bitmaps of %1 branches built").arg(mEntries.count()));
+}
+
+bool BranchBitmaps::buildParentRows(const QElapsedTimer &elapsed)
+{
+   if (mParentStart.isEmpty())
+      mParentStart.append(0);
+
+   for (auto row = mParentStart.count() - 1; row < mCache->count(); ++row)
+   {
+      appendParentRows(row, mParentRows);
+      mParentStart.append(mParentRows.count());
+
+      if (row % 1024 == 0 && elapsed.elapsed() >= SLICE_MS)
+         return false;
+   }
+
+   return true;
+}
+
+void BranchBitmaps::appendParentRows(int row, QVector<int> &parents) const
+{
+   const auto count = static_cast<int>(mCache->revLookup(row)->parentsCount());
+
+   for (auto i = 0; i < count; ++i)
+      parents.append(mCache->commitRow(mCache->parentId(row, i)));
+}
+
+bool BranchBitmaps::walk(const QElapsedTimer &elapsed)
+{
+   auto steps = 0;
+
+   while (!mStack.isEmpty())
+   {
+      const auto row = mStack.takeLast();
+      mReached.append(row);
+
+      for (auto i = mParentStart.at(row); i < mParentStart.at(row + 1); ++i)
+      {
+         const auto parent = mParentRows.at(i);
+
+         if (parent != -1 && mVisited.at(parent) != mWalk)
+         {
+            mVisited[parent] = mWalk;
+            mStack.append(parent);
+         }
+      }
+
+      if (++steps % 1024 == 0 && elapsed.elapsed() >= SLICE_MS)
+         return false;
+   }
+
+   return true;
+}
+
+void BranchBitmaps::invalidateAll()
+{
+   for (auto &entry : mEntries)
+      entry.valid = false;
+
+   mPending = mEntries.count();
+   mParentStart.clear();
+   mParentRows.clear();
+   stopWalk();
+}
+
+void BranchBitmaps::stopWalk()
+{
+   mCurrent = -1;
+   mStack.clear();
+   mReached.clear();
+}
@@ -0,0 +1,114 @@
+#pragma once
+
+/****************************************************************************************
+ ** GitQlient is an application to manage and operate one or several Git repositories. With
+ ** GitQlient you will be able to add commits, branches and manage all the options Git provides.
+ ** Copyright (C) 2019  Francesc Martinez
+ **
+ ** LinkedIn: www.linkedin.com/in/cescmm/
+ ** Web: www.francescmm.com
+ **
+ ** This program is free software; you can redistribute it and/or
+ ** modify it under the terms of the GNU Lesser General Public
+ ** License as published by the Free Software Foundation; either
+ ** version 2 of the License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ ** Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public
+ ** License along with this library; if not, write to the Free Software
+ ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***************************************************************************************/
+
+
+#include <QObject>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+class QElapsedTimer;
+class RevisionsCache;
+
+/* Rows of RevisionsCache as a compressed bitmap: the sorted runs of
+ * consecutive rows it holds. The history reachable from a branch is
+ * mostly made of long runs, so a probe is a binary search over a few of
+ * them.
+ */
+class RowBitmap
+{
+public:
+   static RowBitmap fromRows(QVector<int> rows);
+
+   bool contains(int row) const;
+   void insertRows(int row, int count);
+   int runs() const { return mStarts.count(); }
+
+private:
+   QVector<int> mStarts;
+   QVector<int> mEnds; // one past the last row of each run
+};
+
+/* The rows reachable from every branch, one RowBitmap each, so that the
+ * branches containing a commit are known without asking git. They are
+ * built in small steps once the revisions are loaded. New refs only
+ * invalidate the branches that moved, and rows inserted on top by a
+ * refresh shift the other bitmaps and the parent table instead of
+ * rebuilding them.
+ */
+class BranchBitmaps : public QObject
+{
+   Q_OBJECT
+
+public:
+   struct Branch
+   {
+      QString name;
+      QString sha;
+      bool remote = false;
+   };
+
+   explicit BranchBitmaps(RevisionsCache *cache, QObject *parent = nullptr);
+
+   void clear();
+   void setBranches(const QVector<Branch> &branches);
+   void insertRows(int row, int count);
+   void start();
+   bool isComplete() const { return mPending == 0; }
+   bool branchesContaining(int row, QVector<Branch> &branches) const;
+
+private:
+   static const int SLICE_MS = 8; // time budget of each building step
+
+   struct Entry
+   {
+      Branch branch;
+      RowBitmap rows;
+      bool valid = false;
+   };
+
+   RevisionsCache *mCache = nullptr;
+   QVector<Entry> mEntries;
+   int mPending = 0;
+   QTimer mTimer;
+
+   // parent rows of every row, -1 for the ones not loaded
+   QVector<int> mParentStart;
+   QVector<int> mParentRows;
+
+   // the walk in progress
+   int mCurrent = -1;
+   QVector<int> mStack;
+   QVector<int> mReached;
+   QVector<int> mVisited;
+   int mWalk = 0;
+
+   void build();
+   bool buildParentRows(const QElapsedTimer &elapsed);
+   void appendParentRows(int row, QVector<int> &parents) const;
+   bool walk(const QElapsedTimer &elapsed);
+   void invalidateAll();
+   void stopWalk();
+};
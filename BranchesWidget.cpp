@@ -2,11 +2,13 @@
 
 #include <BranchTreeWidget.h>
 #include <git.h>
+#include <GitCommandPool.h>
 #include <BranchesViewDelegate.h>
 #include <ClickableFrame.h>
 #include <AddSubmoduleDlg.h>
 
 #include <QApplication>
+#include <QElapsedTimer>
 #include <QVBoxLayout>
 #include <QHeaderView>
 #include <QListWidget>
@@ -179,6 +181,11 @@ BranchesWidget::BranchesWidget(QSharedPointer<Git> git, QWidget *parent)
    connect(tagsFrame, &ClickableFrame::clicked, this, &BranchesWidget::onTagsHeaderClicked);
    connect(stashFrame, &ClickableFrame::clicked, this, &BranchesWidget::onStashesHeaderClicked);
    connect(submoduleFrame, &ClickableFrame::clicked, this, &BranchesWidget::onSubmodulesHeaderClicked);
+
+   mDistancesTimer.setSingleShot(true);
+   mDistancesTimer.setInterval(0);
+   connect(&mDistancesTimer, &QTimer::timeout, this, &BranchesWidget::updateBranchDistances);
+   connect(mGit.get(), &Git::loadCompleted, this, &BranchesWidget::onRevisionsLoaded);
 }
 
 void BranchesWidget::showBranches()
@@ -187,48 +194,70 @@ void BranchesWidget::showBranches()
 
    clear();
 
-   QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
-   auto ret = mGit->getBranches();
+   // all the sections are requested at once and filled in as their
+   // commands finish, results of a previous request are discarded
+   const auto generation = mGeneration;
+
+   GitCommandPool::then(mGit->getBranches(), this, [this, generation](const GitExecResult &ret) {
+      if (generation == mGeneration && ret.success)
+         processBranches(ret.output.toString());
+   });
+
+   const QVector<QFuture<QVector<QString>>> tags { mGit->getTags(), mGit->getLocalTags() };
+   GitCommandPool::whenAll(tags, this, [this, generation](const QVector<QVector<QString>> &ret) {
+      if (generation == mGeneration)
+         processTags(ret.at(0), ret.at(1));
+   });
+
+   GitCommandPool::then(mGit->getStashes(), this, [this, generation](const QVector<QString> &stashes) {
+      if (generation == mGeneration)
+         processStashes(stashes);
+   });
+
+   GitCommandPool::then(mGit->getSubmodules(), this, [this, generation](const QVector<QString> &submodules) {
+      if (generation == mGeneration)
+         processSubmodules(submodules);
+   });
+}
 
-   if (ret.success)
+void BranchesWidget::processBranches(QString output)
+{
+   if (output.startsWith("fatal"))
+      return;
+
+   output.replace(' ', "");
+   const auto branches = output.split('\n');
+
+   QLog_Info("UI", QString("Fetched {%1} branches").arg(branches.count()));
+   QLog_Info("UI", QString("Processing branches..."));
+
+   mRemoteBranchesTree->addTopLevelItem(new QTreeWidgetItem({ "origin" }));
+
+   for (auto branch : branches)
    {
-      auto output = ret.output.toString();
-      if (!output.startsWith("fatal"))
+      if (!branch.isEmpty())
       {
-         output.replace(' ', "");
-         const auto branches = output.split('\n');
-
-         QLog_Info("UI", QString("Fetched {%1} branches").arg(branches.count()));
-         QLog_Info("UI", QString("Processing branches..."));
-
-         mRemoteBranchesTree->addTopLevelItem(new QTreeWidgetItem({ "origin" }));
-
-         for (auto branch : branches)
-         {
-            if (!branch.isEmpty())
-            {
-               if (branch.startsWith("remotes/") && !branch.contains("HEAD->"))
-                  processRemoteBranch(branch);
-               else if (!branch.contains("HEAD->"))
-                  processLocalBranch(branch);
-            }
-         }
-
-         QLog_Info("UI", QString("... branches processed"));
+         if (branch.startsWith("remotes/") && !branch.contains("HEAD->"))
+            processRemoteBranch(branch);
+         else if (!branch.contains("HEAD->"))
+            processLocalBranch(branch);
       }
+   }
 
-      processTags();
-      processStashes();
-      processSubmodules();
+   QLog_Info("UI", QString("... branches processed"));
 
-      QApplication::restoreOverrideCursor();
+   adjustBranchesTree(mLocalBranchesTree);
 
-      adjustBranchesTree(mLocalBranchesTree);
-   }
+   // distances are filled in later, once the revisions are loaded
+   mDistancesTimer.start();
 }
 
 void BranchesWidget::clear()
 {
+   ++mGeneration;
+   mDistancesTimer.stop();
+   mPendingDistances.clear();
+
    blockSignals(true);
    mLocalBranchesTree->clear();
    mRemoteBranchesTree->clear();
@@ -278,29 +307,50 @@ void BranchesWidget::processLocalBranch(QString branch)
    item->setData(0, Qt::UserRole + 1, fullBranchName);
    item->setData(0, Qt::UserRole + 2, true);
 
-   QLog_Debug("UI", QString("Calculating distances..."));
+   mLocalBranchesTree->addTopLevelItem(item);
+   mPendingDistances.append(item);
+
+   QLog_Debug("UI", QString("Finish gathering local branch information"));
+}
 
-   auto distance = mGit->getDistanceBetweenBranches(true, branch).output.toString();
-   distance.replace('\n', "");
-   distance.replace('\t', "\u2193 - ");
-   distance.append("\u2191");
-   item->setText(1, distance);
+void BranchesWidget::updateBranchDistances()
+{
+   // distances are computed on the loaded graph, a few branches at a time
+   // so that the GUI stays responsive with hundreds of them
+   if (mGit->isLoadingRevs())
+      return; // resumed when loading completes
 
-   distance = mGit->getDistanceBetweenBranches(false, branch).output.toString();
+   const auto masterSha = mGit->getRefSha("origin/master", Git::RMT_BRANCH, false);
+   QElapsedTimer elapsed;
+   elapsed.start();
 
-   if (!distance.contains("fatal"))
+   while (!mPendingDistances.isEmpty() && elapsed.elapsed() < 10)
    {
-      distance.replace('\n', "");
-      distance.append("\u2191");
-   }
-   else
-      distance = "Local";
+      const auto item = mPendingDistances.takeFirst();
+      const auto branch = item->data(0, Qt::UserRole + 1).toString();
+      const auto sha = mGit->getRefSha(branch, Git::BRANCH, false);
+      int ahead = 0;
+      int behind = 0;
 
-   item->setText(2, distance);
+      if (mGit->getDistanceBetweenCommits(masterSha, sha, behind, ahead))
+         item->setText(1, QString("%1\u2193 - %2\u2191").arg(behind).arg(ahead));
 
-   mLocalBranchesTree->addTopLevelItem(item);
+      const auto originSha = mGit->getRefSha(QString("origin/%1").arg(branch), Git::RMT_BRANCH, false);
 
-   QLog_Debug("UI", QString("Finish gathering local branch information"));
+      if (!originSha.isEmpty() && mGit->getDistanceBetweenCommits(originSha, sha, behind, ahead))
+         item->setText(2, QString("%1\u2191").arg(behind + ahead));
+      else
+         item->setText(2, "Local");
+   }
+
+   if (!mPendingDistances.isEmpty())
+      mDistancesTimer.start();
+}
+
+void BranchesWidget::onRevisionsLoaded()
+{
+   if (!mPendingDistances.isEmpty())
+      mDistancesTimer.start();
 }
 
 void BranchesWidget::processRemoteBranch(QString branch)
@@ -338,11 +388,8 @@ void BranchesWidget::processRemoteBranch(QString branch)
    // mRemoteBranchesTree->addTopLevelItem(item);
 }
 
-void BranchesWidget::processTags()
+void BranchesWidget::processTags(const QVector<QString> &tags, const QVector<QString> &localTags)
 {
-   const auto tags = mGit->getTags();
-   const auto localTags = mGit->getLocalTags();
-
    QLog_Info("UI", QString("Fetching {%1} tags").arg(tags.count()));
 
    for (auto tag : tags)
@@ -364,10 +411,8 @@ void BranchesWidget::processTags()
    mTagsCount->setText(QString("(%1)").arg(tags.count()));
 }
 
-void BranchesWidget::processStashes()
+void BranchesWidget::processStashes(const QVector<QString> &stashes)
 {
-   const auto stashes = mGit->getStashes();
-
    QLog_Info("UI", QString("Fetching {%1} stashes").arg(stashes.count()));
 
    for (auto stash : stashes)
@@ -382,10 +427,8 @@ void BranchesWidget::processStashes()
    mStashesCount->setText(QString("(%1)").arg(stashes.count()));
 }
 
-void BranchesWidget::processSubmodules()
+void BranchesWidget::processSubmodules(const QVector<QString> &submodules)
 {
-   const auto submodules = mGit->getSubmodules();
-
    QLog_Info("UI", QString("Fetching {%1} submodules").arg(submodules.count()));
 
    for (auto submodule : submodules)
@@ -23,11 +23,13 @@
  ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  ***************************************************************************************/
 
+#include <QTimer>
 #include <QWidget>
 
 class BranchTreeWidget;
 class QListWidget;
 class QListWidgetItem;
+class QTreeWidgetItem;
 class QLabel;
 class Git;
 
@@ -58,12 +60,18 @@ private:
    QLabel *mStashesArrow = nullptr;
    QLabel *mSubmodulesCount = nullptr;
    QLabel *mSubmodulesArrow = nullptr;
+   QVector<QTreeWidgetItem *> mPendingDistances;
+   QTimer mDistancesTimer;
+   int mGeneration = 0;
 
+   void processBranches(QString output);
    void processLocalBranch(QString branch);
+   void updateBranchDistances();
+   void onRevisionsLoaded();
    void processRemoteBranch(QString branch);
-   void processTags();
-   void processStashes();
-   void processSubmodules();
+   void processTags(const QVector<QString> &tags, const QVector<QString> &localTags);
+   void processStashes(const QVector<QString> &stashes);
+   void processSubmodules(const QVector<QString> &submodules);
    void adjustBranchesTree(BranchTreeWidget *treeWidget);
    void showTagsContextMenu(const QPoint &p);
    void showStashesContextMenu(const QPoint &p);
@@ -0,0 +1,237 @@
+#include "ChangedPathFilters.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+#include <QSet>
+
+namespace
+{
+const quint32 kMagic = 0xA0B0C0D3;
+const qint32 kVersion = 1;
+const quint32 kSeed1 = 0x293ae76f;
+const quint32 kSeed2 = 0x7e646e2c;
+
+quint32 rotl(quint32 value, int shift)
+{
+   return (value << shift) | (value >> (32 - shift));
+}
+
+quint32 murmur3(quint32 seed, const QByteArray &data)
+{
+   const quint32 c1 = 0xcc9e2d51;
+   const quint32 c2 = 0x1b873593;
+   const auto bytes = reinterpret_cast<const uchar *>(data.constData());
+   const auto len = data.size();
+   const auto blocks = len / 4;
+
+   auto hash = seed;
+
+   for (auto i = 0; i < blocks; ++i)
+   {
+      const auto block = bytes + i * 4;
+      auto k = static_cast<quint32>(block[0]) | (static_cast<quint32>(block[1]) << 8)
+          | (static_cast<quint32>(block[2]) << 16) | (static_cast<quint32>(block[3]) << 24);
+
+      k = rotl(k * c1, 15) * c2;
+      hash = rotl(hash ^ k, 13) * 5 + 0xe6546b64;
+   }
+
+   const auto tail = bytes + blocks * 4;
+   quint32 k = 0;
+
+   switch (len & 3)
+   {
+      case 3:
+         k ^= static_cast<quint32>(tail[2]) << 16;
+         [[fallthrough]];
+      case 2:
+         k ^= static_cast<quint32>(tail[1]) << 8;
+         [[fallthrough]];
+      case 1:
+         k ^= tail[0];
+         hash ^= rotl(k * c1, 15) * c2;
+         break;
+      default:
+         break;
+   }
+
+   hash ^= static_cast<quint32>(len);
+   hash ^= hash >> 16;
+   hash *= 0x85ebca6b;
+   hash ^= hash >> 13;
+   hash *= 0xc2b2ae35;
+   hash ^= hash >> 16;
+
+   return hash;
+}
+}
+
+const QString ChangedPathFilters::kFileName = QString("qgit_path_filters.dat");
+
+ChangedPathFilters::ChangedPathFilters(const QString &gitDir)
+   : mPath(QString("%1/%2").arg(gitDir, kFileName))
+{
+}
+
+bool ChangedPathFilters::load()
+{
+   QFile f(mPath);
+
+   if (!f.exists() || !f.open(QIODevice::ReadOnly))
+      return false;
+
+   QDataStream stream(&f);
+   quint32 magic;
+   qint32 version;
+   stream >> magic;
+   stream >> version;
+
+   if (magic != kMagic || version != kVersion)
+      return false;
+
+   QHash<QByteArray, QByteArray> filters;
+   stream >> filters;
+
+   if (stream.status() != QDataStream::Ok)
+      return false;
+
+   mFilters = filters;
+   mDirty = false;
+
+   return true;
+}
+
+bool ChangedPathFilters::save()
+{
+   const auto tmpPath = QString("%1.bak").arg(mPath);
+
+   QFile f(tmpPath);
+   if (!f.open(QIODevice::WriteOnly))
+      return false;
+
+   QDataStream stream(&f);
+   stream << kMagic;
+   stream << kVersion;
+   stream << mFilters;
+
+   f.close();
+
+   QDir dir;
+
+   if (f.error() != QFileDevice::NoError || (dir.exists(mPath) && !dir.remove(mPath)))
+   {
+      dir.remove(tmpPath);
+      return false;
+   }
+
+   if (!dir.rename(tmpPath, mPath))
+      return false;
+
+   mDirty = false;
+
+   return true;
+}
+
+bool ChangedPathFilters::contains(const QString &sha) const
+{
+   return mFilters.contains(QByteArray::fromHex(sha.toLatin1()));
+}
+
+void ChangedPathFilters::insert(const QString &sha, const QStringList &paths)
+{
+   // a file changed in a directory changes the directory too
+   QSet<QByteArray> entries;
+
+   for (const auto &path : paths)
+   {
+      auto entry = path.toUtf8();
+
+      while (!entry.isEmpty() && !entries.contains(entry))
+      {
+         entries.insert(entry);
+         entry.truncate(qMax(entry.lastIndexOf('/'), 0));
+      }
+   }
+
+   QByteArray filter;
+
+   if (entries.count() > MAX_PATHS)
+      filter = QByteArray(1, static_cast<char>(0xff));
+   else if (!entries.isEmpty())
+   {
+      filter = QByteArray((entries.count() * BITS_PER_PATH + 7) / 8, 0);
+      const auto data = reinterpret_cast<uchar *>(filter.data());
+      const auto bits = static_cast<quint32>(filter.size()) * 8;
+
+      for (const auto &entry : qAsConst(entries))
+      {
+         const auto k = key(entry);
+
+         for (quint32 i = 0; i < HASHES; ++i)
+         {
+            const auto bit = (k.first + i * k.second) % bits;
+            data[bit / 8] |= static_cast<uchar>(1 << (bit % 8));
+         }
+      }
+   }
+
+   mFilters.insert(QByteArray::fromHex(sha.toLatin1()), filter);
+   mDirty = true;
+}
+
+ChangedPathFilters::Match ChangedPathFilters::test(const QString &sha, const QVector<Key> &keys) const
+{
+   const auto it = mFilters.constFind(QByteArray::fromHex(sha.toLatin1()));
+
+   if (it == mFilters.constEnd())
+      return Match::UNKNOWN;
+
+   // the path and all its leading directories must be there
+   for (const auto &k : keys)
+      if (!mayContain(it.value(), k))
+         return Match::NO;
+
+   return Match::MAYBE;
+}
+
+QVector<ChangedPathFilters::Key> ChangedPathFilters::keys(const QString &path)
+{
+   QVector<Key> keys;
+   auto entry = path.toUtf8();
+
+   while (entry.endsWith('/'))
+      entry.chop(1);
+
+   while (!entry.isEmpty())
+   {
+      keys.append(key(entry));
+      entry.truncate(qMax(entry.lastIndexOf('/'), 0));
+   }
+
+   return keys;
+}
+
+ChangedPathFilters::Key ChangedPathFilters::key(const QByteArray &path)
+{
+   return qMakePair(murmur3(kSeed1, path), murmur3(kSeed2, path));
+}
+
+bool ChangedPathFilters::mayContain(const QByteArray &filter, const Key &key)
+{
+   if (filter.isEmpty())
+      return false;
+
+   const auto data = reinterpret_cast<const uchar *>(filter.constData());
+   const auto bits = static_cast<quint32>(filter.size()) * 8;
+
+   for (quint32 i = 0; i < HASHES; ++i)
+   {
+      const auto bit = (key.first + i * key.second) % bits;
+
+      if (!(data[bit / 8] & (1 << (bit % 8))))
+         return false;
+   }
+
+   return true;
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+/****************************************************************************************
+ ** GitQlient is an application to manage and operate one or several Git repositories. With
+ ** GitQlient you will be able to add commits, branches and manage all the options Git provides.
+ ** Copyright (C) 2019  Francesc Martinez
+ **
+ ** LinkedIn: www.linkedin.com/in/cescmm/
+ ** Web: www.francescmm.com
+ **
+ ** This program is free software; you can redistribute it and/or
+ ** modify it under the terms of the GNU Lesser General Public
+ ** License as published by the Free Software Foundation; either
+ ** version 2 of the License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ ** Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public
+ ** License along with this library; if not, write to the Free Software
+ ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***************************************************************************************/
+
+
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+#include <QStringList>
+#include <QVector>
+
+/* Changed-path Bloom filters, one per commit, built from the files each
+ * commit changes and saved next to the file list cache. Same parameters as
+ * the ones of git's commit-graph: 10 bits per path, 7 hashes from two
+ * murmur3 seeds, and every leading directory of a path added as a path on
+ * its own. A filter says for sure that a commit does not touch a path, a
+ * match still has to be confirmed with the real file list.
+ */
+class ChangedPathFilters
+{
+public:
+   enum class Match
+   {
+      NO,
+      MAYBE,
+      UNKNOWN
+   };
+
+   using Key = QPair<quint32, quint32>;
+
+   explicit ChangedPathFilters(const QString &gitDir);
+
+   bool load();
+   bool save();
+   bool isDirty() const { return mDirty; }
+   int count() const { return mFilters.count(); }
+   bool contains(const QString &sha) const;
+   void insert(const QString &sha, const QStringList &paths);
+   Match test(const QString &sha, const QVector<Key> &keys) const;
+
+   static QVector<Key> keys(const QString &path);
+
+   static const QString kFileName;
+
+private:
+   static const int BITS_PER_PATH = 10;
+   static const int HASHES = 7;
+   static const int MAX_PATHS = 512; // more changes than this match anything
+
+   QString mPath;
+   QHash<QByteArray, QByteArray> mFilters;
+   bool mDirty = false;
+
+   static Key key(const QByteArray &path);
+   static bool mayContain(const QByteArray &filter, const Key &key);
+};
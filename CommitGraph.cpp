@@ -0,0 +1,342 @@
+#include "CommitGraph.h"
+
+#include <RevisionsCache.h>
+#include <Revision.h>
+
+#include <QFile>
+#include <QtEndian>
+
+#include <QLogger.h>
+
+#include <cstring>
+#include <limits>
+#include <queue>
+#include <utility>
+
+using namespace QLogger;
+
+namespace
+{
+const quint32 kSignature = 0x43475048; // "CGPH"
+const quint32 kChunkFanout = 0x4f494446; // "OIDF"
+const quint32 kChunkOidLookup = 0x4f49444c; // "OIDL"
+const quint32 kChunkCommitData = 0x43444154; // "CDAT"
+const quint32 kChunkExtraEdges = 0x45444745; // "EDGE"
+const quint32 kParentNone = 0x70000000;
+const quint32 kParentExtraEdges = 0x80000000;
+const quint32 kLastEdge = 0x80000000;
+const int kHeaderSize = 8;
+const int kChunkEntrySize = 12;
+const int kFanoutSize = 256 * 4;
+}
+
+const QString CommitGraph::kFileName = QString("objects/info/commit-graph");
+
+CommitGraph::CommitGraph(const QString &gitDir)
+   : mPath(QString("%1/%2").arg(gitDir, kFileName))
+{
+}
+
+CommitGraph::~CommitGraph()
+{
+   // closing the file unmaps it
+   delete mFile;
+}
+
+bool CommitGraph::load()
+{
+   mFile = new QFile(mPath);
+
+   if (!mFile->exists() || !mFile->open(QIODevice::ReadOnly))
+      return false;
+
+   const auto fileSize = mFile->size();
+
+   if (fileSize < kHeaderSize + kChunkEntrySize || fileSize > std::numeric_limits<int>::max())
+      return false;
+
+   mData = mFile->map(0, fileSize);
+
+   if (!mData)
+      return false;
+
+   mSize = static_cast<int>(fileSize);
+
+   // signature, version, hash version, chunks count and base graphs count
+   const auto chunks = static_cast<int>(mData[6]);
+
+   if (qFromBigEndian<quint32>(mData) != kSignature || mData[4] != 1 || mData[5] != 1 || mData[7] != 0)
+   {
+      QLog_Info("Git", "Unsupported commit-graph file format");
+      return false;
+   }
+
+   if (kHeaderSize + (chunks + 1) * kChunkEntrySize > mSize)
+      return false;
+
+   // each chunk ends where the next one starts, the table has one
+   // more entry to give where the last one ends
+   quint64 oidsSize = 0;
+   quint64 commitDataSize = 0;
+
+   for (auto i = 0; i < chunks; ++i)
+   {
+      const auto entry = mData + kHeaderSize + i * kChunkEntrySize;
+      const auto offset = qFromBigEndian<quint64>(entry + 4);
+      const auto end = qFromBigEndian<quint64>(entry + kChunkEntrySize + 4);
+
+      if (offset > end || end > static_cast<quint64>(mSize))
+         return false;
+
+      const auto chunk = mData + offset;
+      const auto chunkSize = end - offset;
+
+      switch (qFromBigEndian<quint32>(entry))
+      {
+         case kChunkFanout:
+            if (chunkSize != kFanoutSize)
+               return false;
+            mFanout = chunk;
+            break;
+         case kChunkOidLookup:
+            mOids = chunk;
+            oidsSize = chunkSize;
+            break;
+         case kChunkCommitData:
+            mCommitData = chunk;
+            commitDataSize = chunkSize;
+            break;
+         case kChunkExtraEdges:
+            mExtraEdges = chunk;
+            mExtraEdgesCount = static_cast<quint32>(chunkSize / 4);
+            break;
+         default:
+            break;
+      }
+   }
+
+   if (!mFanout || !mOids || !mCommitData)
+      return false;
+
+   mCount = qFromBigEndian<quint32>(mFanout + kFanoutSize - 4);
+
+   return oidsSize >= static_cast<quint64>(mCount) * OID_SIZE
+       && commitDataSize >= static_cast<quint64>(mCount) * COMMIT_DATA_SIZE;
+}
+
+bool CommitGraph::contains(const QString &sha) const
+{
+   return mFanout && position(QByteArray::fromHex(sha.toLatin1())) != -1;
+}
+
+int CommitGraph::position(const QByteArray &oid) const
+{
+   if (oid.size() != OID_SIZE)
+      return -1;
+
+   // the fanout gives the range of ids starting with the same byte
+   const auto first = static_cast<uchar>(oid.at(0));
+   auto lo = first == 0 ? 0u : qFromBigEndian<quint32>(mFanout + (first - 1) * 4);
+   auto hi = qMin(qFromBigEndian<quint32>(mFanout + first * 4), mCount);
+
+   while (lo < hi)
+   {
+      const auto mid = lo + (hi - lo) / 2;
+      const auto cmp = memcmp(mOids + mid * OID_SIZE, oid.constData(), OID_SIZE);
+
+      if (cmp == 0)
+         return static_cast<int>(mid);
+
+      if (cmp < 0)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   return -1;
+}
+
+bool CommitGraph::parents(quint32 pos, QVector<quint32> &parents) const
+{
+   parents.clear();
+
+   const auto data = mCommitData + pos * COMMIT_DATA_SIZE + OID_SIZE;
+   const auto first = qFromBigEndian<quint32>(data);
+   const auto second = qFromBigEndian<quint32>(data + 4);
+
+   if (first == kParentNone)
+      return true;
+
+   if (first >= mCount)
+      return false;
+
+   parents.append(first);
+
+   if (second == kParentNone)
+      return true;
+
+   if (!(second & kParentExtraEdges))
+   {
+      if (second >= mCount)
+         return false;
+
+      parents.append(second);
+      return true;
+   }
+
+   // octopus merges list all the parents but the first in the extra edges
+   for (auto edge = second & ~kParentExtraEdges; edge < mExtraEdgesCount; ++edge)
+   {
+      const auto value = qFromBigEndian<quint32>(mExtraEdges + edge * 4);
+      const auto parent = value & ~kLastEdge;
+
+      if (parent >= mCount)
+         return false;
+
+      parents.append(parent);
+
+      if (value & kLastEdge)
+         return true;
+   }
+
+   return false;
+}
+
+quint64 CommitGraph::commitDate(quint32 pos) const
+{
+   // 30 bits of generation number followed by 34 bits of date
+   const auto data = mCommitData + pos * COMMIT_DATA_SIZE + OID_SIZE + 8;
+
+   return (static_cast<quint64>(qFromBigEndian<quint32>(data) & 0x3) << 32) | qFromBigEndian<quint32>(data + 4);
+}
+
+bool CommitGraph::appendTo(RevisionsCache *cache, const QStringList &tips)
+{
+   if (!mFanout)
+      return false;
+
+   // walk the commits reachable from the tips, counting for each
+   // one how many children it has to wait for before being shown
+   QVector<bool> reached(static_cast<int>(mCount), false);
+   QVector<int> pendingChildren(static_cast<int>(mCount), 0);
+   QVector<quint32> reachable;
+   QVector<quint32> stack;
+   QVector<quint32> commitParents;
+
+   for (const auto &tip : tips)
+   {
+      const auto pos = position(QByteArray::fromHex(tip.toLatin1()));
+
+      if (pos != -1 && !reached.at(pos))
+      {
+         reached[pos] = true;
+         stack.append(static_cast<quint32>(pos));
+      }
+   }
+
+   while (!stack.isEmpty())
+   {
+      const auto pos = stack.takeLast();
+      reachable.append(pos);
+
+      if (!parents(pos, commitParents))
+      {
+         QLog_Info("Git", "The commit-graph file is corrupted");
+         return false;
+      }
+
+      for (auto parent : commitParents)
+      {
+         ++pendingChildren[static_cast<int>(parent)];
+
+         if (!reached.at(static_cast<int>(parent)))
+         {
+            reached[static_cast<int>(parent)] = true;
+            stack.append(parent);
+         }
+      }
+   }
+
+   // same order as --date-order: newest first, but never a parent before its children
+   std::priority_queue<std::pair<quint64, quint32>> ready;
+
+   for (auto pos : qAsConst(reachable))
+      if (pendingChildren.at(static_cast<int>(pos)) == 0)
+         ready.push(std::make_pair(commitDate(pos), pos));
+
+   auto records = new QByteArray();
+   records->reserve(reachable.count() * (OID_SIZE * 4 + 24));
+
+   QVector<QByteArray> parentShas;
+   auto rows = 0;
+
+   while (!ready.empty())
+   {
+      const auto pos = ready.top().second;
+      const auto date = ready.top().first;
+      ready.pop();
+
+      parents(pos, commitParents);
+      parentShas.clear();
+
+      for (auto parent : qAsConst(commitParents))
+      {
+         parentShas.append(
+             QByteArray::fromRawData(reinterpret_cast<const char *>(mOids + parent * OID_SIZE), OID_SIZE).toHex());
+
+         if (--pendingChildren[static_cast<int>(parent)] == 0)
+            ready.push(std::make_pair(commitDate(parent), parent));
+      }
+
+      const auto sha = QByteArray::fromRawData(reinterpret_cast<const char *>(mOids + pos * OID_SIZE), OID_SIZE).toHex();
+
+      // author, committer and message are read when the row is shown,
+      // until then the commit date stands for the author date
+      appendRecord(*records, sha, parentShas, QByteArray(), QByteArray(), QByteArray::number(date), QByteArray());
+      ++rows;
+   }
+
+   const auto firstRow = cache->count();
+   auto ofs = 0;
+
+   for (auto i = 0; i < rows; ++i)
+   {
+      int next;
+      Revision revision(*records, static_cast<uint>(ofs), firstRow + i, &next);
+      cache->insertRevision(revision.sha(), revision);
+      ofs = next;
+   }
+
+   cache->adoptLogBuffer(records);
+
+   return true;
+}
+
+void CommitGraph::appendRecord(QByteArray &buffer, const QByteArray &sha, const QVector<QByteArray> &parents,
+                               const QByteArray &committer, const QByteArray &author, const QByteArray &date,
+                               const QByteArray &message)
+{
+   // see GIT_LOG_FORMAT, the message is the subject followed by the body
+   buffer.append('>');
+   buffer.append(sha);
+   buffer.append('X');
+
+   for (auto i = 0; i < parents.count(); ++i)
+   {
+      if (i > 0)
+         buffer.append(' ');
+
+      buffer.append(parents.at(i));
+   }
+
+   buffer.append("X\n");
+   buffer.append(committer);
+   buffer.append('\n');
+   buffer.append(author);
+   buffer.append('\n');
+   buffer.append(date);
+   buffer.append('\n');
+   buffer.append(message);
+   buffer.append('\n');
+   buffer.append('\0');
+}
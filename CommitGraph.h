@@ -0,0 +1,80 @@
+#pragma once
+
+/****************************************************************************************
+ ** GitQlient is an application to manage and operate one or several Git repositories. With
+ ** GitQlient you will be able to add commits, branches and manage all the options Git provides.
+ ** Copyright (C) 2019  Francesc Martinez
+ **
+ ** LinkedIn: www.linkedin.com/in/cescmm/
+ ** Web: www.francescmm.com
+ **
+ ** This program is free software; you can redistribute it and/or
+ ** modify it under the terms of the GNU Lesser General Public
+ ** License as published by the Free Software Foundation; either
+ ** version 2 of the License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ ** Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public
+ ** License along with this library; if not, write to the Free Software
+ ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***************************************************************************************/
+
+
+#include <QByteArray>
+#include <QStringList>
+#include <QVector>
+
+class QFile;
+class RevisionsCache;
+
+/* Reader of the commit-graph file git keeps in objects/info. It holds the
+ * parents and the commit date of every commit in a binary table, enough
+ * to lay out the history in the same order as 'git log --date-order'
+ * without asking git to format every commit. The revisions built from it
+ * only carry the topology and the date, author and message are left empty
+ * and read later from the commit objects, see Revision::isPartial().
+ *
+ * Split commit-graph chains are not read, callers fall back to 'git log'.
+ */
+class CommitGraph
+{
+public:
+   explicit CommitGraph(const QString &gitDir);
+   ~CommitGraph();
+
+   bool load();
+   int count() const { return static_cast<int>(mCount); }
+   int size() const { return mSize; }
+   bool contains(const QString &sha) const;
+   bool appendTo(RevisionsCache *cache, const QStringList &tips);
+
+   // a record as 'git log' prints it with the format used to load the history
+   static void appendRecord(QByteArray &buffer, const QByteArray &sha, const QVector<QByteArray> &parents,
+                            const QByteArray &committer, const QByteArray &author, const QByteArray &date,
+                            const QByteArray &message);
+
+   static const QString kFileName;
+
+private:
+   static const int OID_SIZE = 20; // only SHA-1 graphs are read
+   static const int COMMIT_DATA_SIZE = OID_SIZE + 16;
+
+   QString mPath;
+   QFile *mFile = nullptr;
+   const uchar *mData = nullptr;
+   int mSize = 0;
+   const uchar *mFanout = nullptr;
+   const uchar *mOids = nullptr;
+   const uchar *mCommitData = nullptr;
+   const uchar *mExtraEdges = nullptr;
+   quint32 mCount = 0;
+   quint32 mExtraEdgesCount = 0;
+
+   int position(const QByteArray &oid) const;
+   bool parents(quint32 pos, QVector<quint32> &parents) const;
+   quint64 commitDate(quint32 pos) const;
+};
@@ -0,0 +1,196 @@
+#include "DiffTreePrefetcher.h"
+
+#include <QProcess>
+
+#include <QLogger.h>
+
+using namespace QLogger;
+
+DiffTreePrefetcher::DiffTreePrefetcher(QObject *parent)
+   : QObject(parent)
+{
+}
+
+DiffTreePrefetcher::~DiffTreePrefetcher()
+{
+   stop();
+}
+
+void DiffTreePrefetcher::setWorkingDir(const QString &workingDir)
+{
+   if (workingDir == mWorkingDir)
+      return;
+
+   stop();
+   mQueue.clear();
+   mWorkingDir = workingDir;
+}
+
+void DiffTreePrefetcher::prefetch(const QStringList &shas)
+{
+   // what was queued for a previous viewport is not interesting anymore
+   mQueue.clear();
+
+   for (const auto &sha : shas)
+      if (!mInFlight.contains(sha) && !mQueue.contains(sha))
+         mQueue.append(sha);
+
+   sendBatch();
+}
+
+bool DiffTreePrefetcher::waitFor(const QString &sha)
+{
+   while (mProcess && mInFlight.contains(sha))
+   {
+      if (!mProcess->waitForReadyRead(kTimeout))
+      {
+         QLog_Warning("Git", QString("Timeout while prefetching the files of {%1}").arg(sha));
+         stop();
+         return false;
+      }
+
+      onReadyRead();
+   }
+
+   return true;
+}
+
+void DiffTreePrefetcher::cancel()
+{
+   // the batch already sent is still read, its results are valid
+   mQueue.clear();
+}
+
+bool DiffTreePrefetcher::ensureStarted()
+{
+   if (mProcess && mProcess->state() == QProcess::Running)
+      return true;
+
+   stop();
+
+   mProcess = new QProcess(this);
+   mProcess->setWorkingDirectory(mWorkingDir);
+   mProcess->setStandardErrorFile(QProcess::nullDevice());
+
+   connect(mProcess, &QProcess::readyReadStandardOutput, this, &DiffTreePrefetcher::onReadyRead);
+   connect(mProcess, qOverload<int, QProcess::ExitStatus>(&QProcess::finished), this, [this]() {
+      // a bad object makes git quit, the next batch starts a new process
+      mInFlight.clear();
+      mCurrentSha.clear();
+      mCurrentDiff.clear();
+      mBuffer.clear();
+      mProcess->deleteLater();
+      mProcess = nullptr;
+   });
+
+   // --always gives a header to the commits without changes too, so
+   // every commit sent gets an answer
+   mProcess->start("git", { "diff-tree", "--stdin", "--always", "--no-color", "-r", "-c", "-C" });
+
+   if (!mProcess->waitForStarted())
+   {
+      QLog_Warning("Git", QString("Unable to start git diff-tree in {%1}").arg(mWorkingDir));
+      stop();
+      return false;
+   }
+
+   return true;
+}
+
+void DiffTreePrefetcher::stop()
+{
+   if (!mProcess)
+      return;
+
+   mProcess->disconnect(this);
+   mProcess->closeWriteChannel();
+
+   if (!mProcess->waitForFinished(1000))
+      mProcess->kill();
+
+   // it could be stopped from one of its own signals
+   mProcess->deleteLater();
+   mProcess = nullptr;
+   mBuffer.clear();
+   mInFlight.clear();
+   mCurrentSha.clear();
+   mCurrentDiff.clear();
+}
+
+void DiffTreePrefetcher::sendBatch()
+{
+   // one batch at a time, so a new viewport never waits behind a long queue
+   if (!mInFlight.isEmpty() || mQueue.isEmpty() || !ensureStarted())
+      return;
+
+   QByteArray request;
+
+   while (!mQueue.isEmpty() && mInFlight.count() < kBatchSize)
+   {
+      const auto sha = mQueue.takeFirst();
+      mInFlight.insert(sha);
+      request.append(sha.toLatin1()).append('\n');
+   }
+
+   // git echoes the lines that are not a commit and flushes its output
+   request.append('\n');
+
+   mProcess->write(request);
+}
+
+void DiffTreePrefetcher::onReadyRead()
+{
+   if (!mProcess)
+      return;
+
+   mBuffer.append(mProcess->readAllStandardOutput());
+   parseOutput();
+}
+
+void DiffTreePrefetcher::parseOutput()
+{
+   auto start = 0;
+   int eol;
+
+   while ((eol = mBuffer.indexOf('\n', start)) != -1)
+   {
+      const auto line = mBuffer.mid(start, eol - start);
+      start = eol + 1;
+
+      if (line.isEmpty())
+      {
+         // end of the batch, the commits git did not answer for are dropped
+         flushCurrent();
+         mInFlight.clear();
+         mBuffer.remove(0, start);
+         sendBatch();
+         start = 0;
+      }
+      else if (line.at(0) != ':')
+      {
+         flushCurrent();
+         mCurrentSha = QString::fromLatin1(line);
+         mCurrentDiff = line + '\n';
+      }
+      else
+         mCurrentDiff.append(line).append('\n');
+   }
+
+   mBuffer.remove(0, start);
+}
+
+void DiffTreePrefetcher::flushCurrent()
+{
+   if (mCurrentSha.isEmpty())
+      return;
+
+   const auto sha = mCurrentSha;
+   const auto diff = QString::fromUtf8(mCurrentDiff);
+
+   mInFlight.remove(sha);
+   mCurrentSha.clear();
+   mCurrentDiff.clear();
+
+   // same output as 'git diff-tree -r -c -C <sha>'
+   emit filesReady(sha, diff);
+}
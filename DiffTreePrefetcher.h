@@ -0,0 +1,75 @@
+#pragma once
+
+/****************************************************************************************
+ ** GitQlient is an application to manage and operate one or several Git repositories. With
+ ** GitQlient you will be able to add commits, branches and manage all the options Git provides.
+ ** Copyright (C) 2019  Francesc Martinez
+ **
+ ** LinkedIn: www.linkedin.com/in/cescmm/
+ ** Web: www.francescmm.com
+ **
+ ** This program is free software; you can redistribute it and/or
+ ** modify it under the terms of the GNU Lesser General Public
+ ** License as published by the Free Software Foundation; either
+ ** version 2 of the License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ ** Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public
+ ** License along with this library; if not, write to the Free Software
+ ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***************************************************************************************/
+
+
+#include <QByteArray>
+#include <QObject>
+#include <QSet>
+#include <QStringList>
+
+class QProcess;
+
+/* Computes the changed files of commits ahead of the user, through a single
+ * long-lived 'git diff-tree --stdin' process. Commits are sent in small
+ * batches, each one followed by an empty line that git echoes back and that
+ * marks the end of the batch. A new request replaces whatever was still
+ * queued and not sent, so the commits close to the viewport always go first.
+ */
+class DiffTreePrefetcher : public QObject
+{
+   Q_OBJECT
+
+signals:
+   void filesReady(const QString &sha, const QString &diff);
+
+public:
+   explicit DiffTreePrefetcher(QObject *parent = nullptr);
+   ~DiffTreePrefetcher();
+
+   void setWorkingDir(const QString &workingDir);
+   void prefetch(const QStringList &shas);
+   bool isInFlight(const QString &sha) const { return mInFlight.contains(sha); }
+   bool waitFor(const QString &sha);
+   void cancel();
+
+private:
+   static const int kBatchSize = 32;
+   static const int kTimeout = 10000;
+
+   QProcess *mProcess = nullptr;
+   QString mWorkingDir;
+   QByteArray mBuffer;
+   QStringList mQueue;
+   QSet<QString> mInFlight;
+   QString mCurrentSha;
+   QByteArray mCurrentDiff;
+
+   bool ensureStarted();
+   void stop();
+   void sendBatch();
+   void onReadyRead();
+   void parseOutput();
+   void flushCurrent();
+};
@@ -8,8 +8,7 @@ FileContextMenu::FileContextMenu(const QString &file, QWidget *parent)
    : QMenu(parent)
 {
    const auto fileHistoryAction = addAction(tr("File history"));
-   fileHistoryAction->setEnabled(false);
-   // connect(fileHistoryAction, &QAction::triggered, this, &FileList::executeAction);
+   connect(fileHistoryAction, &QAction::triggered, this, &FileContextMenu::signalShowFileHistory);
 
    const auto fileBlameAction = addAction(tr("File blame"));
    fileBlameAction->setEnabled(false);
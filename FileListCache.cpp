@@ -0,0 +1,356 @@
+#include "FileListCache.h"
+
+#include <QDir>
+#include <QFile>
+#include <QtEndian>
+
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+const quint32 kMagic = 0xA0B0C0D2;
+const quint32 kVersion = 1;
+const QString kLegacyFileName = QString("qgit_cache.dat");
+
+template<typename T>
+void appendLittleEndian(QByteArray &buffer, T value)
+{
+   uchar bytes[sizeof(T)];
+   qToLittleEndian<T>(value, bytes);
+   buffer.append(reinterpret_cast<const char *>(bytes), sizeof(T));
+}
+
+QByteArray header(quint32 sortedCount, quint32 tailCount, quint64 dataSize)
+{
+   QByteArray buffer;
+   appendLittleEndian<quint32>(buffer, kMagic);
+   appendLittleEndian<quint32>(buffer, kVersion);
+   appendLittleEndian<quint32>(buffer, sortedCount);
+   appendLittleEndian<quint32>(buffer, tailCount);
+   appendLittleEndian<quint64>(buffer, dataSize);
+   return buffer;
+}
+}
+
+const QString FileListCache::kDataFileName = QString("qgit_files.dat");
+const QString FileListCache::kIndexFileName = QString("qgit_files.idx");
+
+FileListCache::FileListCache(const QString &gitDir)
+   : mGitDir(gitDir)
+{
+}
+
+FileListCache::~FileListCache()
+{
+   close();
+}
+
+QString FileListCache::path(const QString &fileName) const
+{
+   return QString("%1/%2").arg(mGitDir, fileName);
+}
+
+void FileListCache::close()
+{
+   // closing the files unmaps them
+   delete mIndexFile;
+   delete mDataFile;
+   mIndexFile = nullptr;
+   mDataFile = nullptr;
+   mData = nullptr;
+   mDataSize = 0;
+   mSorted = nullptr;
+   mSortedCount = 0;
+   mTail.clear();
+   mValid = false;
+}
+
+bool FileListCache::load()
+{
+   close();
+
+   // the whole cache was a single compressed stream before
+   if (QFile::exists(path(kLegacyFileName)))
+      QFile::remove(path(kLegacyFileName));
+
+   mIndexFile = new QFile(path(kIndexFileName));
+   mDataFile = new QFile(path(kDataFileName));
+
+   if (!mIndexFile->open(QIODevice::ReadOnly) || !mDataFile->open(QIODevice::ReadOnly))
+      return false;
+
+   const auto indexSize = mIndexFile->size();
+
+   if (indexSize < HEADER_SIZE)
+      return false;
+
+   const auto index = mIndexFile->map(0, indexSize);
+
+   if (!index)
+      return false;
+
+   const auto sortedCount = qFromLittleEndian<quint32>(index + 8);
+   const auto tailCount = qFromLittleEndian<quint32>(index + 12);
+   const auto dataSize = qFromLittleEndian<quint64>(index + 16);
+
+   if (qFromLittleEndian<quint32>(index) != kMagic || qFromLittleEndian<quint32>(index + 4) != kVersion)
+      return false;
+
+   // records written after the last index update are not referenced, they are just ignored
+   if (HEADER_SIZE + (static_cast<qint64>(sortedCount) + tailCount) * ENTRY_SIZE > indexSize
+       || dataSize > static_cast<quint64>(mDataFile->size()))
+      return false;
+
+   if (dataSize > 0)
+   {
+      mData = mDataFile->map(0, static_cast<qint64>(dataSize));
+
+      if (!mData)
+         return false;
+   }
+
+   mDataSize = dataSize;
+   mSorted = index + HEADER_SIZE;
+   mSortedCount = sortedCount;
+
+   const auto tail = mSorted + static_cast<qint64>(sortedCount) * ENTRY_SIZE;
+
+   for (auto i = 0u; i < tailCount; ++i)
+   {
+      const auto entry = tail + static_cast<qint64>(i) * ENTRY_SIZE;
+
+      Location location;
+      location.offset = qFromLittleEndian<quint64>(entry + OID_SIZE);
+      location.size = qFromLittleEndian<quint32>(entry + OID_SIZE + 8);
+
+      mTail.insert(QByteArray(reinterpret_cast<const char *>(entry), OID_SIZE), location);
+   }
+
+   mValid = true;
+
+   return true;
+}
+
+bool FileListCache::find(const QByteArray &oid, Location &location) const
+{
+   if (!mValid || oid.size() != OID_SIZE)
+      return false;
+
+   const auto it = mTail.constFind(oid);
+
+   if (it != mTail.constEnd())
+   {
+      location = it.value();
+      return true;
+   }
+
+   auto lo = 0u;
+   auto hi = mSortedCount;
+
+   while (lo < hi)
+   {
+      const auto mid = lo + (hi - lo) / 2;
+      const auto entry = mSorted + static_cast<qint64>(mid) * ENTRY_SIZE;
+      const auto cmp = memcmp(entry, oid.constData(), OID_SIZE);
+
+      if (cmp == 0)
+      {
+         location.offset = qFromLittleEndian<quint64>(entry + OID_SIZE);
+         location.size = qFromLittleEndian<quint32>(entry + OID_SIZE + 8);
+         return true;
+      }
+
+      if (cmp < 0)
+         lo = mid + 1;
+      else
+         hi = mid;
+   }
+
+   return false;
+}
+
+bool FileListCache::contains(const QString &sha) const
+{
+   Location location;
+   return find(QByteArray::fromHex(sha.toLatin1()), location);
+}
+
+QByteArray FileListCache::record(const QString &sha) const
+{
+   Location location;
+
+   if (!find(QByteArray::fromHex(sha.toLatin1()), location) || location.offset + location.size > mDataSize)
+      return QByteArray();
+
+   return qUncompress(mData + location.offset, static_cast<int>(location.size));
+}
+
+QVector<FileListCache::Entry> FileListCache::entries() const
+{
+   QVector<Entry> entries;
+   entries.reserve(count());
+
+   for (auto i = 0u; i < mSortedCount; ++i)
+   {
+      const auto entry = mSorted + static_cast<qint64>(i) * ENTRY_SIZE;
+
+      Entry e;
+      e.oid = QByteArray(reinterpret_cast<const char *>(entry), OID_SIZE);
+      e.location.offset = qFromLittleEndian<quint64>(entry + OID_SIZE);
+      e.location.size = qFromLittleEndian<quint32>(entry + OID_SIZE + 8);
+      entries.append(e);
+   }
+
+   for (auto it = mTail.constBegin(); it != mTail.constEnd(); ++it)
+   {
+      Entry e;
+      e.oid = it.key();
+      e.location = it.value();
+      entries.append(e);
+   }
+
+   return entries;
+}
+
+bool FileListCache::append(const QVector<QPair<QString, QByteArray>> &records)
+{
+   if (records.isEmpty())
+      return true;
+
+   const auto valid = mValid;
+   const auto rewrite = !valid || mTail.count() + records.count() > qMax(MAX_TAIL, static_cast<int>(mSortedCount / 8));
+   auto allEntries = rewrite && valid ? entries() : QVector<Entry>();
+
+   // files are written unmapped and mapped again afterwards, without a
+   // valid index the data already there is garbage and is dropped
+   close();
+
+   QFile data(path(kDataFileName));
+
+   if (!data.open(valid ? QIODevice::Append : QIODevice::WriteOnly | QIODevice::Truncate))
+   {
+      load();
+      return false;
+   }
+
+   auto offset = static_cast<quint64>(data.size());
+   QVector<Entry> added;
+   added.reserve(records.count());
+
+   for (const auto &record : records)
+   {
+      const auto compressed = qCompress(record.second, 1);
+
+      if (data.write(compressed) != compressed.size())
+         break;
+
+      Entry entry;
+      entry.oid = QByteArray::fromHex(record.first.toLatin1());
+      entry.location.offset = offset;
+      entry.location.size = static_cast<quint32>(compressed.size());
+      added.append(entry);
+
+      offset += static_cast<quint64>(compressed.size());
+   }
+
+   data.close();
+
+   // records must be on disk before the index points to them
+   auto ok = data.error() == QFileDevice::NoError && added.count() == records.count();
+
+   if (ok)
+   {
+      if (rewrite)
+         ok = writeIndex(allEntries + added, offset);
+      else
+         ok = appendIndex(added, offset);
+   }
+
+   load();
+
+   return ok;
+}
+
+bool FileListCache::appendIndex(const QVector<Entry> &added, quint64 dataSize) const
+{
+   QFile index(path(kIndexFileName));
+
+   if (!index.open(QIODevice::ReadWrite))
+      return false;
+
+   const auto current = index.read(HEADER_SIZE);
+
+   if (current.size() != HEADER_SIZE)
+      return false;
+
+   const auto bytes = reinterpret_cast<const uchar *>(current.constData());
+   const auto sortedCount = qFromLittleEndian<quint32>(bytes + 8);
+   const auto tailCount = qFromLittleEndian<quint32>(bytes + 12);
+
+   QByteArray buffer;
+   buffer.reserve(added.count() * ENTRY_SIZE);
+
+   for (const auto &entry : added)
+   {
+      buffer.append(entry.oid);
+      appendLittleEndian<quint64>(buffer, entry.location.offset);
+      appendLittleEndian<quint32>(buffer, entry.location.size);
+   }
+
+   // the new entries go in place first, then the header counts them
+   if (!index.seek(HEADER_SIZE + (static_cast<qint64>(sortedCount) + tailCount) * ENTRY_SIZE)
+       || index.write(buffer) != buffer.size() || !index.flush())
+      return false;
+
+   const auto updated = header(sortedCount, tailCount + static_cast<quint32>(added.count()), dataSize);
+
+   return index.seek(0) && index.write(updated) == updated.size() && index.flush();
+}
+
+bool FileListCache::writeIndex(QVector<Entry> entries, quint64 dataSize) const
+{
+   std::stable_sort(entries.begin(), entries.end(),
+                    [](const Entry &left, const Entry &right) { return left.oid < right.oid; });
+
+   // the newest record of a commit wins
+   QVector<Entry> unique;
+   unique.reserve(entries.count());
+
+   for (const auto &entry : qAsConst(entries))
+   {
+      if (!unique.isEmpty() && unique.last().oid == entry.oid)
+         unique.last() = entry;
+      else
+         unique.append(entry);
+   }
+
+   QByteArray buffer = header(static_cast<quint32>(unique.count()), 0, dataSize);
+   buffer.reserve(HEADER_SIZE + unique.count() * ENTRY_SIZE);
+
+   for (const auto &entry : qAsConst(unique))
+   {
+      buffer.append(entry.oid);
+      appendLittleEndian<quint64>(buffer, entry.location.offset);
+      appendLittleEndian<quint32>(buffer, entry.location.size);
+   }
+
+   const auto indexPath = path(kIndexFileName);
+   const auto tmpPath = QString("%1.bak").arg(indexPath);
+
+   QFile f(tmpPath);
+   if (!f.open(QIODevice::WriteOnly) || f.write(buffer) != buffer.size())
+      return false;
+
+   f.close();
+
+   QDir dir;
+
+   if (dir.exists(indexPath) && !dir.remove(indexPath))
+   {
+      dir.remove(tmpPath);
+      return false;
+   }
+
+   return dir.rename(tmpPath, indexPath);
+}
@@ -0,0 +1,91 @@
+#pragma once
+
+/****************************************************************************************
+ ** GitQlient is an application to manage and operate one or several Git repositories. With
+ ** GitQlient you will be able to add commits, branches and manage all the options Git provides.
+ ** Copyright (C) 2019  Francesc Martinez
+ **
+ ** LinkedIn: www.linkedin.com/in/cescmm/
+ ** Web: www.francescmm.com
+ **
+ ** This program is free software; you can redistribute it and/or
+ ** modify it under the terms of the GNU Lesser General Public
+ ** License as published by the Free Software Foundation; either
+ ** version 2 of the License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ ** Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public
+ ** License along with this library; if not, write to the Free Software
+ ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***************************************************************************************/
+
+
+#include <QByteArray>
+#include <QHash>
+#include <QPair>
+#include <QVector>
+
+class QFile;
+
+/* On disk cache of the files changed by each commit, as 'git diff-tree'
+ * lists them. Every commit gets its own record, compressed on its own and
+ * appended to a data file. An index file tells where each record is: the
+ * bulk of it is sorted by commit id, the latest additions follow unsorted
+ * and are merged in once they grow too many. Both files are mapped in
+ * memory and a record is only read and uncompressed when asked for, so
+ * opening a repository costs the same however big the cache is.
+ */
+class FileListCache
+{
+public:
+   explicit FileListCache(const QString &gitDir);
+   ~FileListCache();
+
+   bool load();
+   int count() const { return static_cast<int>(mSortedCount) + mTail.count(); }
+   bool contains(const QString &sha) const;
+   QByteArray record(const QString &sha) const;
+   bool append(const QVector<QPair<QString, QByteArray>> &records);
+
+   static const QString kDataFileName;
+   static const QString kIndexFileName;
+
+private:
+   static const int OID_SIZE = 20;
+   static const int HEADER_SIZE = 24; // magic, version, sorted and tail entries, data size
+   static const int ENTRY_SIZE = OID_SIZE + 12; // id, record offset and size
+   static const int MAX_TAIL = 4096;
+
+   struct Location
+   {
+      quint64 offset = 0;
+      quint32 size = 0;
+   };
+
+   struct Entry
+   {
+      QByteArray oid;
+      Location location;
+   };
+
+   QString mGitDir;
+   QFile *mDataFile = nullptr;
+   QFile *mIndexFile = nullptr;
+   const uchar *mData = nullptr;
+   quint64 mDataSize = 0;
+   const uchar *mSorted = nullptr;
+   quint32 mSortedCount = 0;
+   QHash<QByteArray, Location> mTail;
+   bool mValid = false;
+
+   void close();
+   bool find(const QByteArray &oid, Location &location) const;
+   QVector<Entry> entries() const;
+   bool appendIndex(const QVector<Entry> &added, quint64 dataSize) const;
+   bool writeIndex(QVector<Entry> entries, quint64 dataSize) const;
+   QString path(const QString &fileName) const;
+};
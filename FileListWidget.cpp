@@ -49,6 +49,8 @@ void FileListWidget::showContextMenu(const QPoint &pos)
       const auto menu = new FileContextMenu(fileName, this);
       connect(menu, &FileContextMenu::signalOpenFileDiff, this,
               [this, item] { emit QListWidget::itemDoubleClicked(item); });
+      connect(menu, &FileContextMenu::signalShowFileHistory, this,
+              [this, fileName] { emit signalShowFileHistory(fileName); });
       menu->exec(viewport()->mapToGlobal(pos));
    }
 }
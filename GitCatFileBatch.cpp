@@ -0,0 +1,301 @@
+#include "GitCatFileBatch.h"
+
+#include <QProcess>
+#include <QTimer>
+
+#include <QLogger.h>
+
+using namespace QLogger;
+
+namespace
+{
+bool isObjectId(const QString &name)
+{
+   if (name.length() != 40)
+      return false;
+
+   for (const auto &c : name)
+      if (!((c >= '0' && c <= '9') || (c >= 'a' && c <= 'f')))
+         return false;
+
+   return true;
+}
+}
+
+GitCatFileBatch::GitCatFileBatch(QObject *parent)
+   : QObject(parent)
+   , mCache(kMaxCacheCost)
+{
+}
+
+GitCatFileBatch::~GitCatFileBatch()
+{
+   stop();
+}
+
+void GitCatFileBatch::setWorkingDir(const QString &workingDir)
+{
+   if (workingDir == mWorkingDir)
+      return;
+
+   // the object ids of a different repository are unrelated
+   stop();
+   mCache.clear();
+   mWorkingDir = workingDir;
+}
+
+GitCatFileBatch::Object GitCatFileBatch::read(const QString &name)
+{
+   return read(QStringList { name }).first();
+}
+
+QVector<GitCatFileBatch::Object> GitCatFileBatch::read(const QStringList &names)
+{
+   QVector<Object> objects;
+   QVector<int> requested;
+   const auto request = prepare(names, objects, requested);
+
+   if (requested.isEmpty() || !ensureStarted())
+      return objects;
+
+   // the answers of the requests still in flight come first
+   drainRequests();
+
+   if (!ensureStarted())
+      return objects;
+
+   // all the requests go in one write, the answers come back in order
+   mProcess->write(request);
+   mBlocking = true;
+
+   for (auto i : requested)
+   {
+      if (!readResponse(objects[i]))
+      {
+         QLog_Warning("Git", QString("Unable to read object {%1} from git cat-file").arg(names.at(i)));
+         mBlocking = false;
+         stop();
+         break;
+      }
+
+      if (objects[i].isValid())
+         mCache.insert(objects[i].sha, new Object(objects[i]), objects[i].content.size());
+   }
+
+   mBlocking = false;
+
+   return objects;
+}
+
+int GitCatFileBatch::request(const QStringList &names)
+{
+   Request request;
+   request.id = ++mLastRequest;
+
+   const auto data = prepare(names, request.objects, request.requested);
+
+   if (!request.requested.isEmpty() && ensureStarted())
+      mProcess->write(data);
+   else
+      request.answered = request.requested.count();
+
+   mRequests.enqueue(request);
+
+   // the answer is always signaled later, even when nothing has to be read
+   if (request.answered == request.requested.count())
+      QTimer::singleShot(0, this, &GitCatFileBatch::answerRequests);
+
+   return request.id;
+}
+
+QByteArray GitCatFileBatch::prepare(const QStringList &names, QVector<Object> &objects, QVector<int> &requested)
+{
+   QByteArray request;
+   objects.resize(names.count());
+
+   for (auto i = 0; i < names.count(); ++i)
+   {
+      // refs can move, only lookups by object id are served from the cache
+      if (const auto cached = isObjectId(names.at(i)) ? mCache.object(names.at(i)) : nullptr)
+         objects[i] = *cached;
+      else
+      {
+         requested.append(i);
+         request.append(names.at(i).toUtf8()).append('\n');
+      }
+   }
+
+   return request;
+}
+
+bool GitCatFileBatch::ensureStarted()
+{
+   if (mProcess && mProcess->state() == QProcess::Running)
+      return true;
+
+   stop();
+
+   mProcess = new QProcess(this);
+   mProcess->setWorkingDirectory(mWorkingDir);
+   mProcess->start("git", { "cat-file", "--batch" });
+
+   if (!mProcess->waitForStarted())
+   {
+      QLog_Warning("Git", QString("Unable to start git cat-file in {%1}").arg(mWorkingDir));
+      stop();
+      return false;
+   }
+
+   connect(mProcess, &QProcess::readyReadStandardOutput, this, &GitCatFileBatch::onReadyRead);
+
+   // the process is not deleted from its own signal
+   connect(mProcess, qOverload<int, QProcess::ExitStatus>(&QProcess::finished), this,
+           [this]() {
+              if (mProcess && mProcess->state() != QProcess::Running)
+                 stop();
+           },
+           Qt::QueuedConnection);
+
+   return true;
+}
+
+void GitCatFileBatch::stop()
+{
+   if (!mProcess)
+      return;
+
+   // the answers left are dropped, nothing is parsed while stopping
+   mProcess->disconnect(this);
+   mProcess->closeWriteChannel();
+
+   if (!mProcess->waitForFinished(1000))
+      mProcess->kill();
+
+   delete mProcess;
+   mProcess = nullptr;
+   mBuffer.clear();
+
+   // the requests in flight are answered with what was read
+   for (auto &request : mRequests)
+      request.answered = request.requested.count();
+
+   if (!mRequests.isEmpty())
+      QTimer::singleShot(0, this, &GitCatFileBatch::answerRequests);
+}
+
+bool GitCatFileBatch::parseResponse(Object &object)
+{
+   // "<sha> <type> <size>\n<content>\n" or "<name> missing\n"
+   const auto eol = mBuffer.indexOf('\n');
+
+   if (eol == -1)
+      return false;
+
+   const auto header = QString::fromUtf8(mBuffer.left(eol)).split(' ');
+
+   if (header.count() != 3)
+   {
+      // missing or ambiguous, not an error of the process
+      mBuffer.remove(0, eol + 1);
+      return true;
+   }
+
+   const auto size = header.at(2).toInt();
+
+   if (mBuffer.size() < eol + size + 2)
+      return false;
+
+   object.sha = header.at(0);
+   object.type = header.at(1);
+   object.content = mBuffer.mid(eol + 1, size);
+   mBuffer.remove(0, eol + size + 2);
+
+   return true;
+}
+
+bool GitCatFileBatch::readResponse(Object &object)
+{
+   while (!parseResponse(object))
+      if (!waitForBytes(mBuffer.size() + 1))
+         return false;
+
+   return true;
+}
+
+bool GitCatFileBatch::waitForBytes(int count)
+{
+   while (mBuffer.size() < count)
+   {
+      if (!mProcess->bytesAvailable() && !mProcess->waitForReadyRead(kTimeout))
+         return false;
+
+      mBuffer.append(mProcess->readAllStandardOutput());
+   }
+
+   return true;
+}
+
+void GitCatFileBatch::onReadyRead()
+{
+   mBuffer.append(mProcess->readAllStandardOutput());
+
+   // a blocking read takes its answers itself
+   if (!mBlocking)
+      answerRequests();
+}
+
+void GitCatFileBatch::answerRequests()
+{
+   while (!mRequests.isEmpty())
+   {
+      auto &request = mRequests.head();
+
+      while (request.answered < request.requested.count())
+      {
+         auto &object = request.objects[request.requested.at(request.answered)];
+
+         // the rest is still on its way
+         if (!parseResponse(object))
+            return;
+
+         if (object.isValid())
+            mCache.insert(object.sha, new Object(object), object.content.size());
+
+         ++request.answered;
+      }
+
+      const auto answered = mRequests.dequeue();
+      emit objectsRead(answered.id, answered.objects);
+   }
+}
+
+void GitCatFileBatch::drainRequests()
+{
+   mBlocking = true;
+
+   for (auto &request : mRequests)
+   {
+      while (request.answered < request.requested.count())
+      {
+         auto &object = request.objects[request.requested.at(request.answered)];
+
+         if (!readResponse(object))
+         {
+            QLog_Warning("Git", QString("Unable to read pending objects from git cat-file"));
+            mBlocking = false;
+            stop();
+            return;
+         }
+
+         if (object.isValid())
+            mCache.insert(object.sha, new Object(object), object.content.size());
+
+         ++request.answered;
+      }
+   }
+
+   mBlocking = false;
+
+   if (!mRequests.isEmpty())
+      QTimer::singleShot(0, this, &GitCatFileBatch::answerRequests);
+}
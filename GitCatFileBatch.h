@@ -0,0 +1,98 @@
+#pragma once
+
+/****************************************************************************************
+ ** GitQlient is an application to manage and operate one or several Git repositories. With
+ ** GitQlient you will be able to add commits, branches and manage all the options Git provides.
+ ** Copyright (C) 2019  Francesc Martinez
+ **
+ ** LinkedIn: www.linkedin.com/in/cescmm/
+ ** Web: www.francescmm.com
+ **
+ ** This program is free software; you can redistribute it and/or
+ ** modify it under the terms of the GNU Lesser General Public
+ ** License as published by the Free Software Foundation; either
+ ** version 2 of the License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ ** Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public
+ ** License along with this library; if not, write to the Free Software
+ ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***************************************************************************************/
+
+
+#include <QByteArray>
+#include <QCache>
+#include <QObject>
+#include <QQueue>
+#include <QStringList>
+#include <QVector>
+
+class QProcess;
+
+/* Reads git objects through a single long-lived 'git cat-file --batch'
+ * process instead of spawning one git process per lookup. Requests are
+ * written to its stdin and answered in order on its stdout, so several
+ * of them can be pipelined in one round-trip. Objects are immutable, the
+ * ones read by id are kept in an LRU cache bounded by their size.
+ * request() does not wait: the answers are parsed as they arrive and
+ * objectsRead() is emitted once all the objects of the request are read.
+ */
+class GitCatFileBatch : public QObject
+{
+   Q_OBJECT
+
+public:
+   struct Object
+   {
+      QString sha;
+      QString type;
+      QByteArray content;
+
+      bool isValid() const { return !sha.isEmpty(); }
+   };
+
+   explicit GitCatFileBatch(QObject *parent = nullptr);
+   ~GitCatFileBatch();
+
+   void setWorkingDir(const QString &workingDir);
+   Object read(const QString &name);
+   QVector<Object> read(const QStringList &names);
+   int request(const QStringList &names);
+
+signals:
+   void objectsRead(int request, const QVector<GitCatFileBatch::Object> &objects);
+
+private:
+   static const int kMaxCacheCost = 4 * 1024 * 1024; // bytes of cached content
+   static const int kTimeout = 10000;
+
+   struct Request
+   {
+      int id = 0;
+      QVector<Object> objects;
+      QVector<int> requested; // the objects not in the cache, in the order asked
+      int answered = 0;
+   };
+
+   QProcess *mProcess = nullptr;
+   QString mWorkingDir;
+   QByteArray mBuffer;
+   QCache<QString, Object> mCache;
+   QQueue<Request> mRequests;
+   int mLastRequest = 0;
+   bool mBlocking = false;
+
+   bool ensureStarted();
+   void stop();
+   QByteArray prepare(const QStringList &names, QVector<Object> &objects, QVector<int> &requested);
+   bool parseResponse(Object &object);
+   bool readResponse(Object &object);
+   bool waitForBytes(int count);
+   void onReadyRead();
+   void answerRequests();
+   void drainRequests();
+};
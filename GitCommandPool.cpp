@@ -0,0 +1,149 @@
+#include "GitCommandPool.h"
+
+#include <AGitProcess.h>
+
+#include <QLogger.h>
+
+#include <functional>
+
+using namespace QLogger;
+
+namespace
+{
+class GitTaskProcess final : public AGitProcess
+{
+public:
+   using Callback = std::function<void(AGitProcess *, bool, const QString &)>;
+
+   GitTaskProcess(const QString &workingDir, Callback onDone)
+      : AGitProcess(workingDir)
+      , mOnDone(onDone)
+   {
+   }
+
+   bool run(const QString &command, QString &output) override
+   {
+      mRunOutput = &output;
+      mRunOutput->clear();
+      mCommand = command;
+
+      return execute(command);
+   }
+
+   bool runCommand(const QString &command) { return run(command, mOutput); }
+
+   void cancel()
+   {
+      mCanceling = true;
+      kill();
+   }
+
+protected:
+   void onFinished(int code, QProcess::ExitStatus exitStatus) override
+   {
+      AGitProcess::onFinished(code, exitStatus);
+
+      if (!mCanceling)
+         mOnDone(this, !mErrorExit, mOutput);
+   }
+
+private:
+   Callback mOnDone;
+   QString mOutput;
+};
+}
+
+GitCommandPool::GitCommandPool(int maxRunning, QObject *parent)
+   : QObject(parent)
+   , mMaxRunning(qMax(1, maxRunning))
+{
+   mClock.start();
+}
+
+GitCommandPool::~GitCommandPool()
+{
+   cancelAll();
+}
+
+QFuture<GitExecResult> GitCommandPool::run(const QString &workingDir, const QString &command)
+{
+   Task task;
+   task.workingDir = workingDir;
+   task.command = command;
+   task.queuedAt = mClock.elapsed();
+   task.promise.reportStarted();
+
+   const auto future = task.promise.future();
+
+   mQueued.enqueue(task);
+   startNext();
+
+   return future;
+}
+
+void GitCommandPool::cancelAll()
+{
+   const auto queued = mQueued;
+   mQueued.clear();
+
+   for (auto task : queued)
+   {
+      task.promise.reportCanceled();
+      task.promise.reportFinished();
+   }
+
+   const auto running = mRunning;
+   mRunning.clear();
+
+   for (auto it = running.constBegin(); it != running.constEnd(); ++it)
+   {
+      auto task = it.value();
+      task.promise.reportCanceled();
+      task.promise.reportFinished();
+
+      const auto process = static_cast<GitTaskProcess *>(it.key());
+      process->cancel();
+      process->deleteLater();
+   }
+}
+
+void GitCommandPool::startNext()
+{
+   while (mRunning.count() < mMaxRunning && !mQueued.isEmpty())
+   {
+      auto task = mQueued.dequeue();
+      const auto process = new GitTaskProcess(
+          task.workingDir, [this](AGitProcess *p, bool success, const QString &output) { onTaskFinished(p, success, output); });
+
+      mRunning.insert(process, task);
+
+      if (!process->runCommand(task.command))
+      {
+         mRunning.remove(process);
+         process->deleteLater();
+
+         task.promise.reportResult(GitExecResult(qMakePair(false, QString())));
+         task.promise.reportFinished();
+      }
+   }
+}
+
+void GitCommandPool::onTaskFinished(AGitProcess *process, bool success, const QString &output)
+{
+   if (!mRunning.contains(process))
+      return;
+
+   auto task = mRunning.take(process);
+   process->deleteLater();
+
+   const auto total = mClock.elapsed() - task.queuedAt;
+
+   QLog_Debug("Git", QString("Command {%1} finished in {%2} ms").arg(task.command).arg(total));
+
+   emit commandFinished(task.command, total, success);
+
+   task.promise.reportResult(GitExecResult(qMakePair(success, output)));
+   task.promise.reportFinished();
+
+   startNext();
+}
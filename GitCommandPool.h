@@ -0,0 +1,149 @@
+#pragma once
+
+/****************************************************************************************
+ ** GitQlient is an application to manage and operate one or several Git repositories. With
+ ** GitQlient you will be able to add commits, branches and manage all the options Git provides.
+ ** Copyright (C) 2019  Francesc Martinez
+ **
+ ** LinkedIn: www.linkedin.com/in/cescmm/
+ ** Web: www.francescmm.com
+ **
+ ** This program is free software; you can redistribute it and/or
+ ** modify it under the terms of the GNU Lesser General Public
+ ** License as published by the Free Software Foundation; either
+ ** version 2 of the License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ ** Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public
+ ** License along with this library; if not, write to the Free Software
+ ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***************************************************************************************/
+
+
+#include <git.h>
+
+#include <QElapsedTimer>
+#include <QFuture>
+#include <QFutureInterface>
+#include <QFutureWatcher>
+#include <QHash>
+#include <QObject>
+#include <QQueue>
+#include <QSharedPointer>
+#include <QVector>
+
+class AGitProcess;
+
+/* Runs git commands without blocking the caller. At most maxRunning processes
+ * are alive at the same time, the others wait in a queue in submission order.
+ * Results are delivered as futures and then() runs a continuation in the
+ * thread of a context object once a command has finished, whenAll() once all
+ * the commands of a group have finished. cancelAll() kills
+ * the running processes and drops the queued ones, their futures are canceled
+ * and their continuations never run.
+ */
+class GitCommandPool : public QObject
+{
+   Q_OBJECT
+
+signals:
+   void commandFinished(const QString &command, qint64 elapsedMs, bool success);
+
+public:
+   static const int kDefaultMaxRunning = 4;
+
+   explicit GitCommandPool(int maxRunning = kDefaultMaxRunning, QObject *parent = nullptr);
+   ~GitCommandPool();
+
+   QFuture<GitExecResult> run(const QString &workingDir, const QString &command);
+   void cancelAll();
+
+   template<typename T, typename Parser>
+   QFuture<T> run(const QString &workingDir, const QString &command, Parser parse);
+
+   template<typename T, typename Continuation>
+   static void then(const QFuture<T> &future, QObject *context, Continuation continuation);
+
+   template<typename T, typename Continuation>
+   static void whenAll(const QVector<QFuture<T>> &futures, QObject *context, Continuation continuation);
+
+private:
+   struct Task
+   {
+      QString workingDir;
+      QString command;
+      QFutureInterface<GitExecResult> promise;
+      qint64 queuedAt;
+   };
+
+   int mMaxRunning;
+   QQueue<Task> mQueued;
+   QHash<AGitProcess *, Task> mRunning;
+   QElapsedTimer mClock;
+
+   void startNext();
+   void onTaskFinished(AGitProcess *process, bool success, const QString &output);
+};
+
+template<typename T, typename Parser>
+QFuture<T> GitCommandPool::run(const QString &workingDir, const QString &command, Parser parse)
+{
+   QFutureInterface<T> promise;
+   promise.reportStarted();
+
+   const auto watcher = new QFutureWatcher<GitExecResult>(this);
+   connect(watcher, &QFutureWatcherBase::finished, this, [watcher, promise, parse]() mutable {
+      if (watcher->isCanceled())
+         promise.reportCanceled();
+      else
+         promise.reportResult(parse(watcher->result()));
+
+      promise.reportFinished();
+      watcher->deleteLater();
+   });
+   watcher->setFuture(run(workingDir, command));
+
+   return promise.future();
+}
+
+template<typename T, typename Continuation>
+void GitCommandPool::then(const QFuture<T> &future, QObject *context, Continuation continuation)
+{
+   // the watcher dies with the context, so the continuation never
+   // runs on an object that has already been destroyed
+   const auto watcher = new QFutureWatcher<T>(context);
+   connect(watcher, &QFutureWatcherBase::finished, context, [watcher, continuation]() {
+      if (!watcher->isCanceled())
+         continuation(watcher->result());
+
+      watcher->deleteLater();
+   });
+   watcher->setFuture(future);
+}
+
+template<typename T, typename Continuation>
+void GitCommandPool::whenAll(const QVector<QFuture<T>> &futures, QObject *context, Continuation continuation)
+{
+   if (futures.isEmpty())
+   {
+      continuation(QVector<T>());
+      return;
+   }
+
+   const auto results = QSharedPointer<QVector<T>>::create(futures.count());
+   const auto remaining = QSharedPointer<int>::create(futures.count());
+
+   for (auto i = 0; i < futures.count(); ++i)
+   {
+      then(futures.at(i), context, [results, remaining, i, continuation](const T &result) {
+         (*results)[i] = result;
+
+         if (--*remaining == 0)
+            continuation(*results);
+      });
+   }
+}
@@ -9,28 +9,39 @@ FORMS += \
 HEADERS += \
     $$PWD/AGitProcess.h \
     $$PWD/AddSubmoduleDlg.h \
+    $$PWD/BranchBitmaps.h \
     $$PWD/BranchContextMenu.h \
     $$PWD/BranchTreeWidget.h \
     $$PWD/BranchesViewDelegate.h \
     $$PWD/BranchesWidget.h \
+    $$PWD/ChangedPathFilters.h \
     $$PWD/ClickableFrame.h \
+    $$PWD/CommitGraph.h \
     $$PWD/CommitWidget.h \
     $$PWD/Controls.h \
+    $$PWD/DiffTreePrefetcher.h \
     $$PWD/FileContextMenu.h \
     $$PWD/FileDiffHighlighter.h \
     $$PWD/FileDiffView.h \
     $$PWD/FileDiffWidget.h \
+    $$PWD/FileListCache.h \
     $$PWD/FileListWidget.h \
     $$PWD/FullDiffWidget.h \
     $$PWD/GitAsyncProcess.h \
+    $$PWD/GitCatFileBatch.h \
+    $$PWD/GitCommandPool.h \
     $$PWD/GitQlient.h \
     $$PWD/GitQlientRepo.h \
     $$PWD/GitSyncProcess.h \
+    $$PWD/LogCache.h \
+    $$PWD/Reachability.h \
+    $$PWD/RecordScanner.h \
     $$PWD/RepositoryContextMenu.h \
     $$PWD/RepositoryModel.h \
     $$PWD/RepositoryModelColumns.h \
     $$PWD/RepositoryView.h \
     $$PWD/RepositoryViewDelegate.h \
+    $$PWD/RepositoryWatcher.h \
     $$PWD/Revision.h \
     $$PWD/RevisionFile.h \
     $$PWD/RevisionWidget.h \
@@ -39,6 +50,7 @@ HEADERS += \
     $$PWD/TagDlg.h \
     $$PWD/Terminal.h \
     $$PWD/UnstagedFilesContextMenu.h \
+    $$PWD/WipStatus.h \
     $$PWD/dataloader.h \
     $$PWD/domain.h \
     $$PWD/git.h \
@@ -48,27 +60,38 @@ HEADERS += \
 SOURCES += \
     $$PWD/AGitProcess.cpp \
     $$PWD/AddSubmoduleDlg.cpp \
+    $$PWD/BranchBitmaps.cpp \
     $$PWD/BranchContextMenu.cpp \
     $$PWD/BranchTreeWidget.cpp \
     $$PWD/BranchesViewDelegate.cpp \
     $$PWD/BranchesWidget.cpp \
+    $$PWD/ChangedPathFilters.cpp \
     $$PWD/ClickableFrame.cpp \
+    $$PWD/CommitGraph.cpp \
     $$PWD/CommitWidget.cpp \
     $$PWD/Controls.cpp \
+    $$PWD/DiffTreePrefetcher.cpp \
     $$PWD/FileContextMenu.cpp \
     $$PWD/FileDiffHighlighter.cpp \
     $$PWD/FileDiffView.cpp \
     $$PWD/FileDiffWidget.cpp \
+    $$PWD/FileListCache.cpp \
     $$PWD/FileListWidget.cpp \
     $$PWD/FullDiffWidget.cpp \
     $$PWD/GitAsyncProcess.cpp \
+    $$PWD/GitCatFileBatch.cpp \
+    $$PWD/GitCommandPool.cpp \
     $$PWD/GitQlient.cpp \
     $$PWD/GitQlientRepo.cpp \
     $$PWD/GitSyncProcess.cpp \
+    $$PWD/LogCache.cpp \
+    $$PWD/Reachability.cpp \
+    $$PWD/RecordScanner.cpp \
     $$PWD/RepositoryContextMenu.cpp \
     $$PWD/RepositoryModel.cpp \
     $$PWD/RepositoryView.cpp \
     $$PWD/RepositoryViewDelegate.cpp \
+    $$PWD/RepositoryWatcher.cpp \
     $$PWD/Revision.cpp \
     $$PWD/RevisionFile.cpp \
     $$PWD/RevisionWidget.cpp \
@@ -77,6 +100,7 @@ SOURCES += \
     $$PWD/TagDlg.cpp \
     $$PWD/Terminal.cpp \
     $$PWD/UnstagedFilesContextMenu.cpp \
+    $$PWD/WipStatus.cpp \
     $$PWD/dataloader.cpp \
     $$PWD/domain.cpp \
     $$PWD/git.cpp \
@@ -3,7 +3,7 @@ TEMPLATE = app
 CONFIG += qt warn_on c++17
 QMAKE_CXXFLAGS += -Werror
 TARGET = GitQlient
-QT += widgets
+QT += widgets concurrent
 
 # project files
 include(GitQlient.pri)
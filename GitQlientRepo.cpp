@@ -7,19 +7,22 @@
 #include <RevisionWidget.h>
 #include <RepositoryModelColumns.h>
 #include <RepositoryView.h>
+#include <RepositoryWatcher.h>
 #include <git.h>
+#include <GitCommandPool.h>
 #include <QLogger.h>
 #include <FileDiffWidget.h>
 #include <FullDiffWidget.h>
 #include <domain.h>
 #include <Revision.h>
 
-#include <QDirIterator>
-#include <QFileSystemWatcher>
+#include <QDialog>
 #include <QFileDialog>
+#include <QListWidget>
 #include <QMessageBox>
 #include <QStackedWidget>
 #include <QGridLayout>
+#include <QVBoxLayout>
 #include <QApplication>
 
 using namespace QLogger;
@@ -27,7 +30,7 @@ using namespace QLogger;
 GitQlientRepo::GitQlientRepo(const QString &repo, QWidget *parent)
    : QFrame(parent)
    , mGit(new Git())
-   , mRevisionsCache(new RevisionsCache(mGit))
+   , mRevisionsCache(new RevisionsCache())
    , mRepositoryView(new RepositoryView(mRevisionsCache, mGit))
    , commitStackedWidget(new QStackedWidget())
    , mainStackedWidget(new QStackedWidget())
@@ -37,6 +40,7 @@ GitQlientRepo::GitQlientRepo(const QString &repo, QWidget *parent)
    , mFullDiffWidget(new FullDiffWidget(mGit, mRevisionsCache))
    , mFileDiffWidget(new FileDiffWidget(mGit))
    , mBranchesWidget(new BranchesWidget(mGit))
+   , mWatcher(new RepositoryWatcher(mGit, this))
 {
    QLog_Info("UI", QString("Initializing GitQlient with repo {%1}").arg(repo));
 
@@ -87,9 +91,16 @@ GitQlientRepo::GitQlientRepo(const QString &repo, QWidget *parent)
    connect(mRepositoryView, &RepositoryView::doubleClicked, this, &GitQlientRepo::openCommitDiff);
    connect(mRepositoryView, &RepositoryView::signalAmendCommit, this, &GitQlientRepo::onAmendCommit);
 
+   connect(mGit.get(), &Git::wipRevisionUpdated, this, &GitQlientRepo::onWipRevisionUpdated);
+   connect(mGit.get(), &Git::refreshRequested, this, &GitQlientRepo::updateUi);
+
+   connect(mWatcher, &RepositoryWatcher::refsChanged, this, &GitQlientRepo::updateUi);
+   connect(mWatcher, &RepositoryWatcher::workingTreeChanged, this, &GitQlientRepo::updateUiFromWatcher);
+
    connect(mCommitWidget, &CommitWidget::signalChangesCommitted, this, &GitQlientRepo::changesCommitted);
    connect(mCommitWidget, &CommitWidget::signalCheckoutPerformed, this, &GitQlientRepo::updateUiFromWatcher);
    connect(mRevisionWidget, &RevisionWidget::signalOpenFileCommit, this, &GitQlientRepo::onFileDiffRequested);
+   connect(mRevisionWidget, &RevisionWidget::signalShowFileHistory, this, &GitQlientRepo::onFileHistoryRequested);
 
    setRepository(repo);
 }
@@ -100,14 +111,16 @@ void GitQlientRepo::updateUi()
    {
       QLog_Debug("UI", QString("Updating the GitQlient UI"));
 
-      mGit->init(mCurrentDir, mRevisionsCache);
+      // only the commits that are new are loaded, unless history was rewritten
+      if (mGit->refreshRevs() == Git::RefreshResult::RELOAD)
+      {
+         mGit->init(mCurrentDir, mRevisionsCache);
+         mRepositoryView->clear(true);
+         mGit->init2();
+      }
 
       mBranchesWidget->showBranches();
 
-      mRepositoryView->clear(true);
-
-      mGit->init2();
-
       const auto commitStackedIndex = commitStackedWidget->currentIndex();
       const auto currentSha = commitStackedIndex == 0 ? mRevisionWidget->getCurrentCommitSha() : ZERO_SHA;
 
@@ -123,11 +136,14 @@ void GitQlientRepo::updateUi()
 
 void GitQlientRepo::updateUiFromWatcher()
 {
-   const auto commitStackedIndex = commitStackedWidget->currentIndex();
+   if (commitStackedWidget->currentIndex() == 1)
+      mGit->updateWipRevisionAsync();
+}
 
-   if (commitStackedIndex == 1)
+void GitQlientRepo::onWipRevisionUpdated()
+{
+   if (commitStackedWidget->currentIndex() == 1)
    {
-      mGit->updateWipRevision();
       mCommitWidget->init(ZERO_SHA);
 
       if (mainStackedWidget->currentIndex() == 1)
@@ -145,8 +161,6 @@ void GitQlientRepo::setRepository(const QString &newDir)
 
       const auto oldDir = mCurrentDir;
 
-      resetWatcher(oldDir, newDir);
-
       bool archiveChanged;
 
       mGit->getBaseDir(newDir, mCurrentDir, archiveChanged);
@@ -159,6 +173,9 @@ void GitQlientRepo::setRepository(const QString &newDir)
          clearWindow(true);
          setWidgetsEnabled(true);
 
+         if (mCurrentDir != oldDir)
+            mWatcher->watch(mCurrentDir, mGit->getGitDir());
+
          mGit->init2();
 
          onCommitSelected(ZERO_SHA);
@@ -175,6 +192,7 @@ void GitQlientRepo::setRepository(const QString &newDir)
       else
       {
          mCurrentDir = "";
+         mWatcher->clear();
          clearWindow(true);
          setWidgetsEnabled(false);
       }
@@ -186,6 +204,7 @@ void GitQlientRepo::setRepository(const QString &newDir)
       QLog_Info("UI", QString("Repository is empty. Cleaning GitQlient"));
 
       mCurrentDir = "";
+      mWatcher->clear();
       clearWindow(true);
       setWidgetsEnabled(false);
    }
@@ -196,40 +215,6 @@ void GitQlientRepo::close()
    QWidget::close();
 }
 
-void GitQlientRepo::resetWatcher(const QString &oldDir, const QString &newDir)
-{
-   if (!mGitWatcher)
-   {
-      mGitWatcher = new QFileSystemWatcher(this);
-      connect(
-          mGitWatcher, &QFileSystemWatcher::fileChanged, this,
-          [this](const QString &path) {
-             if (!path.endsWith(".autosave") and !path.endsWith(".tmp") and !path.endsWith(".user"))
-                updateUiFromWatcher();
-          },
-          Qt::UniqueConnection);
-   }
-
-   if (oldDir != newDir)
-   {
-      QLog_Info("UI", QString("Setting the file watcher for dir {%1}").arg(newDir));
-
-      if (!oldDir.isEmpty())
-         mGitWatcher->removePath(oldDir);
-
-      mGitWatcher->addPath(newDir);
-
-      QDirIterator it(newDir, QDirIterator::Subdirectories);
-      while (it.hasNext())
-      {
-         const auto dir = it.next();
-
-         if (!dir.endsWith(".") and !dir.endsWith(".."))
-            mGitWatcher->addPath(dir);
-      }
-   }
-}
-
 void GitQlientRepo::clearWindow(bool deepClear)
 {
    blockSignals(true);
@@ -321,6 +306,49 @@ void GitQlientRepo::onFileDiffRequested(const QString &currentSha, const QString
       QMessageBox::information(this, tr("No modifications"), tr("There are no content modifications for this file"));
 }
 
+void GitQlientRepo::onFileHistoryRequested(const QString &file)
+{
+   QLog_Info("UI", QString("Requested history of file {%1}").arg(file));
+
+   // git only checks the candidates of the path filters when they cover the history
+   GitCommandPool::then(mGit->getFileHistory(file), this,
+                        [this, file](const QStringList &shas) { showFileHistory(file, shas); });
+}
+
+void GitQlientRepo::showFileHistory(const QString &file, const QStringList &shas)
+{
+   if (shas.isEmpty())
+   {
+      QMessageBox::information(this, tr("File history"), tr("No commit found changing this file"));
+      return;
+   }
+
+   QDialog dialog(this);
+   dialog.setWindowTitle(tr("History of %1").arg(file));
+   dialog.resize(600, 400);
+
+   const auto commits = new QListWidget();
+
+   for (const auto &sha : qAsConst(shas))
+   {
+      const auto item = new QListWidgetItem(QString("%1  %2").arg(sha.left(8), mRevisionsCache->getShortLog(sha)));
+      item->setData(Qt::UserRole, sha);
+      commits->addItem(item);
+   }
+
+   const auto layout = new QVBoxLayout(&dialog);
+   layout->addWidget(commits);
+
+   connect(commits, &QListWidget::itemDoubleClicked, &dialog, [this, &dialog](QListWidgetItem *item) {
+      const auto sha = item->data(Qt::UserRole).toString();
+      mRepositoryView->focusOnCommit(sha);
+      onCommitSelected(sha);
+      dialog.accept();
+   });
+
+   dialog.exec();
+}
+
 void GitQlientRepo::rebase(const QString &from, const QString &to, const QString &onto)
 {
    QApplication::setOverrideCursor(QCursor(Qt::WaitCursor));
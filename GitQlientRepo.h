@@ -28,7 +28,6 @@
 class RevisionsCache;
 class Git;
 class QCloseEvent;
-class QFileSystemWatcher;
 class QListWidgetItem;
 class QStackedWidget;
 class Controls;
@@ -38,6 +37,7 @@ class FullDiffControler;
 class FullDiffWidget;
 class FileDiffWidget;
 class RepositoryView;
+class RepositoryWatcher;
 class RevsView;
 class BranchesWidget;
 class FileDiffHighlighter;
@@ -80,18 +80,20 @@ private:
    RevsView *rv = nullptr;
    FullDiffWidget *mFullDiffWidget = nullptr;
    FileDiffWidget *mFileDiffWidget = nullptr;
-   QFileSystemWatcher *mGitWatcher = nullptr;
    BranchesWidget *mBranchesWidget = nullptr;
+   RepositoryWatcher *mWatcher = nullptr;
 
    void updateUi();
    void updateUiFromWatcher();
+   void onWipRevisionUpdated();
    void openCommitDiff();
    void changesCommitted(bool ok);
    void onCommitClicked(const QModelIndex &index);
    void onCommitSelected(const QString &goToSha);
    void onAmendCommit(const QString &sha);
    void onFileDiffRequested(const QString &currentSha, const QString &previousSha, const QString &file);
-   void resetWatcher(const QString &oldDir, const QString &newDir);
+   void onFileHistoryRequested(const QString &file);
+   void showFileHistory(const QString &file, const QStringList &shas);
    void clearWindow(bool deepClear);
    void setWidgetsEnabled(bool enabled);
    void executeCommand();
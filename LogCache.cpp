@@ -0,0 +1,221 @@
+#include "LogCache.h"
+
+#include <RevisionsCache.h>
+#include <Revision.h>
+#include <lanes.h>
+
+#include <QDataStream>
+#include <QDir>
+#include <QFile>
+
+#include <limits>
+
+namespace
+{
+const quint32 kMagic = 0xA0B0C0D1;
+const qint32 kVersion = 1;
+}
+
+const QString LogCache::kFileName = QString("qgit_log_cache.dat");
+
+LogCache::LogCache(const QString &gitDir)
+   : mPath(QString("%1/%2").arg(gitDir, kFileName))
+{
+}
+
+LogCache::~LogCache()
+{
+   // still owned only if the records were not handed to a RevisionsCache
+   delete mRecords;
+   delete mFile;
+}
+
+bool LogCache::load()
+{
+   mFile = new QFile(mPath);
+
+   if (!mFile->exists() || !mFile->open(QIODevice::ReadOnly))
+      return false;
+
+   QDataStream stream(mFile);
+   quint32 magic;
+   qint32 version;
+   stream >> magic;
+   stream >> version;
+
+   if (magic != kMagic || version != kVersion)
+      return false;
+
+   stream >> mTips;
+
+   qint32 lanesRows;
+   stream >> lanesRows;
+
+   mLanes.reserve(lanesRows);
+
+   for (auto i = 0; i < lanesRows; ++i)
+   {
+      QByteArray types;
+      stream >> types;
+
+      QVector<LaneType> lanes(types.size());
+      for (auto j = 0; j < types.size(); ++j)
+         lanes[j] = static_cast<LaneType>(types.at(j));
+
+      mLanes.append(lanes);
+   }
+
+   stream >> mLanesState;
+
+   if (stream.status() != QDataStream::Ok)
+      return false;
+
+   // the records follow, exactly as 'git log -z' wrote them
+   const auto recordsStart = mFile->pos();
+   const auto recordsSize = mFile->size() - recordsStart;
+
+   if (recordsSize <= 0 || recordsSize > std::numeric_limits<int>::max())
+      return false;
+
+   // a private mapping lets Revision write its '\0' fixups in place
+   const auto data = mFile->map(recordsStart, recordsSize, QFileDevice::MapPrivateOption);
+
+   if (!data)
+      return false;
+
+   mRecords = new QByteArray(
+       QByteArray::fromRawData(reinterpret_cast<const char *>(data), static_cast<int>(recordsSize)));
+
+   return true;
+}
+
+int LogCache::size() const
+{
+   return mRecords ? mRecords->size() : 0;
+}
+
+bool LogCache::appendTo(RevisionsCache *cache)
+{
+   if (!mRecords)
+      return false;
+
+   // check the whole file before touching the cache, a
+   // truncated or corrupted record makes it unusable
+   QVector<int> starts;
+   auto ofs = 0;
+
+   while (ofs < mRecords->size())
+   {
+      int next;
+      Revision revision(*mRecords, static_cast<uint>(ofs), -1, &next);
+
+      if (next <= ofs)
+         return false;
+
+      starts.append(ofs);
+      ofs = next;
+   }
+
+   const auto firstRow = cache->count();
+
+   for (auto i = 0; i < starts.count(); ++i)
+   {
+      int next;
+      Revision revision(*mRecords, static_cast<uint>(starts.at(i)), firstRow + i, &next);
+      cache->insertRevision(revision.sha(), revision);
+   }
+
+   cache->adoptLogBuffer(mRecords);
+   cache->adoptMappedFile(mFile);
+   mRecords = nullptr;
+   mFile = nullptr;
+
+   return true;
+}
+
+int LogCache::restoreLanes(RevisionsCache *cache, int firstRow, Lanes &lanes) const
+{
+   if (mLanes.isEmpty())
+      return 0;
+
+   for (auto i = 0; i < mLanes.count(); ++i)
+      cache->setLanes(firstRow + i, mLanes.at(i));
+
+   QDataStream stream(mLanesState);
+   lanes.read(stream, cache);
+
+   return mLanes.count();
+}
+
+bool LogCache::save(const QString &gitDir, const QStringList &tips, const RevisionsCache *cache, int firstRow,
+                    int lanesEnd, const Lanes &lanes)
+{
+   const auto path = QString("%1/%2").arg(gitDir, kFileName);
+   const auto tmpPath = QString("%1.bak").arg(path);
+
+   QDir dir;
+   if (gitDir.isEmpty() || !dir.exists(gitDir))
+      return false;
+
+   // lanes are saved only when they are a gap-free prefix of the saved records
+   auto lanesRows = qMax(0, qMin(lanesEnd, cache->count()) - firstRow);
+
+   for (auto row = firstRow; row < firstRow + lanesRows; ++row)
+   {
+      if (cache->revLookup(row)->isDiffCache || cache->lanesCount(row) == 0)
+      {
+         lanesRows = 0;
+         break;
+      }
+   }
+
+   QFile f(tmpPath);
+   if (!f.open(QIODevice::WriteOnly))
+      return false;
+
+   QDataStream stream(&f);
+   stream << kMagic;
+   stream << kVersion;
+   stream << tips;
+   stream << static_cast<qint32>(lanesRows);
+
+   for (auto row = firstRow; row < firstRow + lanesRows; ++row)
+   {
+      QByteArray types(cache->lanesCount(row), 0);
+      for (auto j = 0; j < types.size(); ++j)
+         types[j] = static_cast<char>(cache->lane(row, j));
+
+      stream << types;
+   }
+
+   QByteArray state;
+   if (lanesRows > 0)
+   {
+      QDataStream stateStream(&state, QIODevice::WriteOnly);
+      lanes.write(stateStream, cache);
+   }
+   stream << state;
+
+   for (auto row = firstRow; row < cache->count(); ++row)
+   {
+      const auto revision = cache->revLookup(row);
+      if (!revision->isDiffCache)
+         f.write(revision->rawData());
+   }
+
+   f.close();
+
+   if (f.error() != QFileDevice::NoError)
+   {
+      dir.remove(tmpPath);
+      return false;
+   }
+
+   if (dir.exists(path) && !dir.remove(path))
+   {
+      dir.remove(tmpPath);
+      return false;
+   }
+
+   return dir.rename(tmpPath, path);
+}
@@ -0,0 +1,66 @@
+#pragma once
+
+/****************************************************************************************
+ ** GitQlient is an application to manage and operate one or several Git repositories. With
+ ** GitQlient you will be able to add commits, branches and manage all the options Git provides.
+ ** Copyright (C) 2019  Francesc Martinez
+ **
+ ** LinkedIn: www.linkedin.com/in/cescmm/
+ ** Web: www.francescmm.com
+ **
+ ** This program is free software; you can redistribute it and/or
+ ** modify it under the terms of the GNU Lesser General Public
+ ** License as published by the Free Software Foundation; either
+ ** version 2 of the License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ ** Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public
+ ** License along with this library; if not, write to the Free Software
+ ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***************************************************************************************/
+
+
+#include <QStringList>
+#include <QVector>
+
+class QFile;
+class Lanes;
+class RevisionsCache;
+enum class LaneType : quint8;
+
+/* Persistent copy of the revisions table, stored next to the file cache.
+ * It keeps the raw 'git log' records of every loaded commit together with
+ * the ref tips they were loaded from, the lanes computed so far and the
+ * Lanes state to go on from there. On load the records are mapped in
+ * memory and parsed in place, so only the commits added since the cache
+ * was written have to be asked to git.
+ */
+class LogCache
+{
+public:
+   explicit LogCache(const QString &gitDir);
+   ~LogCache();
+
+   bool load();
+   QStringList tips() const { return mTips; }
+   int size() const;
+   bool appendTo(RevisionsCache *cache);
+   int restoreLanes(RevisionsCache *cache, int firstRow, Lanes &lanes) const;
+
+   static bool save(const QString &gitDir, const QStringList &tips, const RevisionsCache *cache, int firstRow,
+                    int lanesEnd, const Lanes &lanes);
+
+   static const QString kFileName;
+
+private:
+   QString mPath;
+   QFile *mFile = nullptr;
+   QByteArray *mRecords = nullptr;
+   QStringList mTips;
+   QVector<QVector<LaneType>> mLanes;
+   QByteArray mLanesState;
+};
@@ -0,0 +1,492 @@
+#include "Reachability.h"
+
+#include <RevisionsCache.h>
+#include <Revision.h>
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+
+Reachability::Reachability(RevisionsCache *cache, QObject *parent)
+   : QObject(parent)
+   , mCache(cache)
+{
+   mTimer.setSingleShot(true);
+   mTimer.setInterval(0);
+   connect(&mTimer, &QTimer::timeout, this, &Reachability::build);
+
+   clear();
+}
+
+void Reachability::clear()
+{
+   mTimer.stop();
+   mPendingGenerations.clear();
+   mPendingTags.clear();
+   mQueued.clear();
+   mLoaded.clear();
+   mGeneration.clear();
+   mParents.clear();
+   mChildren.clear();
+   mTagSet.clear();
+   mDescendantTags.clear();
+   mVisited.clear();
+   mWalk = 0;
+
+   // set 0 is the empty one, the default of every commit
+   mSets = { QBitArray() };
+   mSetIds.clear();
+   mSetIds.insert(QBitArray(), 0);
+   mTagUnions.clear();
+
+   // commit ids do not survive a clear of the cache, the tags get new slots
+   QVector<Ref> tags;
+
+   for (const auto &tag : qAsConst(mTags))
+      if (!tag.first.isEmpty())
+         tags.append(tag);
+
+   mTags.clear();
+   mTagCommits.clear();
+   mTagSlots.clear();
+   mTagsAt.clear();
+
+   setTags(tags);
+}
+
+void Reachability::setTags(const QVector<Ref> &tags)
+{
+   QHash<Ref, int> slots;
+
+   for (const auto &tag : tags)
+   {
+      auto slot = slots.value(tag, mTagSlots.value(tag, -1));
+
+      if (slot == -1)
+      {
+         slot = mTags.count();
+         mTags.append(tag);
+         mTagCommits.append(-1);
+         setTagCommit(slot, id(tag.second));
+      }
+
+      slots.insert(tag, slot);
+   }
+
+   // a moved tag is removed from its old commit and added as a new one
+   for (auto it = mTagSlots.constBegin(); it != mTagSlots.constEnd(); ++it)
+      if (!slots.contains(it.key()))
+         removeTag(it.value());
+
+   mTagSlots = slots;
+
+   if (!mPendingTags.isEmpty())
+      mTimer.start();
+}
+
+void Reachability::addRows(int row, int count)
+{
+   QVector<int> ids;
+   ids.reserve(count);
+
+   for (auto i = row; i < row + count; ++i)
+      ids.append(mCache->commitId(i));
+
+   // the pending rows stay sorted, the new ones go where they were inserted
+   const auto it = std::find_if(mPendingGenerations.constBegin(), mPendingGenerations.constEnd(),
+                                [this, row](int c) { return mCache->commitRow(c) >= row; });
+   const auto pos = static_cast<int>(it - mPendingGenerations.constBegin());
+
+   mPendingGenerations.insert(pos, ids.count(), -1);
+   std::copy(ids.constBegin(), ids.constEnd(), mPendingGenerations.begin() + pos);
+
+   // new rows can hold tags that were waiting for their commit
+   mTagUnions.clear();
+
+   if (!mPendingGenerations.isEmpty())
+      mTimer.start();
+}
+
+void Reachability::build()
+{
+   if (!run(SLICE_MS))
+      mTimer.start();
+}
+
+void Reachability::finish()
+{
+   // a query can not wait for the remaining steps
+   mTimer.stop();
+   run(-1);
+}
+
+bool Reachability::run(int budgetMs)
+{
+   QElapsedTimer elapsed;
+   elapsed.start();
+
+   auto steps = 0;
+   const auto outOfTime = [&]() { return budgetMs >= 0 && ++steps % 256 == 0 && elapsed.elapsed() >= budgetMs; };
+
+   // the generations of all the rows come first, the tags use them to find the nearest ones
+   while (!mPendingGenerations.isEmpty())
+   {
+      computeGeneration(mPendingGenerations.takeLast());
+
+      if (outOfTime())
+         return false;
+   }
+
+   const auto below = [this](int left, int right) { return isBelow(left, right); };
+
+   while (!mPendingTags.isEmpty())
+   {
+      std::pop_heap(mPendingTags.begin(), mPendingTags.end(), below);
+      computeTags(mPendingTags.takeLast());
+
+      if (outOfTime())
+         return false;
+   }
+
+   return true;
+}
+
+void Reachability::computeGeneration(int c)
+{
+   const auto row = mCache->commitRow(c);
+
+   if (row == -1 || isLoaded(c))
+      return;
+
+   const auto r = mCache->revLookup(row);
+
+   // the working dir is not part of the history
+   if (r->isDiffCache)
+      return;
+
+   grow(c);
+
+   // parents are below, so they are done unless they are not loaded
+   const auto parentsCount = static_cast<int>(r->parentsCount());
+   QVector<int> parents;
+   parents.reserve(parentsCount);
+   auto generation = 0;
+
+   for (auto i = 0; i < parentsCount; ++i)
+   {
+      const auto p = mCache->parentId(row, i);
+      grow(p);
+      parents.append(p);
+      mChildren[p].append(c);
+
+      if (isLoaded(p))
+         generation = qMax(generation, mGeneration.at(p));
+   }
+
+   mParents[c] = parents;
+   mGeneration[c] = generation + 1;
+   mLoaded.setBit(c);
+
+   queueTags(c);
+}
+
+void Reachability::computeTags(int c)
+{
+   mQueued.clearBit(c);
+
+   if (!isLoaded(c))
+      return;
+
+   // a tag here is nearer than any tag of the children
+   auto set = 0;
+   auto descendants = 0;
+   const auto ownTags = mTagsAt.value(c);
+
+   for (auto child : mChildren.at(c))
+   {
+      if (isLoaded(child))
+      {
+         descendants = uniteSets(descendants, descendantsAndOwn(child));
+
+         if (ownTags.isEmpty())
+            set = uniteTags(set, mTagSet.at(child));
+      }
+   }
+
+   if (!ownTags.isEmpty())
+      set = ownSet(ownTags);
+
+   if (set == mTagSet.at(c) && descendants == mDescendantTags.at(c))
+      return;
+
+   // only the ancestors of a changed commit can change too
+   mTagSet[c] = set;
+   mDescendantTags[c] = descendants;
+
+   for (auto p : mParents.at(c))
+      if (isLoaded(p))
+         queueTags(p);
+}
+
+void Reachability::queueTags(int c)
+{
+   if (mQueued.testBit(c))
+      return;
+
+   mQueued.setBit(c);
+   mPendingTags.append(c);
+   std::push_heap(mPendingTags.begin(), mPendingTags.end(),
+                  [this](int left, int right) { return isBelow(left, right); });
+}
+
+bool Reachability::isBelow(int left, int right) const
+{
+   // the heap gives the top row first, children are done before their parents
+   return mCache->commitRow(left) > mCache->commitRow(right);
+}
+
+void Reachability::setTagCommit(int slot, int c)
+{
+   mTagCommits[slot] = c;
+
+   if (c == -1)
+      return;
+
+   // the tags below the ancestors change, so do the unions of their tags
+   mTagUnions.clear();
+
+   mTagsAt[c].append(slot);
+
+   if (isLoaded(c))
+      queueTags(c);
+}
+
+void Reachability::removeTag(int slot)
+{
+   const auto c = mTagCommits.at(slot);
+
+   mTags[slot] = Ref();
+   mTagCommits[slot] = -1;
+
+   if (c == -1)
+      return;
+
+   mTagUnions.clear();
+
+   auto &slots = mTagsAt[c];
+   slots.removeOne(slot);
+
+   if (slots.isEmpty())
+      mTagsAt.remove(c);
+
+   if (isLoaded(c))
+      queueTags(c);
+}
+
+void Reachability::grow(int id)
+{
+   if (id < mGeneration.count())
+      return;
+
+   const auto size = qMax(id + 1, 2 * mGeneration.count());
+
+   mQueued.resize(size);
+   mLoaded.resize(size);
+   mGeneration.resize(size);
+   mParents.resize(size);
+   mChildren.resize(size);
+   mTagSet.resize(size);
+   mDescendantTags.resize(size);
+   mVisited.resize(size);
+}
+
+QStringList Reachability::children(const QString &sha)
+{
+   finish();
+
+   QStringList shas;
+   const auto c = id(sha);
+
+   if (c < mChildren.count())
+   {
+      for (auto child : mChildren.at(c))
+         shas.append(mCache->commitSha(child));
+   }
+
+   return shas;
+}
+
+QStringList Reachability::nearestDescendantTags(const QString &sha)
+{
+   finish();
+
+   const auto c = id(sha);
+
+   return isLoaded(c) ? names(mTagSet.at(c), mTags) : QStringList();
+}
+
+QStringList Reachability::nearestAncestorTags(const QString &sha)
+{
+   finish();
+
+   const auto c = id(sha);
+
+   if (!isLoaded(c))
+      return QStringList();
+
+   if (mTagsAt.contains(c))
+      return tagNames({ c });
+
+   // walk down to the first tagged commits of every path
+   QVector<int> found;
+   QVector<int> stack { c };
+   const auto walk = ++mWalk;
+
+   while (!stack.isEmpty())
+   {
+      const auto node = stack.takeLast();
+
+      for (auto p : mParents.at(node))
+      {
+         if (!isLoaded(p) || mVisited.at(p) == walk)
+            continue;
+
+         mVisited[p] = walk;
+
+         if (mTagsAt.contains(p))
+            found.append(p);
+         else
+            stack.append(p);
+      }
+   }
+
+   // a tag below another one found is not the nearest
+   auto below = 0;
+
+   for (auto t : qAsConst(found))
+      below = uniteSets(below, mDescendantTags.at(t));
+
+   const auto &belowBits = mSets.at(below);
+   QVector<int> nearest;
+
+   for (auto t : qAsConst(found))
+   {
+      const auto slot = mTagsAt.value(t).constFirst();
+
+      if (slot >= belowBits.size() || !belowBits.testBit(slot))
+         nearest.append(t);
+   }
+
+   return tagNames(nearest);
+}
+
+int Reachability::internSet(QBitArray bits)
+{
+   // trailing zeros are dropped, so a set reads the same whatever the tags count
+   auto size = bits.size();
+
+   while (size > 0 && !bits.testBit(size - 1))
+      --size;
+
+   bits.truncate(size);
+
+   const auto it = mSetIds.constFind(bits);
+
+   if (it != mSetIds.constEnd())
+      return it.value();
+
+   const auto set = mSets.count();
+   mSets.append(bits);
+   mSetIds.insert(bits, set);
+
+   return set;
+}
+
+int Reachability::ownSet(const QVector<int> &refs)
+{
+   QBitArray bits(mTags.count());
+
+   for (auto ref : refs)
+      bits.setBit(ref);
+
+   return internSet(bits);
+}
+
+int Reachability::uniteTags(int left, int right)
+{
+   if (left == right || right == 0)
+      return left;
+
+   if (left == 0)
+      return right;
+
+   const auto key = qMakePair(qMin(left, right), qMax(left, right));
+   const auto it = mTagUnions.constFind(key);
+
+   if (it != mTagUnions.constEnd())
+      return it.value();
+
+   // only the nearest tags are kept, the ones below another tag of the union are dropped
+   auto bits = mSets.at(left) | mSets.at(right);
+   QBitArray below(bits.size());
+
+   for (auto t = 0; t < bits.size(); ++t)
+   {
+      // a removed tag is still in the sets not computed again yet
+      const auto tagged = bits.testBit(t) ? mTagCommits.at(t) : -1;
+
+      if (isLoaded(tagged))
+         below |= mSets.at(mDescendantTags.at(tagged));
+   }
+
+   const auto set = internSet(bits & ~below);
+   mTagUnions.insert(key, set);
+
+   return set;
+}
+
+int Reachability::uniteSets(int left, int right)
+{
+   if (left == right || right == 0)
+      return left;
+
+   if (left == 0)
+      return right;
+
+   return internSet(mSets.at(left) | mSets.at(right));
+}
+
+int Reachability::descendantsAndOwn(int c)
+{
+   const auto ownTags = mTagsAt.value(c);
+
+   return ownTags.isEmpty() ? mDescendantTags.at(c) : uniteSets(mDescendantTags.at(c), ownSet(ownTags));
+}
+
+QStringList Reachability::names(int set, const QVector<Ref> &refs) const
+{
+   QStringList names;
+   const auto &bits = mSets.at(set);
+
+   for (auto i = 0; i < bits.size(); ++i)
+      if (bits.testBit(i))
+         names.append(refs.at(i).first);
+
+   return names;
+}
+
+QStringList Reachability::tagNames(const QVector<int> &commits) const
+{
+   QStringList names;
+
+   for (auto c : commits)
+      for (auto t : mTagsAt.value(c))
+         names.append(mTags.at(t).first);
+
+   return names;
+}
+
+int Reachability::id(const QString &sha)
+{
+   return mCache->commitId(sha);
+}
@@ -0,0 +1,121 @@
+#pragma once
+
+/****************************************************************************************
+ ** GitQlient is an application to manage and operate one or several Git repositories. With
+ ** GitQlient you will be able to add commits, branches and manage all the options Git provides.
+ ** Copyright (C) 2019  Francesc Martinez
+ **
+ ** LinkedIn: www.linkedin.com/in/cescmm/
+ ** Web: www.francescmm.com
+ **
+ ** This program is free software; you can redistribute it and/or
+ ** modify it under the terms of the GNU Lesser General Public
+ ** License as published by the Free Software Foundation; either
+ ** version 2 of the License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ ** Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public
+ ** License along with this library; if not, write to the Free Software
+ ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***************************************************************************************/
+
+#include <QBitArray>
+#include <QHash>
+#include <QObject>
+#include <QPair>
+#include <QStringList>
+#include <QTimer>
+#include <QVector>
+
+class RevisionsCache;
+
+/* Ancestry of the loaded commits, built in small steps from the rows
+ * handed to addRows(). Every commit gets a generation number one above
+ * the highest of its parents, computed from the bottom of the new rows
+ * up, so the rows a refresh inserts on top are the only ones visited:
+ * an ancestor always has a lower generation than its descendants, which
+ * bounds every walk looking for it. The nearest tags containing a commit
+ * are a bitmap over the tags, next to the bitmap of all the tags on its
+ * descendants: a tag is not the nearest when it is among the descendant
+ * tags of another one, so the union of the children needs no walk. Most
+ * commits share their bitmaps with their neighbours, so each distinct
+ * bitmap is stored once and commits keep only its index. A tag added or
+ * removed only updates the bitmaps of the ancestors of its commit. The
+ * branches containing a commit are in BranchBitmaps.
+ */
+class Reachability : public QObject
+{
+   Q_OBJECT
+
+public:
+   using Ref = QPair<QString, QString>; // name and commit
+
+   explicit Reachability(RevisionsCache *cache, QObject *parent = nullptr);
+
+   void clear();
+   void setTags(const QVector<Ref> &tags);
+   void addRows(int row, int count);
+
+   bool isBuilt() const { return mPendingGenerations.isEmpty() && mPendingTags.isEmpty(); }
+   QStringList children(const QString &sha);
+   QStringList nearestDescendantTags(const QString &sha);
+   QStringList nearestAncestorTags(const QString &sha);
+
+private:
+   static const int SLICE_MS = 8; // time budget of each building step
+
+   RevisionsCache *mCache = nullptr;
+   QTimer mTimer;
+
+   // tag slots are only appended, a removed tag leaves its slot empty
+   QVector<Ref> mTags;
+   QVector<int> mTagCommits; // -1 for the removed ones
+   QHash<Ref, int> mTagSlots;
+   QHash<int, QVector<int>> mTagsAt; // commit id -> tags pointing there
+
+   // commit ids still without generation, in row order, done from the last
+   QVector<int> mPendingGenerations;
+   // commit ids whose tags must be computed again, a heap on their row
+   QVector<int> mPendingTags;
+   QBitArray mQueued;
+
+   // indexed by commit id, a parent not loaded yet only knows its children
+   QBitArray mLoaded;
+   QVector<int> mGeneration;
+   QVector<QVector<int>> mParents;
+   QVector<QVector<int>> mChildren;
+   QVector<int> mTagSet;
+   QVector<int> mDescendantTags; // the tags of all the descendants, its own ones excluded
+
+   QVector<QBitArray> mSets;
+   QHash<QBitArray, int> mSetIds;
+   QHash<QPair<int, int>, int> mTagUnions; // valid until the tags of a commit change
+
+   // walks mark the commits they visit with their own number
+   QVector<int> mVisited;
+   int mWalk = 0;
+
+   void build();
+   void finish();
+   bool run(int budgetMs);
+   void computeGeneration(int c);
+   void computeTags(int c);
+   void queueTags(int c);
+   void setTagCommit(int slot, int c);
+   void removeTag(int slot);
+   void grow(int id);
+   bool isLoaded(int id) const { return id >= 0 && id < mLoaded.size() && mLoaded.testBit(id); }
+   bool isBelow(int left, int right) const;
+   int internSet(QBitArray bits);
+   int uniteTags(int left, int right);
+   int ownSet(const QVector<int> &refs);
+   int uniteSets(int left, int right);
+   int descendantsAndOwn(int c);
+   QStringList names(int set, const QVector<Ref> &refs) const;
+   QStringList tagNames(const QVector<int> &commits) const;
+   int id(const QString &sha);
+};
@@ -0,0 +1,146 @@
+#include "RecordScanner.h"
+
+#include <QtAlgorithms>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <immintrin.h>
+#define RECORD_SCANNER_SSE2
+// the AVX2 kernel is built for every x86 target and only run where supported
+#if defined(__GNUC__)
+#define RECORD_SCANNER_AVX2 __attribute__((target("avx2")))
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define RECORD_SCANNER_AVX2
+#endif
+#endif
+
+namespace
+{
+const int EXPECTED_RECORD_SIZE = 256;
+
+template<typename Visitor>
+inline void visitMask(int pos, quint32 mask, Visitor &visit)
+{
+   while (mask)
+   {
+      visit(pos + static_cast<int>(qCountTrailingZeroBits(mask)));
+      mask &= mask - 1;
+   }
+}
+
+#if defined(RECORD_SCANNER_AVX2)
+bool hasAvx2()
+{
+#if defined(__GNUC__)
+   __builtin_cpu_init();
+   return __builtin_cpu_supports("avx2");
+#else
+   int info[4];
+   __cpuid(info, 0);
+
+   if (info[0] < 7)
+      return false;
+
+   // the OS must save the YMM registers too
+   __cpuid(info, 1);
+   const auto osxsave = (info[2] & (1 << 27)) != 0;
+   const auto avx = (info[2] & (1 << 28)) != 0;
+
+   if (!osxsave || !avx || (_xgetbv(0) & 6) != 6)
+      return false;
+
+   __cpuidex(info, 7, 0);
+   return (info[1] & (1 << 5)) != 0;
+#endif
+}
+
+// one bit for each '\0' or '\n' of the 32 bytes blocks, returns where the blocks end
+template<typename Visitor>
+RECORD_SCANNER_AVX2 int scanAvx2(const char *data, int pos, int to, Visitor &visit)
+{
+   for (; pos + 32 <= to; pos += 32)
+   {
+      const auto bytes = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(data + pos));
+      const auto nul = _mm256_cmpeq_epi8(bytes, _mm256_setzero_si256());
+      const auto newLine = _mm256_cmpeq_epi8(bytes, _mm256_set1_epi8('\n'));
+
+      visitMask(pos, static_cast<quint32>(_mm256_movemask_epi8(_mm256_or_si256(nul, newLine))), visit);
+   }
+
+   return pos;
+}
+#endif
+
+#if defined(RECORD_SCANNER_SSE2)
+// the same 16 bytes at a time
+template<typename Visitor>
+int scanSse2(const char *data, int pos, int to, Visitor &visit)
+{
+   for (; pos + 16 <= to; pos += 16)
+   {
+      const auto bytes = _mm_loadu_si128(reinterpret_cast<const __m128i *>(data + pos));
+      const auto nul = _mm_cmpeq_epi8(bytes, _mm_setzero_si128());
+      const auto newLine = _mm_cmpeq_epi8(bytes, _mm_set1_epi8('\n'));
+
+      visitMask(pos, static_cast<quint32>(_mm_movemask_epi8(_mm_or_si128(nul, newLine))), visit);
+   }
+
+   return pos;
+}
+#endif
+
+template<typename Visitor>
+void forEachDelimiter(const char *data, int from, int to, Visitor &&visit)
+{
+   auto pos = from;
+
+#if defined(RECORD_SCANNER_AVX2)
+   static const auto avx2 = hasAvx2();
+
+   if (avx2)
+      pos = scanAvx2(data, pos, to, visit);
+#endif
+
+#if defined(RECORD_SCANNER_SSE2)
+   pos = scanSse2(data, pos, to, visit);
+#endif
+
+   // the tail shorter than a block, or everything without SIMD
+   for (; pos < to; ++pos)
+   {
+      if (data[pos] == '\0' || data[pos] == '\n')
+         visit(pos);
+   }
+}
+}
+
+QVector<RecordScanner::Record> RecordScanner::scan(const QByteArray &buffer, int start, int end)
+{
+   QVector<Record> records;
+   records.reserve((end - start) / EXPECTED_RECORD_SIZE + 1);
+
+   const auto data = buffer.constData();
+   Record record;
+   record.start = start;
+
+   // a trailing record without its '\0' is left out
+   forEachDelimiter(data, start, end, [&](int pos) {
+      if (data[pos] == '\0')
+      {
+         record.end = pos;
+         records.append(record);
+
+         record = Record();
+         record.start = pos + 1;
+      }
+      else if (record.linesCount == 0 && data[record.start] == 'F')
+      {
+         record.finalOutput = true;
+         record.start = pos + 1;
+      }
+      else if (record.linesCount < HEADER_LINES)
+         record.lineEnds[record.linesCount++] = pos;
+   });
+
+   return records;
+}
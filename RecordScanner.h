@@ -0,0 +1,52 @@
+#pragma once
+
+/****************************************************************************************
+ ** GitQlient is an application to manage and operate one or several Git repositories. With
+ ** GitQlient you will be able to add commits, branches and manage all the options Git provides.
+ ** Copyright (C) 2019  Francesc Martinez
+ **
+ ** LinkedIn: www.linkedin.com/in/cescmm/
+ ** Web: www.francescmm.com
+ **
+ ** This program is free software; you can redistribute it and/or
+ ** modify it under the terms of the GNU Lesser General Public
+ ** License as published by the Free Software Foundation; either
+ ** version 2 of the License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ ** Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public
+ ** License along with this library; if not, write to the Free Software
+ ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***************************************************************************************/
+
+
+#include <QByteArray>
+#include <QVector>
+
+/* Splits a block of 'git log' output into its records in a single pass,
+ * finding every '\0' and '\n' 32 bytes at a time when the CPU supports
+ * AVX2, checked at run time, 16 with SSE2, byte by byte otherwise. For each
+ * record it gives where the header lines end, so a Revision is indexed
+ * without searching its data again. See Revision::indexData() for the record layout.
+ */
+class RecordScanner
+{
+public:
+   // log size, sha and parents, committer, author, author date and subject
+   static const int HEADER_LINES = 6;
+
+   struct Record
+   {
+      int start = 0;
+      int end = 0; // position of the terminating '\0'
+      bool finalOutput = false; // preceded by the "Final output" line of --early-output
+      int linesCount = 0;
+      int lineEnds[HEADER_LINES] = {}; // the '\n' of the first lines
+   };
+
+   static QVector<Record> scan(const QByteArray &buffer, int start, int end);
+};
@@ -8,18 +8,32 @@
 */
 
 #include "RepositoryModel.h"
+#include <GitCommandPool.h>
 #include <RepositoryModelColumns.h>
 #include <RevisionsCache.h>
 #include <Revision.h>
 
 #include <QApplication>
 #include <QDateTime>
+#include <QElapsedTimer>
 #include <QFontMetrics>
-
-#include "lanes.h"
+#include <QtConcurrent/QtConcurrentRun>
 
 #include "git.h"
 
+namespace
+{
+// background lanes computation, time budget and granularity of each step
+const int LANES_SLICE_MS = 8;
+const int LANES_SLICE_ROWS = 256;
+
+// branches containing a commit listed in its tooltip
+const int TOOLTIP_MAX_BRANCHES = 10;
+
+// subjects and dates formatted for display kept around
+const int DISPLAY_CACHE_SIZE = 512;
+}
+
 RepositoryModel::RepositoryModel(QSharedPointer<RevisionsCache> revCache, QSharedPointer<Git> git, QObject *p)
    : QAbstractItemModel(p)
    , mRevCache(revCache)
@@ -27,6 +41,9 @@ RepositoryModel::RepositoryModel(QSharedPointer<RevisionsCache> revCache, QShare
 {
    mGit->setDefaultModel(this);
 
+   mSubjectCache.setMaxCost(DISPLAY_CACHE_SIZE);
+   mDateCache.setMaxCost(DISPLAY_CACHE_SIZE);
+
    mColumns.insert(RepositoryModelColumns::GRAPH, "Graph");
    mColumns.insert(RepositoryModelColumns::ID, "Id");
    mColumns.insert(RepositoryModelColumns::SHA, "Sha");
@@ -37,9 +54,16 @@ RepositoryModel::RepositoryModel(QSharedPointer<RevisionsCache> revCache, QShare
    lns = new Lanes();
    clear(); // after _headerInfo is set
 
+   lanesTimer.setSingleShot(true);
+   lanesTimer.setInterval(0);
+   connect(&lanesTimer, &QTimer::timeout, this, &RepositoryModel::on_computeLanes);
+
+   lanesJobTimer.setSingleShot(true);
+   lanesJobTimer.setInterval(0);
+   connect(&lanesJobTimer, &QTimer::timeout, this, &RepositoryModel::applyLanesSlice);
+
    connect(mGit.get(), &Git::newRevsAdded, this, &RepositoryModel::on_newRevsAdded);
    connect(mGit.get(), &Git::loadCompleted, this, &RepositoryModel::on_loadCompleted);
-   connect(mRevCache.get(), &RevisionsCache::signalCacheUpdated, this, &RepositoryModel::on_newRevsAdded);
 }
 
 RepositoryModel::~RepositoryModel()
@@ -78,12 +102,288 @@ void RepositoryModel::flushTail()
 {
    beginResetModel();
    mRevCache->flushTail(earlyOutputCnt, earlyOutputCntBase);
+   mSubjectCache.clear();
    firstFreeLane = static_cast<unsigned int>(earlyOutputCntBase);
    lns->clear();
+   clearLaneCheckpoints(earlyOutputCntBase);
+   ++lanesGeneration;
    rowCnt = mRevCache->count();
    endResetModel();
 }
 
+void RepositoryModel::insertRevisions(int row, const QVector<Revision> &revisions,
+                                      const QVector<RevisionsCache::Columns> &columns)
+{
+   if (revisions.isEmpty())
+      return;
+
+   const auto oldCount = mRevCache->count();
+
+   beginInsertRows(QModelIndex(), row, row + revisions.count() - 1);
+   mRevCache->insertRevisions(row, revisions, columns);
+   mSubjectCache.clear();
+
+   const auto n = mRevCache->count() - oldCount;
+
+   // lanes from here on will be redrawn, the ones already computed below
+   // the new rows stay valid once the recomputation converges
+   QMap<int, Lanes> stale;
+
+   for (auto it = laneCheckpoints.lowerBound(row); it != laneCheckpoints.end(); ++it)
+      stale.insert(it.key() + n, it.value());
+
+   const auto lanesEnd = static_cast<int>(firstFreeLane);
+
+   clearLaneCheckpoints(row);
+
+   if (lanesEnd > row)
+   {
+      staleCheckpoints = stale;
+      staleLanesEnd = lanesEnd + n;
+      staleLanesEndState = *lns;
+   }
+
+   firstFreeLane = static_cast<uint>(row);
+   lns->clear();
+   ++lanesGeneration;
+
+   rowCnt += n;
+   endInsertRows();
+
+   scheduleLanes();
+}
+
+void RepositoryModel::revisionUpdated(int row)
+{
+   mSubjectCache.remove(row);
+   emit dataChanged(index(row, 0), index(row, columnCount(QModelIndex()) - 1));
+}
+
+void RepositoryModel::scheduleLanes()
+{
+   // the steps wait for a job computing the rows they would do
+   if (!lanesJobRunning && !lanesTimer.isActive() && static_cast<int>(firstFreeLane) < mRevCache->count())
+      lanesTimer.start();
+}
+
+void RepositoryModel::stepLanes(const RevisionsCache::Topology &topology, int row, Lanes &state,
+                                QVector<LaneType> &lanes)
+{
+   const auto flags = topology.flags.at(row);
+   const auto parents = topology.parents.mid(topology.parentsStart.at(row), topology.parentsCount.at(row));
+
+   state.step(topology.ids.at(row), parents, flags & RevisionsCache::Topology::BOUNDARY,
+              flags & RevisionsCache::Topology::APPLIED, lanes);
+}
+
+void RepositoryModel::computeLanesAhead(int row)
+{
+   // one job at a time, a later jump is done once it ends
+   if (lanesJobRunning)
+   {
+      lanesJobTarget = row;
+      return;
+   }
+
+   lanesTimer.stop();
+   lanesJobRunning = true;
+   lanesJobTarget = -1;
+
+   // only shared copies are taken here, the rows are read by the thread
+   LanesJob job;
+   job.from = static_cast<int>(firstFreeLane);
+   job.topology = mRevCache->topology();
+   job.state = *lns;
+   job.staleCheckpoints = staleCheckpoints;
+   job.staleLanesEnd = staleLanesEnd;
+
+   // a bit past the row asked, the rows around it are shown too
+   job.end = qMin(row + LANES_SLICE_ROWS, mRevCache->count());
+
+   const auto generation = lanesGeneration;
+
+   GitCommandPool::then(QtConcurrent::run(&RepositoryModel::runLanesJob, job), this,
+                        [this, generation](const LanesJob &done) { applyLanesJob(done, generation); });
+}
+
+RepositoryModel::LanesJob RepositoryModel::runLanesJob(LanesJob job)
+{
+   // the same steps as Git::computeLanes(), on the copy of the topology
+   auto &l = job.state;
+   QVector<LaneType> lanes;
+   auto i = job.from;
+
+   job.lanesStart.reserve(qMax(0, job.end - job.from) + 1);
+
+   for (; i < job.end; ++i)
+   {
+      if (i < job.staleLanesEnd && job.staleCheckpoints.contains(i) && l == job.staleCheckpoints.value(i))
+      {
+         job.converged = true;
+         break;
+      }
+
+      if (i % LANES_CHECKPOINT_INTERVAL == 0 && !l.isEmpty())
+         job.checkpoints.insert(i, l);
+
+      job.lanesStart.append(job.lanes.count());
+
+      // the working dir revision has its own lanes
+      if (job.topology.flags.at(i) & RevisionsCache::Topology::WORKING_DIR)
+         continue;
+
+      lanes.clear();
+      stepLanes(job.topology, i, l, lanes);
+      job.lanes.append(lanes);
+   }
+
+   job.end = qMax(job.from, i);
+   job.lanesStart.append(job.lanes.count());
+
+   // the cache is not needed anymore, its arrays are not kept shared
+   job.topology = RevisionsCache::Topology();
+
+   return job;
+}
+
+void RepositoryModel::applyLanesJob(const LanesJob &job, int generation)
+{
+   lanesJob = job;
+   lanesJobGeneration = generation;
+
+   // the rows computed meanwhile on this thread got the same lanes
+   lanesJobRow = qMax(job.from, static_cast<int>(firstFreeLane));
+   lanesJobWindow = qMax(lanesJobRow, job.end - 2 * LANES_SLICE_ROWS);
+
+   if (generation != lanesGeneration || job.end <= lanesJobRow)
+   {
+      finishLanesJob();
+      return;
+   }
+
+   // the rows shown after the jump first, the rest in the background
+   copyLanes(lanesJobWindow, job.end);
+   applyLanesSlice();
+}
+
+void RepositoryModel::applyLanesSlice()
+{
+   // rows changed while copying, the lanes of the job are not valid anymore
+   if (lanesJobGeneration != lanesGeneration)
+   {
+      finishLanesJob();
+      return;
+   }
+
+   // the rows computed on this thread in the meantime are skipped
+   lanesJobRow = qMax(lanesJobRow, static_cast<int>(firstFreeLane));
+
+   QElapsedTimer elapsed;
+   elapsed.start();
+
+   while (lanesJobRow < lanesJobWindow && elapsed.elapsed() < LANES_SLICE_MS)
+      lanesJobRow = copyLanes(lanesJobRow, qMin(lanesJobRow + LANES_SLICE_ROWS, lanesJobWindow));
+
+   if (lanesJobRow < lanesJobWindow)
+   {
+      lanesJobTimer.start();
+      return;
+   }
+
+   const auto &job = lanesJob;
+   const auto from = static_cast<int>(firstFreeLane);
+
+   if (job.end > from)
+   {
+      for (auto it = job.checkpoints.lowerBound(from); it != job.checkpoints.constEnd(); ++it)
+         laneCheckpoints.insert(it.key(), it.value());
+
+      *lns = job.state;
+      firstFreeLane = static_cast<uint>(job.end);
+
+      if (job.converged)
+      {
+         for (auto it = staleCheckpoints.lowerBound(job.end); it != staleCheckpoints.constEnd(); ++it)
+            laneCheckpoints.insert(it.key(), it.value());
+
+         *lns = staleLanesEndState;
+         firstFreeLane = static_cast<uint>(staleLanesEnd);
+      }
+
+      if (job.converged || job.end >= staleLanesEnd)
+      {
+         staleCheckpoints.clear();
+         staleLanesEnd = 0;
+      }
+   }
+
+   finishLanesJob();
+}
+
+int RepositoryModel::copyLanes(int from, int to)
+{
+   const auto &job = lanesJob;
+
+   for (auto i = from; i < to; ++i)
+   {
+      const auto start = job.lanesStart.at(i - job.from);
+      const auto count = job.lanesStart.at(i - job.from + 1) - start;
+
+      if (count > 0)
+         mRevCache->setLanes(i, job.lanes.constData() + start, count);
+   }
+
+   const auto graphColumn = static_cast<int>(RepositoryModelColumns::GRAPH);
+   const auto last = qMin(to, rowCnt) - 1;
+
+   if (last >= from)
+      emit dataChanged(index(from, graphColumn), index(last, graphColumn));
+
+   return to;
+}
+
+void RepositoryModel::finishLanesJob()
+{
+   lanesJobTimer.stop();
+   lanesJob = LanesJob();
+   lanesJobRunning = false;
+
+   if (lanesJobTarget - static_cast<int>(firstFreeLane) > LANES_SLICE_ROWS)
+      computeLanesAhead(lanesJobTarget);
+   else
+      scheduleLanes();
+}
+
+void RepositoryModel::clearLaneCheckpoints(int fromRow)
+{
+   staleCheckpoints.clear();
+   staleLanesEnd = 0;
+   laneCheckpoints.erase(laneCheckpoints.lowerBound(fromRow), laneCheckpoints.end());
+}
+
+void RepositoryModel::on_computeLanes()
+{
+   if (lanesJobRunning)
+      return;
+
+   // lanes are computed ahead of the view in small steps, so that
+   // scrolling or jumping far away rarely has to wait for them
+   const auto from = static_cast<int>(firstFreeLane);
+   QElapsedTimer elapsed;
+   elapsed.start();
+
+   while (static_cast<int>(firstFreeLane) < mRevCache->count() && elapsed.elapsed() < LANES_SLICE_MS)
+      mGit->computeLanes(static_cast<int>(firstFreeLane) + LANES_SLICE_ROWS - 1);
+
+   const auto to = qMin(static_cast<int>(firstFreeLane), rowCnt) - 1;
+   const auto graphColumn = static_cast<int>(RepositoryModelColumns::GRAPH);
+
+   if (to >= from)
+      emit dataChanged(index(from, graphColumn), index(to, graphColumn));
+
+   scheduleLanes();
+}
+
 void RepositoryModel::clear(bool complete)
 {
 
@@ -100,10 +400,13 @@ void RepositoryModel::clear(bool complete)
    beginResetModel();
 
    mRevCache->clear();
+   mSubjectCache.clear();
 
    firstFreeLane = loadTime = earlyOutputCntBase = 0;
    setEarlyOutputState(false);
    lns->clear();
+   clearLaneCheckpoints(0);
+   ++lanesGeneration;
    fNames.clear();
    curFNames.clear();
 
@@ -128,6 +431,8 @@ void RepositoryModel::on_newRevsAdded()
    beginInsertRows(QModelIndex(), rowCnt, revisionsCount - 1);
    rowCnt = revisionsCount;
    endInsertRows();
+
+   scheduleLanes();
 }
 
 void RepositoryModel::on_loadCompleted(const QString &)
@@ -140,6 +445,8 @@ void RepositoryModel::on_loadCompleted(const QString &)
    rowCnt = revisionsCount;
    beginResetModel(); // force a reset to avoid artifacts in file history graph under Windows
    endResetModel();
+
+   scheduleLanes();
 }
 
 void RepositoryModel::on_changeFont(const QFont &f)
@@ -191,14 +498,18 @@ QVariant RepositoryModel::data(const QModelIndex &index, int role) const
    if (!index.isValid() || (role != Qt::DisplayRole && role != Qt::ToolTipRole))
       return no_value; // fast path, 90% of calls ends here!
 
-   const auto r = mRevCache->revLookup(index.row());
+   const auto row = index.row();
+   const auto r = mRevCache->revLookup(row);
    if (!r)
       return no_value;
 
-   const auto sha = r->sha();
+   // loaded from the commit-graph, author and message are read once shown
+   if (r->isPartial())
+      mGit->completeRevision(row);
 
    if (role == Qt::ToolTipRole)
    {
+      const auto sha = r->sha();
       QString auxMessage;
 
       if ((mGit->checkRef(sha) & Git::CUR_BRANCH) && mGit->getCurrentBranchName().isEmpty())
@@ -219,18 +530,42 @@ QVariant RepositoryModel::data(const QModelIndex &index, int role) const
       if (!tags.isEmpty())
          auxMessage.append(QString("<p><b>Tags: </b>%1</p>").arg(tags.join(",")));
 
+      // only known once the reachability of the branches is computed
+      QStringList containing;
+
+      if (mGit->getBranchesContaining(sha, containing) && !containing.isEmpty())
+      {
+         auto names = containing.mid(0, TOOLTIP_MAX_BRANCHES).join(",");
+
+         if (containing.count() > TOOLTIP_MAX_BRANCHES)
+            names.append(QString(" and %1 more").arg(containing.count() - TOOLTIP_MAX_BRANCHES));
+
+         auxMessage.append(QString("<p><b>In branches: </b>%1</p>").arg(names));
+      }
+
+      // the nearest tags on both sides of an untagged commit, once the ancestry is indexed
+      QStringList follows;
+      QStringList precedes;
+
+      if (tags.isEmpty() && mGit->getNearestTags(sha, false, follows) && !follows.isEmpty())
+         auxMessage.append(QString("<p><b>Follows: </b>%1</p>").arg(follows.join(",")));
+
+      if (tags.isEmpty() && mGit->getNearestTags(sha, true, precedes) && !precedes.isEmpty())
+         auxMessage.append(QString("<p><b>Precedes: </b>%1</p>").arg(precedes.join(",")));
+
       QDateTime d;
-      d.setSecsSinceEpoch(r->authorDate().toUInt());
+      d.setSecsSinceEpoch(mRevCache->authorDate(row));
 
       return QString("<p>%1 - %2<p></p>%3</p>%4")
-          .arg(r->author().split("<").first(), d.toString(Qt::SystemLocaleShortDate), sha, auxMessage);
+          .arg(mRevCache->authorName(mRevCache->authorId(row)), d.toString(Qt::SystemLocaleShortDate), sha,
+               auxMessage);
    }
 
    int col = index.column();
 
    // calculate lanes
-   if (r->lanes.count() == 0)
-      mGit->setLane(sha);
+   if (mRevCache->lanesCount(r->orderIdx) == 0)
+      mGit->setLane(r->sha());
 
    switch (static_cast<RepositoryModelColumns>(col))
    {
@@ -238,14 +573,32 @@ QVariant RepositoryModel::data(const QModelIndex &index, int role) const
          return (annIdValid ? rowCnt - index.row() : QVariant());
       case RepositoryModelColumns::SHA:
          return r->sha();
-      case RepositoryModelColumns::LOG:
-         return r->shortLog();
+      case RepositoryModelColumns::LOG: {
+         if (const auto cached = mSubjectCache.object(row))
+            return *cached;
+
+         const auto subject = mRevCache->subject(row);
+         mSubjectCache.insert(row, new QString(subject));
+         return subject;
+      }
       case RepositoryModelColumns::AUTHOR:
-         return r->author().split("<").first();
+         return r->isPartial() ? no_value : mRevCache->authorName(mRevCache->authorId(row));
       case RepositoryModelColumns::DATE: {
+         // the commit-graph only knows the committer date, the author date is shown once read
+         if (r->isPartial())
+            return no_value;
+
+         // shown to the minute, all the commits of a minute share the string
+         const auto minute = mRevCache->authorDate(row) / 60;
+
+         if (const auto cached = mDateCache.object(minute))
+            return *cached;
+
          QDateTime dt;
-         dt.setSecsSinceEpoch(r->authorDate().toUInt());
-         return dt.toString("dd/MM/yyyy hh:mm");
+         dt.setSecsSinceEpoch(minute * 60);
+         const auto date = dt.toString("dd/MM/yyyy hh:mm");
+         mDateCache.insert(minute, new QString(date));
+         return date;
       }
       default:
          return no_value;
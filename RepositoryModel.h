@@ -10,11 +10,15 @@
 */
 
 #include <QAbstractItemModel>
+#include <QCache>
+#include <QMap>
 #include <QSharedPointer>
+#include <QTimer>
+
+#include "lanes.h"
+#include "RevisionsCache.h"
 
-class RevisionsCache;
 class Git;
-class Lanes;
 class Revision;
 enum class RepositoryModelColumns;
 
@@ -45,6 +49,7 @@ public slots:
 private slots:
    void on_newRevsAdded();
    void on_loadCompleted(const QString &);
+   void on_computeLanes();
 
 private:
    QSharedPointer<RevisionsCache> mRevCache;
@@ -52,9 +57,58 @@ private:
    friend class Git;
 
    void flushTail();
+   void insertRevisions(int row, const QVector<Revision> &revisions,
+                        const QVector<RevisionsCache::Columns> &columns);
+   void revisionUpdated(int row);
+   void scheduleLanes();
+   void clearLaneCheckpoints(int fromRow);
+
+   // lanes of rows far below the computed ones, worked out by a thread on a
+   // shared copy of the topology of the cache, so that it never reads the cache.
+   // The lanes of all the rows come back in a single pool, they are copied to
+   // the cache a slice at a time, the rows around the one asked first.
+   struct LanesJob
+   {
+      int from = 0;
+      int end = 0; // one past the last row computed
+      bool converged = false; // the stale lanes below are valid from the end on
+      RevisionsCache::Topology topology;
+      Lanes state;
+      QMap<int, Lanes> staleCheckpoints;
+      int staleLanesEnd = 0;
+      QVector<int> lanesStart; // one more than the rows computed
+      QVector<LaneType> lanes;
+      QMap<int, Lanes> checkpoints;
+   };
+
+   static const int LANES_CHECKPOINT_INTERVAL = 1000; // rows between two saved Lanes states
+
+   static void stepLanes(const RevisionsCache::Topology &topology, int row, Lanes &state, QVector<LaneType> &lanes);
+   void computeLanesAhead(int row);
+   static LanesJob runLanesJob(LanesJob job);
+   void applyLanesJob(const LanesJob &job, int generation);
+   void applyLanesSlice();
+   int copyLanes(int from, int to);
+   void finishLanesJob();
 
    Lanes *lns = nullptr;
    uint firstFreeLane;
+   // Lanes state before the keyed row, saved every LANES_CHECKPOINT_INTERVAL rows
+   QMap<int, Lanes> laneCheckpoints;
+   // after new rows are spliced in, the lanes below them are kept as they are
+   // and reused as soon as the recomputed state matches one of these
+   QMap<int, Lanes> staleCheckpoints;
+   int staleLanesEnd = 0;
+   Lanes staleLanesEndState;
+   QTimer lanesTimer;
+   bool lanesJobRunning = false; // until its lanes are all copied
+   int lanesJobTarget = -1;
+   LanesJob lanesJob; // the one being copied
+   int lanesJobGeneration = 0;
+   int lanesJobRow = 0; // next row copied
+   int lanesJobWindow = 0; // the rows from here on were copied first
+   QTimer lanesJobTimer;
+   int lanesGeneration = 0; // bumped whenever the lanes computed so far are dropped
    QMap<RepositoryModelColumns, QString> mColumns;
    int rowCnt;
    bool annIdValid;
@@ -65,4 +119,8 @@ private:
    QStringList curFNames;
    QStringList renamedRevs;
    QHash<QString, QString> renamedPatches;
+
+   // display strings of the last rows shown, the dates by minute
+   mutable QCache<int, QString> mSubjectCache;
+   mutable QCache<qint64, QString> mDateCache;
 };
@@ -27,6 +27,7 @@ Author: Marco Costalba (C) 2005-2007
 #include <QMouseEvent>
 #include <QPainter>
 #include <QPixmap>
+#include <QScrollBar>
 #include <QSettings>
 #include <QShortcut>
 #include <QUrl>
@@ -36,6 +37,12 @@ using namespace QLogger;
 
 uint refTypeFromName(const QString &name);
 
+namespace
+{
+// the files of the commits around the viewport are computed once scrolling settles
+const int PREFETCH_DELAY_MS = 50;
+}
+
 RepositoryView::RepositoryView(QSharedPointer<RevisionsCache> revCache, QSharedPointer<Git> git, QWidget *parent)
    : QTreeView(parent)
    , mRevCache(revCache)
@@ -64,6 +71,12 @@ RepositoryView::RepositoryView(QSharedPointer<RevisionsCache> revCache, QSharedP
       update();
    });
    connect(mGit.get(), &Git::loadCompleted, this, [this]() { d->update(false); });
+
+   mPrefetchTimer.setSingleShot(true);
+   mPrefetchTimer.setInterval(PREFETCH_DELAY_MS);
+   connect(&mPrefetchTimer, &QTimer::timeout, this, &RepositoryView::prefetchFiles);
+   connect(verticalScrollBar(), &QScrollBar::valueChanged, &mPrefetchTimer, qOverload<>(&QTimer::start));
+   connect(mGit.get(), &Git::newRevsAdded, &mPrefetchTimer, qOverload<>(&QTimer::start));
 }
 
 void RepositoryView::setup()
@@ -134,7 +147,10 @@ int RepositoryView::getLaneType(const QString &sha, int pos) const
 {
 
    const auto r = mRevCache->revLookup(sha);
-   return (r && pos < r->lanes.count() && pos >= 0 ? static_cast<int>(r->lanes.at(pos)) : -1);
+   if (!r || pos < 0 || pos >= mRevCache->lanesCount(r->orderIdx))
+      return -1;
+
+   return static_cast<int>(mRevCache->lane(r->orderIdx, pos));
 }
 
 void RepositoryView::getSelectedItems(QStringList &selectedItems)
@@ -210,6 +226,37 @@ void RepositoryView::currentChanged(const QModelIndex &index, const QModelIndex
 
       emit clicked(index);
    }
+
+   mPrefetchTimer.start();
+}
+
+void RepositoryView::prefetchFiles()
+{
+   const auto rowCount = mRepositoryModel->rowCount();
+
+   if (rowCount == 0)
+      return;
+
+   auto top = indexAt(QPoint(0, 0)).row();
+   auto bottom = indexAt(QPoint(0, viewport()->height() - 1)).row();
+
+   if (top == -1)
+      top = 0;
+
+   if (bottom == -1)
+      bottom = rowCount - 1;
+
+   // the viewport goes first, then a page below and a page above it
+   const auto page = bottom - top + 1;
+   QStringList shas;
+
+   for (auto row = top; row <= qMin(bottom + page, rowCount - 1); ++row)
+      shas.append(mRevCache->sha(row));
+
+   for (auto row = top - 1; row >= qMax(top - page, 0); --row)
+      shas.append(mRevCache->sha(row));
+
+   mGit->prefetchFiles(shas);
 }
 
 void RepositoryView::markDiffToSha(const QString &sha)
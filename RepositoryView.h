@@ -8,6 +8,7 @@ Copyright: See COPYING file that comes with this distribution
 
 #include <QItemDelegate>
 #include <QRegExp>
+#include <QTimer>
 #include <QTreeView>
 
 class Git;
@@ -62,6 +63,7 @@ private:
 
    void showContextMenu(const QPoint &);
    void setupGeometry();
+   void prefetchFiles();
    bool filterRightButtonPressed(QMouseEvent *e);
    bool getLaneParentsChildren(const QString &sha, int x, QStringList &p, QStringList &c);
    int getLaneType(const QString &sha, int pos) const;
@@ -71,4 +73,5 @@ private:
    StateInfo *st = nullptr;
    unsigned long secs;
    bool filterNextContextMenuRequest;
+   QTimer mPrefetchTimer;
 };
@@ -10,91 +10,27 @@
 
 static const int COLORS_NUM = 8;
 static const int MIN_VIEW_WIDTH_PX = 480;
-
-namespace
-{
-/** Iterator over all refnames of a given sha.
- *  References are traversed in following order:
- *  detached (name empty), local branches, remote branches, tags, other refs
- */
-class RefNameIterator
-{
-   const QString sha;
-   QSharedPointer<Git> mGit;
-   uint ref_types; // all reference types associated with sha
-   int cur_state; // state indicating the currently processed ref type
-   QStringList ref_names; // ref_names of current type
-   QStringList::const_iterator cur_name;
-   QString cur_branch;
-
-public:
-   RefNameIterator(QSharedPointer<Git> git, const QString &sha);
-   bool valid() const { return cur_state != -1; }
-   QString name() const { return *cur_name; }
-   int type() { return cur_state; }
-   bool isCurrentBranch() { return *cur_name == cur_branch; }
-
-   void next();
-};
-
-RefNameIterator::RefNameIterator(QSharedPointer<Git> git, const QString &sha)
-   : sha(sha)
-   , mGit(git)
-   , cur_state(0)
-   , cur_branch(mGit->getCurrentBranchName())
-{
-   ref_types = mGit->checkRef(sha);
-   if (ref_types == 0)
-   {
-      cur_state = -1; // indicates end
-      return;
-   }
-
-   // initialize dummy string list
-   ref_names << "";
-   cur_name = ref_names.begin();
-
-   // detached ?
-   if ((ref_types & Git::CUR_BRANCH) && cur_branch.isEmpty())
-   {
-      // indicate detached state with type() == 0 and empty ref name
-      cur_branch = *cur_name;
-   }
-   else
-   { // advance to first real ref name
-      next();
-   }
-}
-
-void RefNameIterator::next()
+static const int MAX_BADGE_TEXT_PX = 250;
+static const int BADGE_TEXT_PADDING = 10;
+static const int BADGE_SPACING = 5; // Space between markers in pixels
+static const int GLYPH_MARGIN = LANE_WIDTH / 2 + 4; // arcs and pens reach into the neighbour lanes
+static const int GLYPH_WIDTH = LANE_WIDTH + 2 * GLYPH_MARGIN;
+static const int ATLAS_COLUMNS = 32;
+static const int ATLAS_GROW_ROWS = 8;
+static const int ROW_PIXMAPS_CACHED = 1024;
+
+static const QColor &laneColor(int index)
 {
-   ++cur_name;
-
-   // switch to next ref type if required
-   while (valid() && cur_name == ref_names.end())
-   {
-      switch (cur_state)
-      {
-         case 0:
-            cur_state = Git::BRANCH;
-            break;
-         case Git::BRANCH:
-            cur_state = Git::RMT_BRANCH;
-            break;
-         case Git::RMT_BRANCH:
-            cur_state = Git::TAG;
-            break;
-         case Git::TAG:
-            cur_state = Git::REF;
-            break;
-         default:
-            cur_state = -1; // indicate end
-      }
-      ref_names = mGit->getRefNames(sha, (Git::RefType)cur_state);
-      cur_name = ref_names.begin();
-   }
-}
+   static const QColor colors[COLORS_NUM] = { QPalette().color(QPalette::WindowText),
+                                              QColor("#FF5555") /* red */,
+                                              QColor("#579BD5") /* blue */,
+                                              QColor("#8dc944") /* green */,
+                                              QColor("#FFB86C") /* orange */,
+                                              QColor("#848484") /* grey */,
+                                              QColor("#FF79C6") /* pink */,
+                                              QColor("#CD9077") /* pastel */ };
 
+   return colors[index % COLORS_NUM];
 }
 
 RepositoryViewDelegate::RepositoryViewDelegate(QSharedPointer<Git> git, QSharedPointer<RevisionsCache> revCache)
@@ -102,6 +38,7 @@ RepositoryViewDelegate::RepositoryViewDelegate(QSharedPointer<Git> git, QSharedP
    , mGit(git)
    , mRevCache(revCache)
 {
+   mRowPixmaps.setMaxCost(ROW_PIXMAPS_CACHED);
 }
 
 void RepositoryViewDelegate::diffTargetChanged(int row)
@@ -340,15 +277,6 @@ void RepositoryViewDelegate::paint(QPainter *p, const QStyleOptionViewItem &opt,
 
 void RepositoryViewDelegate::paintGraph(QPainter *p, const QStyleOptionViewItem &opt, const QModelIndex &i) const
 {
-   static const QColor &baseColor = QPalette().color(QPalette::WindowText);
-   static const QColor colors[COLORS_NUM] = { baseColor,
-                                              QColor("#FF5555") /* red */,
-                                              QColor("#579BD5") /* blue */,
-                                              QColor("#8dc944") /* green */,
-                                              QColor("#FFB86C") /* orange */,
-                                              QColor("#848484") /* grey */,
-                                              QColor("#FF79C6") /* pink */,
-                                              QColor("#CD9077") /* pastel */ };
    const auto r = mRevCache->revLookup(i.row());
 
    if (!r)
@@ -365,39 +293,132 @@ void RepositoryViewDelegate::paintGraph(QPainter *p, const QStyleOptionViewItem
    p->translate(opt.rect.topLeft());
 
    // calculate lanes
-   if (r->lanes.count() == 0)
+   if (mRevCache->lanesCount(r->orderIdx) == 0)
       mGit->setLane(r->sha());
 
-   QBrush back = opt.palette.base();
-   const QVector<LaneType> &lanes(r->lanes);
-   auto laneNum = lanes.count();
+   const auto row = r->orderIdx;
+   auto laneNum = mRevCache->lanesCount(row);
    auto activeLane = 0;
    for (int i = 0; i < laneNum; i++)
-      if (isActive(lanes[i]))
+      if (isActive(mRevCache->lane(row, i)))
       {
          activeLane = i;
          break;
       }
 
-   int x1 = 0, x2 = 0;
-   int maxWidth = opt.rect.width();
-   QColor activeColor = colors[activeLane % COLORS_NUM];
-   if (opt.state & QStyle::State_Selected)
-      activeColor = blend(activeColor, opt.palette.highlightedText().color(), 208);
-   for (auto i = 0; i < laneNum && x2 < maxWidth; i++)
+   // glyphs are rendered at the resolution of the screen
+   const auto dpr = p->device()->devicePixelRatioF();
+
+   if (!qFuzzyCompare(dpr, mGraphDpr))
+   {
+      mGraphDpr = dpr;
+      mGlyphAtlas = QPixmap();
+      mGlyphCells.clear();
+      mRowPixmaps.clear();
+   }
+
+   // lanes past the width of the column are not drawn
+   const auto lanesShown = qMin(laneNum, qMax(0, (opt.rect.width() + LANE_WIDTH - 1) / LANE_WIDTH));
+   const auto selected = (opt.state & QStyle::State_Selected) != 0;
+
+   // rows with the same lanes share the same pixmap
+   QVector<LaneType> lanes(lanesShown);
+   QByteArray key(reinterpret_cast<const char *>(&activeLane), sizeof(activeLane));
+   key.append(selected ? '\1' : '\0');
+
+   for (auto i = 0; i < lanesShown; i++)
+   {
+      lanes[i] = mRevCache->lane(row, i);
+      key.append(static_cast<char>(lanes.at(i)));
+   }
+
+   if (const auto cached = mRowPixmaps.object(key))
+      p->drawPixmap(-GLYPH_MARGIN, 0, *cached);
+   else
+   {
+      const auto pixmap = renderLanes(lanes, activeLane, selected, opt);
+      p->drawPixmap(-GLYPH_MARGIN, 0, pixmap);
+      mRowPixmaps.insert(key, new QPixmap(pixmap));
+   }
+
+   p->restore();
+}
+
+QPixmap RepositoryViewDelegate::renderLanes(const QVector<LaneType> &lanes, int activeLane, bool selected,
+                                            const QStyleOptionViewItem &opt) const
+{
+   QPixmap pixmap(QSize(lanes.count() * LANE_WIDTH + 2 * GLYPH_MARGIN, ROW_HEIGHT) * mGraphDpr);
+   pixmap.setDevicePixelRatio(mGraphDpr);
+   pixmap.fill(Qt::transparent);
+
+   QPainter painter(&pixmap);
+
+   for (auto i = 0; i < lanes.count(); i++)
    {
+      if (lanes.at(i) == LaneType::EMPTY)
+         continue;
+
+      const auto cell = laneGlyph(lanes.at(i), i, activeLane, selected, opt);
+      const QRectF source(cell.x() * mGraphDpr, cell.y() * mGraphDpr, cell.width() * mGraphDpr,
+                          cell.height() * mGraphDpr);
+
+      painter.drawPixmap(QRectF(i * LANE_WIDTH, 0, GLYPH_WIDTH, ROW_HEIGHT), mGlyphAtlas, source);
+   }
+
+   painter.end();
+
+   return pixmap;
+}
 
-      x1 = x2;
-      x2 += LANE_WIDTH;
+QRect RepositoryViewDelegate::laneGlyph(LaneType type, int lane, int activeLane, bool selected,
+                                        const QStyleOptionViewItem &opt) const
+{
+   // the colour of a lane and of the active one are all a glyph depends on
+   const auto isActiveLane = lane == activeLane;
+   const auto key = static_cast<quint32>(type) | static_cast<quint32>(lane % COLORS_NUM) << 8
+       | static_cast<quint32>(activeLane % COLORS_NUM) << 12 | static_cast<quint32>(isActiveLane) << 16
+       | static_cast<quint32>(selected) << 17;
+
+   const auto it = mGlyphCells.constFind(key);
+
+   if (it != mGlyphCells.constEnd())
+      return it.value();
+
+   const auto index = mGlyphCells.count();
+   const QRect cell((index % ATLAS_COLUMNS) * GLYPH_WIDTH, (index / ATLAS_COLUMNS) * ROW_HEIGHT, GLYPH_WIDTH,
+                    ROW_HEIGHT);
 
-      auto ln = lanes[i];
-      if (ln != LaneType::EMPTY)
+   if (mGlyphAtlas.isNull() || (cell.y() + ROW_HEIGHT) * mGraphDpr > mGlyphAtlas.height())
+   {
+      const auto rows = index / ATLAS_COLUMNS + ATLAS_GROW_ROWS;
+      QPixmap atlas(QSize(ATLAS_COLUMNS * GLYPH_WIDTH, rows * ROW_HEIGHT) * mGraphDpr);
+      atlas.setDevicePixelRatio(mGraphDpr);
+      atlas.fill(Qt::transparent);
+
+      if (!mGlyphAtlas.isNull())
       {
-         QColor color = i == activeLane ? activeColor : colors[i % COLORS_NUM];
-         paintGraphLane(p, ln, x1, x2, color, activeColor, back);
+         QPainter painter(&atlas);
+         painter.setCompositionMode(QPainter::CompositionMode_Source);
+         painter.drawPixmap(0, 0, mGlyphAtlas);
       }
+
+      mGlyphAtlas = atlas;
    }
-   p->restore();
+
+   auto activeColor = laneColor(activeLane);
+   if (selected)
+      activeColor = blend(activeColor, opt.palette.highlightedText().color(), 208);
+
+   QPainter painter(&mGlyphAtlas);
+   painter.setRenderHints(QPainter::Antialiasing);
+   painter.setClipRect(cell);
+   painter.translate(cell.x() + GLYPH_MARGIN, cell.y());
+   paintGraphLane(&painter, type, 0, LANE_WIDTH, isActiveLane ? activeColor : laneColor(lane), activeColor,
+                  opt.palette.base());
+
+   mGlyphCells.insert(key, cell);
+
+   return cell;
 }
 
 void RepositoryViewDelegate::paintWip(QPainter *painter, QStyleOptionViewItem opt) const
@@ -430,9 +451,7 @@ void RepositoryViewDelegate::paintLog(QPainter *p, const QStyleOptionViewItem &o
       return;
 
    auto offset = 0;
-
-   if (mGit->checkRef(r->sha()) > 0)
-      paintTagBranch(p, opt, offset, r->sha());
+   paintTagBranch(p, opt, offset, row);
 
    auto newOpt = opt;
    newOpt.rect.setX(opt.rect.x() + offset + 5);
@@ -445,56 +464,131 @@ void RepositoryViewDelegate::paintLog(QPainter *p, const QStyleOptionViewItem &o
                QTextOption(Qt::AlignLeft | Qt::AlignVCenter));
 }
 
-void RepositoryViewDelegate::paintTagBranch(QPainter *painter, QStyleOptionViewItem o, int &startPoint,
-                                            const QString &sha) const
+void RepositoryViewDelegate::paintTagBranch(QPainter *painter, QStyleOptionViewItem o, int &startPoint, int row) const
+{
+   updateRefBadges(o);
+
+   const auto it = mRowBadges.constFind(row);
+
+   if (it == mRowBadges.constEnd())
+      return;
+
+   for (const auto &badge : it.value())
+   {
+      painter->save();
+      painter->fillRect(o.rect.x() + startPoint, o.rect.y(), badge.width, ROW_HEIGHT, badge.color);
+      painter->setPen(badge.textColor);
+
+      const auto y = o.rect.y() + ROW_HEIGHT - (ROW_HEIGHT - badge.textHeight) + 2;
+      o.font.setBold(badge.bold);
+      painter->setFont(o.font);
+      painter->drawText(o.rect.x() + startPoint + BADGE_TEXT_PADDING, y, badge.text);
+      painter->restore();
+
+      startPoint += badge.width + BADGE_SPACING;
+   }
+}
+
+void RepositoryViewDelegate::updateRefBadges(const QStyleOptionViewItem &opt) const
 {
-   const auto showMinimal = o.rect.width() <= MIN_VIEW_WIDTH_PX;
-   const int mark_spacing = 5; // Space between markers in pixels
+   const auto showMinimal = opt.rect.width() <= MIN_VIEW_WIDTH_PX;
+   const auto generation = mGit->refsGeneration();
 
-   for (RefNameIterator it(mGit, sha); it.valid(); it.next())
+   // the badges are measured again only when the refs or the font change
+   if (generation != mBadgesGeneration || opt.font != mBadgesFont || showMinimal != mBadgesMinimal)
    {
-      auto name = it.name();
+      mShaBadges.clear();
+
+      const auto currentBranch = mGit->getCurrentBranchName();
+      const auto shas = mGit->getRefShas();
+
+      for (const auto &sha : shas)
+      {
+         const auto badges = layoutRefBadges(sha, currentBranch, opt.font, showMinimal);
 
-      QColor clr;
+         if (!badges.isEmpty())
+            mShaBadges.insert(sha, badges);
+      }
+
+      mBadgesGeneration = generation;
+      mBadgesFont = opt.font;
+      mBadgesMinimal = showMinimal;
+      mBadgesRows = -1;
+   }
+
+   // rows move when a refresh adds commits on top
+   if (mBadgesRows != mRevCache->count())
+   {
+      mRowBadges.clear();
 
-      switch (it.type())
+      for (auto it = mShaBadges.constBegin(); it != mShaBadges.constEnd(); ++it)
+      {
+         const auto row = mRevCache->row(it.key());
+
+         if (row != -1)
+            mRowBadges.insert(row, it.value());
+      }
+
+      mBadgesRows = mRevCache->count();
+   }
+}
+
+QVector<RepositoryViewDelegate::RefBadge> RepositoryViewDelegate::layoutRefBadges(const QString &sha,
+                                                                                  const QString &currentBranch,
+                                                                                  QFont font, bool showMinimal) const
+{
+   // detached (name empty), local branches, remote branches, tags, other refs
+   QVector<QPair<QString, int>> refs;
+   const auto types = mGit->checkRef(sha);
+
+   if ((types & Git::CUR_BRANCH) && currentBranch.isEmpty())
+      refs.append(qMakePair(QString(), 0));
+
+   for (auto type : { Git::BRANCH, Git::RMT_BRANCH, Git::TAG, Git::REF })
+      for (const auto &name : mGit->getRefNames(sha, type))
+         refs.append(qMakePair(name, static_cast<int>(type)));
+
+   QVector<RefBadge> badges;
+   badges.reserve(refs.count());
+
+   for (const auto &ref : qAsConst(refs))
+   {
+      RefBadge badge;
+      badge.bold = ref.first == currentBranch;
+
+      switch (ref.second)
       {
          case 0:
-            name = "detached";
-            clr = QColor("#851e3e");
+            badge.color = QColor("#851e3e");
             break;
          case Git::BRANCH:
-            clr = it.isCurrentBranch() ? QColor("#005b96") : QColor("#6497b1");
+            badge.color = badge.bold ? QColor("#005b96") : QColor("#6497b1");
             break;
          case Git::RMT_BRANCH:
-            clr = QColor("#011f4b");
+            badge.color = QColor("#011f4b");
             break;
          case Git::TAG:
-            clr = QColor("#dec3c3");
+            badge.color = QColor("#dec3c3");
             break;
          case Git::REF:
-            clr = QColor("#FF5555");
+            badge.color = QColor("#FF5555");
             break;
       }
 
-      o.font.setBold(it.isCurrentBranch());
+      badge.textColor = QColor(ref.second == Git::TAG ? QString("#000000") : QString("#FFFFFF"));
 
-      const auto nameToDisplay = showMinimal ? QString(". . .") : name;
-      QFontMetrics fm(o.font);
-      const auto textBoundingRect = fm.boundingRect(nameToDisplay);
-      const int textPadding = 10;
-      const auto rectWidth = textBoundingRect.width() + 2 * textPadding;
+      font.setBold(badge.bold);
+      QFontMetrics fm(font);
 
-      painter->save();
-      painter->fillRect(o.rect.x() + startPoint, o.rect.y(), rectWidth, ROW_HEIGHT, clr);
-      painter->setPen(QColor(it.type() == Git::TAG ? QString("#000000") : QString("#FFFFFF")));
+      const auto name = ref.second == 0 ? QString("detached") : ref.first;
+      badge.text = showMinimal ? QString(". . .") : fm.elidedText(name, Qt::ElideRight, MAX_BADGE_TEXT_PX);
 
-      const auto fontRect = textBoundingRect.height();
-      const auto y = o.rect.y() + ROW_HEIGHT - (ROW_HEIGHT - fontRect) + 2;
-      painter->setFont(o.font);
-      painter->drawText(o.rect.x() + startPoint + textPadding, y, nameToDisplay);
-      painter->restore();
+      const auto textBoundingRect = fm.boundingRect(badge.text);
+      badge.width = textBoundingRect.width() + 2 * BADGE_TEXT_PADDING;
+      badge.textHeight = textBoundingRect.height();
 
-      startPoint += rectWidth + mark_spacing;
+      badges.append(badge);
    }
+
+   return badges;
 }
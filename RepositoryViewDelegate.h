@@ -23,7 +23,14 @@
  ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
  ***************************************************************************************/
 
+#include <QCache>
+#include <QColor>
+#include <QFont>
+#include <QHash>
+#include <QPixmap>
+#include <QRect>
 #include <QStyledItemDelegate>
+#include <QVector>
 
 class RevisionsCache;
 class Git;
@@ -31,7 +38,7 @@ class Git;
 const int ROW_HEIGHT = 25;
 const int LANE_WIDTH = 3 * ROW_HEIGHT / 4;
 
-enum class LaneType;
+enum class LaneType : quint8;
 
 class RepositoryViewDelegate : public QStyledItemDelegate
 {
@@ -58,9 +65,40 @@ private:
    void paintGraph(QPainter *p, const QStyleOptionViewItem &o, const QModelIndex &i) const;
    void paintGraphLane(QPainter *p, const LaneType type, int x1, int x2, const QColor &col, const QColor &activeCol,
                        const QBrush &back) const;
+   QPixmap renderLanes(const QVector<LaneType> &lanes, int activeLane, bool selected,
+                       const QStyleOptionViewItem &opt) const;
+   QRect laneGlyph(LaneType type, int lane, int activeLane, bool selected, const QStyleOptionViewItem &opt) const;
    void paintWip(QPainter *painter, QStyleOptionViewItem opt) const;
-   void paintTagBranch(QPainter *painter, QStyleOptionViewItem opt, int &startPoint, const QString &sha) const;
+   void paintTagBranch(QPainter *painter, QStyleOptionViewItem opt, int &startPoint, int row) const;
+
+   // a ref decoration of a row, laid out once per refs reload
+   struct RefBadge
+   {
+      QString text;
+      QColor color;
+      QColor textColor;
+      bool bold = false;
+      int width = 0;
+      int textHeight = 0;
+   };
+
+   void updateRefBadges(const QStyleOptionViewItem &opt) const;
+   QVector<RefBadge> layoutRefBadges(const QString &sha, const QString &currentBranch, QFont font,
+                                     bool showMinimal) const;
 
    QSharedPointer<RevisionsCache> mRevCache;
    int diffTargetRow = -1;
+
+   mutable QHash<QString, QVector<RefBadge>> mShaBadges;
+   mutable QHash<int, QVector<RefBadge>> mRowBadges;
+   mutable int mBadgesGeneration = -1;
+   mutable int mBadgesRows = -1;
+   mutable QFont mBadgesFont;
+   mutable bool mBadgesMinimal = false;
+
+   // every lane glyph drawn once into an atlas, whole rows are composed from it
+   mutable qreal mGraphDpr = 0;
+   mutable QPixmap mGlyphAtlas;
+   mutable QHash<quint32, QRect> mGlyphCells;
+   mutable QCache<QByteArray, QPixmap> mRowPixmaps;
 };
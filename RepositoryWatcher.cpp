@@ -0,0 +1,293 @@
+#include "RepositoryWatcher.h"
+
+#include <GitCommandPool.h>
+#include <git.h>
+
+#include <QDir>
+#include <QDirIterator>
+#include <QFileInfo>
+#include <QFileSystemWatcher>
+#include <QProcess>
+#include <QtConcurrent/QtConcurrentRun>
+
+#include <QLogger.h>
+
+#include <algorithm>
+
+using namespace QLogger;
+
+namespace
+{
+const int kTimeout = 60000;
+
+// the tracked and untracked files that are not ignored, with their names as git stores them
+QStringList listFiles(const QString &workingDir)
+{
+   QProcess process;
+   process.setWorkingDirectory(workingDir);
+   process.start("git", { "ls-files", "-z", "--cached", "--others", "--exclude-standard" });
+
+   if (!process.waitForFinished(kTimeout) || process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0)
+   {
+      process.kill();
+      return QStringList();
+   }
+
+   // with -z names are neither quoted nor escaped, every one ends with a '\0'
+   QStringList files;
+   const auto output = process.readAllStandardOutput();
+
+   for (const auto &file : output.split('\0'))
+      if (!file.isEmpty())
+         files.append(QString::fromUtf8(file));
+
+   return files;
+}
+}
+
+RepositoryWatcher::RepositoryWatcher(QSharedPointer<Git> git, QObject *parent)
+   : QObject(parent)
+   , mGit(git)
+   , mWatcher(new QFileSystemWatcher(this))
+{
+   mDebounceTimer.setSingleShot(true);
+   mDebounceTimer.setInterval(kDebounceMs);
+   connect(&mDebounceTimer, &QTimer::timeout, this, &RepositoryWatcher::flushChanges);
+
+   mPollTimer.setInterval(kPollMs);
+   connect(&mPollTimer, &QTimer::timeout, this, &RepositoryWatcher::workingTreeChanged);
+
+   connect(mWatcher, &QFileSystemWatcher::directoryChanged, this, &RepositoryWatcher::onDirectoryChanged);
+}
+
+void RepositoryWatcher::watch(const QString &workingDir, const QString &gitDir)
+{
+   clear();
+
+   QLog_Info("UI", QString("Setting the file watcher for dir {%1}").arg(workingDir));
+
+   mWorkingDir = workingDir;
+   mGitDir = gitDir;
+
+   // git replaces HEAD, index and packed-refs through a lock file
+   // and a rename, so their directory is watched instead of them
+   mWatcher->addPath(mGitDir);
+
+   bool refsChanged = false;
+   bool indexChanged = false;
+   compareGitFiles(refsChanged, indexChanged);
+
+   watchRefs();
+   scanWorkingTree();
+}
+
+void RepositoryWatcher::clear()
+{
+   ++mGeneration;
+   mDebounceTimer.stop();
+   mPollTimer.stop();
+
+   const auto paths = mWatcher->directories() + mWatcher->files();
+
+   if (!paths.isEmpty())
+      mWatcher->removePaths(paths);
+
+   mTreeDirs.clear();
+   mSeenDirs.clear();
+   mChangedTreeDirs.clear();
+   mGitFiles.clear();
+   mGitDirChanged = false;
+   mRefsChanged = false;
+}
+
+void RepositoryWatcher::onDirectoryChanged(const QString &path)
+{
+   if (path == mGitDir)
+      mGitDirChanged = true;
+   else if (path.startsWith(mGitDir + "/refs"))
+      mRefsChanged = true;
+   else
+      mChangedTreeDirs.insert(path);
+
+   // the window opens with the first event, so a steady
+   // stream of them still ends in regular refreshes
+   if (!mDebounceTimer.isActive())
+      mDebounceTimer.start();
+}
+
+void RepositoryWatcher::flushChanges()
+{
+   auto refsChanged = mRefsChanged;
+   auto treeChanged = !mChangedTreeDirs.isEmpty();
+
+   if (mGitDirChanged)
+      compareGitFiles(refsChanged, treeChanged);
+
+   // new remotes or ref namespaces
+   if (mRefsChanged)
+      watchRefs();
+
+   // directories created since the last scan are watched unless git ignores them
+   auto newDirs = false;
+
+   for (const auto &dir : qAsConst(mChangedTreeDirs))
+   {
+      const QDir changedDir(dir);
+
+      if (!changedDir.exists())
+      {
+         mTreeDirs.remove(dir);
+         mSeenDirs.remove(dir);
+         continue;
+      }
+
+      const auto entries = changedDir.entryList(QDir::Dirs | QDir::NoDotAndDotDot | QDir::Hidden);
+
+      for (const auto &entry : entries)
+      {
+         const auto path = changedDir.filePath(entry);
+
+         if (path != mGitDir && !mSeenDirs.contains(path))
+         {
+            mSeenDirs.insert(path);
+            newDirs = true;
+         }
+      }
+   }
+
+   mChangedTreeDirs.clear();
+   mGitDirChanged = false;
+   mRefsChanged = false;
+
+   if (newDirs)
+      scanWorkingTree();
+
+   // a refs refresh updates the working dir revision too
+   if (refsChanged)
+      emit this->refsChanged();
+   else if (treeChanged)
+      emit workingTreeChanged();
+}
+
+void RepositoryWatcher::scanWorkingTree()
+{
+   const auto generation = mGeneration;
+
+   GitCommandPool::then(QtConcurrent::run(&listFiles, mWorkingDir), this,
+                        [this, generation](const QStringList &files) {
+                           if (generation == mGeneration)
+                              setTreeDirs(files);
+                        });
+}
+
+void RepositoryWatcher::setTreeDirs(const QStringList &files)
+{
+   QSet<QString> dirs;
+   dirs.insert(mWorkingDir);
+
+   for (const auto &file : files)
+   {
+      // once a directory is known all its parents are known too
+      auto slash = file.lastIndexOf('/');
+
+      while (slash > 0)
+      {
+         const auto dir = QString("%1/%2").arg(mWorkingDir, file.left(slash));
+
+         if (dirs.contains(dir))
+            break;
+
+         dirs.insert(dir);
+         slash = file.lastIndexOf('/', slash - 1);
+      }
+   }
+
+   // the directories left out are covered by polling the status instead
+   if (dirs.count() <= kMaxWatchedDirs)
+      mPollTimer.stop();
+   else
+   {
+      QLog_Warning("UI",
+                   QString("Too many directories to watch (%1), only the top %2 are watched, "
+                           "the working tree status is polled every %3 ms")
+                       .arg(dirs.count())
+                       .arg(kMaxWatchedDirs)
+                       .arg(kPollMs));
+
+      if (!mPollTimer.isActive())
+         mPollTimer.start();
+
+      auto sorted = dirs.toList();
+      std::sort(sorted.begin(), sorted.end(), [](const QString &left, const QString &right) {
+         return left.count('/') < right.count('/');
+      });
+
+      dirs = sorted.mid(0, kMaxWatchedDirs).toSet();
+   }
+
+   const auto removed = mTreeDirs - dirs;
+   const auto added = dirs - mTreeDirs;
+
+   if (!removed.isEmpty())
+      mWatcher->removePaths(removed.toList());
+
+   if (!added.isEmpty())
+      mWatcher->addPaths(added.toList());
+
+   mTreeDirs = dirs;
+   mSeenDirs += dirs;
+
+   QLog_Debug("UI", QString("Watching %1 directories of the working tree").arg(mTreeDirs.count()));
+}
+
+void RepositoryWatcher::watchRefs()
+{
+   const auto refsDir = QString("%1/refs").arg(mGitDir);
+
+   if (!QFileInfo(refsDir).isDir())
+      return;
+
+   QStringList dirs(refsDir);
+   QDirIterator it(refsDir, QDir::Dirs | QDir::NoDotAndDotDot, QDirIterator::Subdirectories);
+
+   while (it.hasNext())
+      dirs.append(it.next());
+
+   const auto watched = mWatcher->directories();
+   QStringList added;
+
+   for (const auto &dir : qAsConst(dirs))
+      if (!watched.contains(dir))
+         added.append(dir);
+
+   if (!added.isEmpty())
+      mWatcher->addPaths(added);
+}
+
+void RepositoryWatcher::compareGitFiles(bool &refsChanged, bool &indexChanged)
+{
+   // lock files and other git internals come and go, only the result counts
+   static const QStringList files { "HEAD", "packed-refs", "index" };
+
+   for (const auto &name : files)
+   {
+      const QFileInfo info(QString("%1/%2").arg(mGitDir, name));
+
+      FileStamp current;
+      if (info.exists())
+      {
+         current.modified = info.lastModified();
+         current.size = info.size();
+      }
+
+      if (!(mGitFiles.value(name) == current))
+      {
+         mGitFiles.insert(name, current);
+
+         if (name == "index")
+            indexChanged = true;
+         else
+            refsChanged = true;
+      }
+   }
+}
@@ -0,0 +1,95 @@
+#pragma once
+
+/****************************************************************************************
+ ** GitQlient is an application to manage and operate one or several Git repositories. With
+ ** GitQlient you will be able to add commits, branches and manage all the options Git provides.
+ ** Copyright (C) 2019  Francesc Martinez
+ **
+ ** LinkedIn: www.linkedin.com/in/cescmm/
+ ** Web: www.francescmm.com
+ **
+ ** This program is free software; you can redistribute it and/or
+ ** modify it under the terms of the GNU Lesser General Public
+ ** License as published by the Free Software Foundation; either
+ ** version 2 of the License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ ** Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public
+ ** License along with this library; if not, write to the Free Software
+ ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***************************************************************************************/
+
+
+#include <QDateTime>
+#include <QHash>
+#include <QObject>
+#include <QSet>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QTimer>
+
+class Git;
+class QFileSystemWatcher;
+
+/* Watches a repository and tells what kind of refresh it needs. The git
+ * directory and its refs are watched apart from the working tree: a change
+ * of HEAD, packed-refs or any ref ends in refsChanged(), a change of the
+ * index or of the working tree in workingTreeChanged(). Only directories
+ * are watched, the ones holding tracked or untracked files that are not
+ * ignored, as 'git ls-files' lists them. Events are coalesced over a short
+ * window so a checkout touching thousands of files refreshes once. When the
+ * tree has more directories than can be watched, workingTreeChanged() is
+ * also emitted every few seconds so the deepest ones are not missed.
+ */
+class RepositoryWatcher : public QObject
+{
+   Q_OBJECT
+
+signals:
+   void refsChanged();
+   void workingTreeChanged();
+
+public:
+   explicit RepositoryWatcher(QSharedPointer<Git> git, QObject *parent = nullptr);
+
+   void watch(const QString &workingDir, const QString &gitDir);
+   void clear();
+
+private:
+   static const int kDebounceMs = 300;
+   static const int kMaxWatchedDirs = 8192; // keep clear of the inotify limit
+   static const int kPollMs = 5000; // status refresh of the directories left unwatched
+
+   struct FileStamp
+   {
+      QDateTime modified;
+      qint64 size = -1;
+
+      bool operator==(const FileStamp &other) const { return modified == other.modified && size == other.size; }
+   };
+
+   QSharedPointer<Git> mGit;
+   QFileSystemWatcher *mWatcher = nullptr;
+   QTimer mDebounceTimer;
+   QTimer mPollTimer;
+   QString mWorkingDir;
+   QString mGitDir;
+   QSet<QString> mTreeDirs;
+   QSet<QString> mSeenDirs;
+   QSet<QString> mChangedTreeDirs;
+   QHash<QString, FileStamp> mGitFiles;
+   bool mGitDirChanged = false;
+   bool mRefsChanged = false;
+   int mGeneration = 0;
+
+   void onDirectoryChanged(const QString &path);
+   void flushChanges();
+   void scanWorkingTree();
+   void setTreeDirs(const QStringList &files);
+   void watchRefs();
+   void compareGitFiles(bool &refsChanged, bool &indexChanged);
+};
@@ -9,15 +9,32 @@ Revision::Revision(const QByteArray &b, uint s, int idx, int *next)
 {
 
    indexed = isDiffCache = isApplied = isUnApplied = false;
-   descRefsMaster = ancRefsMaster = descBrnMaster = -1;
    *next = indexData(true, false);
 }
 
+Revision::Revision(const QByteArray &b, const RecordScanner::Record &record, int idx, int *next)
+   : orderIdx(idx)
+   , ba(const_cast<QByteArray &>(b))
+   , start(record.start)
+{
+   indexed = isDiffCache = isApplied = isUnApplied = false;
+
+   // the lines are already found, only an unexpected layout is searched again
+   *next = indexRecord(record) ? record.end + 1 : indexData(true, false);
+}
+
 bool Revision::isBoundary() const
 {
    return (ba.at(shaStart - 1) == '-');
 }
 
+bool Revision::isPartial() const
+{
+   // 'git log' always gives at least the '<>' of the committer e-mail
+   setup();
+   return autStart - comStart == 1;
+}
+
 uint Revision::parentsCount() const
 {
    return parentsCnt;
@@ -45,6 +62,11 @@ QString Revision::parent(int idx) const
    return QString::fromUtf8(ba.constData() + shaStart + 41 + 41 * idx);
 }
 
+const char *Revision::parentData(int idx) const
+{
+   return ba.constData() + shaStart + 41 + 41 * idx;
+}
+
 QStringList Revision::parents() const
 {
 
@@ -82,6 +104,30 @@ QString Revision::authorDate() const
    return mid(autDateStart, 10);
 }
 
+qint64 Revision::authorEpoch() const
+{
+   setup();
+
+   const auto data = ba.constData() + autDateStart;
+   auto len = 0;
+
+   while (autDateStart + len < recordEnd && data[len] >= '0' && data[len] <= '9')
+      ++len;
+
+   return QByteArray::fromRawData(data, len).toLongLong();
+}
+
+QByteArray Revision::authorNameData() const
+{
+   setup();
+
+   const auto len = autDateStart - autStart - 1;
+   const auto line = QByteArray::fromRawData(ba.constData() + autStart, len);
+   const auto email = line.indexOf('<');
+
+   return email == -1 ? line : QByteArray::fromRawData(ba.constData() + autStart, email);
+}
+
 QString Revision::shortLog() const
 {
    setup();
@@ -100,6 +146,102 @@ QString Revision::diff() const
    return mid(diffStart, diffLen);
 }
 
+QByteArray Revision::rawData() const
+{
+   // the record as 'git log' produced it, that is with the
+   // sha and parents separators overwritten by indexData() restored
+   QByteArray raw(ba.constData() + start, recordEnd - start + 1);
+
+   int idx = shaStart - start + 40;
+   raw[idx] = 'X';
+
+   for (int i = 0; i < parentsCnt; i++)
+   {
+      idx += 41;
+      raw[idx] = (i == parentsCnt - 1) ? 'X' : ' ';
+   }
+   return raw;
+}
+
+bool Revision::indexRecord(const RecordScanner::Record &record) const
+{
+   // same fields indexData() finds, from the line ends given by RecordScanner
+   const char *data = ba.constData();
+   char *fixup = const_cast<char *>(data); // to build '\0' terminating strings
+   auto line = 0;
+   auto logSize = 0;
+
+   if (record.linesCount > 0 && data[start] == 'l') // 'log size xxx\n'
+   {
+      const auto sizeStart = start + 9;
+      logSize = QByteArray::fromRawData(data + sizeStart, record.lineEnds[0] - sizeStart).toInt();
+      ++line;
+   }
+
+   // sha, committer, author and date lines at least
+   if (record.linesCount < line + 4)
+      return false;
+
+   shaStart = (line == 0 ? start : record.lineEnds[0] + 1) + 1;
+
+   const auto shaEnd = record.lineEnds[line];
+
+   // 'shaXX' for a root commit, otherwise the sha and each parent are followed by a separator
+   const auto shaLineLength = shaEnd - shaStart;
+
+   if (shaLineLength != 42 && (shaLineLength < 82 || (shaLineLength - 41) % 41 != 0))
+      return false;
+
+   parentsCnt = (shaEnd - shaStart - 41) / 41;
+
+   fixup[shaStart + 40] = '\0';
+
+   for (auto i = 0; i < parentsCnt; ++i)
+      fixup[shaStart + 81 + 41 * i] = '\0';
+
+   comStart = shaEnd + 1;
+   autStart = record.lineEnds[line + 1] + 1;
+   autDateStart = record.lineEnds[line + 2] + 1;
+   recordEnd = record.end;
+   diffStart = diffLen = 0;
+
+   const auto logEnd = logSize ? shaStart - 1 + logSize : recordEnd;
+
+   if (logEnd > recordEnd)
+      return false;
+
+   sLogStart = record.lineEnds[line + 3] + 1;
+
+   if (logEnd < sLogStart)
+   { // no shortlog no longLog
+
+      sLogStart = sLogLen = 0;
+      lLogStart = lLogLen = 0;
+   }
+   else
+   {
+      lLogStart = record.linesCount > line + 4 ? record.lineEnds[line + 4] : -1;
+
+      if (lLogStart != -1 && lLogStart < logEnd - 1)
+      {
+         sLogLen = lLogStart - sLogStart; // skip sLog trailing '\n'
+         lLogLen = logEnd - lLogStart; // include heading '\n' in long log
+      }
+      else
+      { // no longLog
+         sLogLen = logEnd - sLogStart;
+         if (data[sLogStart + sLogLen - 1] == '\n')
+            sLogLen--; // skip trailing '\n' if any
+
+         lLogStart = lLogLen = 0;
+      }
+   }
+
+   indexed = true;
+
+   return true;
+}
+
 void Revision::setup() const
 {
    if (!indexed)
@@ -206,6 +348,8 @@ int Revision::indexData(bool quick, bool withDiff) const
    if (revEnd > last) // after this point we know to have the whole record
       return error;
 
+   recordEnd = revEnd;
+
    // ok, now revEnd is valid but logEnd could be not if !logSize
    // in case of diff we are sure content will be consumed so
    // we go all the way
@@ -1,8 +1,8 @@
 #pragma once
 
-#include <QVector>
+#include <RecordScanner.h>
 
-enum class LaneType;
+#include <QStringList>
 
 class Revision
 {
@@ -13,31 +13,32 @@ class Revision
 
 public:
    Revision(const QByteArray &b, uint s, int idx, int *next);
+   Revision(const QByteArray &b, const RecordScanner::Record &record, int idx, int *next);
    bool isBoundary() const;
+   bool isPartial() const; // only topology and date known, see CommitGraph
    uint parentsCount() const;
    QString parent(int idx) const;
+   const char *parentData(int idx) const; // the 40 hex digits of the parent
    QStringList parents() const;
    QString sha() const;
    QString committer() const;
    QString author() const;
    QString authorDate() const;
+   qint64 authorEpoch() const; // the author date without building a string
+   QByteArray authorNameData() const; // the author name before the e-mail, raw
    QString shortLog() const;
    QString longLog() const;
    QString diff() const;
+   void setup() const; // index all the fields, otherwise done on first access
+   QByteArray rawData() const;
 
-   QVector<LaneType> lanes;
-   QVector<int> children;
-   QVector<int> descRefs; // list of descendant refs index, normally tags
-   QVector<int> ancRefs; // list of ancestor refs index, normally tags
-   QVector<int> descBranches; // list of descendant branches index
-   int descRefsMaster; // in case of many Revision have the same descRefs, ancRefs or
-   int ancRefsMaster; // descBranches these are stored only once in a Revision pointed
-   int descBrnMaster; // by corresponding index xxxMaster
+   // lanes are kept by RevisionsCache in side tables indexed by orderIdx,
+   // children and the refs reaching a commit by Reachability
    int orderIdx;
 
 private:
-   void setup() const;
    int indexData(bool quick, bool withDiff) const;
+   bool indexRecord(const RecordScanner::Record &record) const;
    QString mid(int start, int len) const;
    QString midSha(int start, int len) const;
 
@@ -45,6 +46,7 @@ private:
    int start;
    mutable int parentsCnt, shaStart, comStart, autStart, autDateStart;
    mutable int sLogStart, sLogLen, lLogStart, lLogLen, diffStart, diffLen;
+   mutable int recordEnd; // position of the terminating '\0'
    mutable bool indexed;
 
 public:
@@ -1,6 +1,29 @@
 #include "RevisionFile.h"
 #include <QDataStream>
 
+#include <algorithm>
+
+int RevisionFile::indexOf(quint64 key) const
+{
+   const auto cnt = count();
+
+   if (pathIndex.count() != cnt)
+   {
+      pathIndex.clear();
+      pathIndex.reserve(cnt);
+
+      for (auto i = 0; i < cnt; ++i)
+         pathIndex.append(qMakePair(pathKeyAt(i), i));
+
+      // a path listed more than once keeps its first position first
+      std::sort(pathIndex.begin(), pathIndex.end());
+   }
+
+   const auto it = std::lower_bound(pathIndex.constBegin(), pathIndex.constEnd(), qMakePair(key, 0));
+
+   return it != pathIndex.constEnd() && it->first == key ? it->second : -1;
+}
+
 /**
  * RevisionFile streaming out
  */
@@ -37,6 +60,7 @@ RevisionFile &RevisionFile::operator<<(QDataStream &stream)
 {
 
    stream >> pathsIdx;
+   resetPathIndex();
 
    bool isEmpty;
    quint32 tmp;
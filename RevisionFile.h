@@ -1,6 +1,7 @@
 #pragma once
 
 #include <QByteArray>
+#include <QPair>
 #include <QVector>
 
 class RevisionFile
@@ -22,6 +23,9 @@ class RevisionFile
    QVector<int> status;
    QVector<QString> extStatus;
 
+   // (path key, position) sorted by key, built on the first lookup
+   mutable QVector<QPair<quint64, int>> pathIndex;
+
    // prevent implicit C++ compiler defaults
    RevisionFile(const RevisionFile &);
    RevisionFile &operator=(const RevisionFile &);
@@ -58,8 +62,17 @@ public:
 
    QVector<int> mergeParent;
 
+   // dir and name ids are interned, so together they identify a path
+   static quint64 pathKey(int dir, int name)
+   {
+      return (static_cast<quint64>(static_cast<quint32>(dir)) << 32) | static_cast<quint32>(name);
+   }
+
    // helper functions
    int count() const { return pathsIdx.size() / (sizeof(int) * 2); }
+   quint64 pathKeyAt(int idx) const { return pathKey(dirAt(idx), nameAt(idx)); }
+   int indexOf(quint64 key) const;
+   void resetPathIndex() { pathIndex.clear(); }
    bool statusCmp(int idx, StatusFlag sf) const
    {
 
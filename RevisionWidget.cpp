@@ -83,6 +83,7 @@ RevisionWidget::RevisionWidget(QSharedPointer<Git> git, QWidget *parent)
    connect(fileListWidget, &FileListWidget::itemDoubleClicked, this,
            [this](QListWidgetItem *item) { emit signalOpenFileCommit(mCurrentSha, mParentSha, item->text()); });
    connect(fileListWidget, &FileListWidget::contextMenu, this, &RevisionWidget::signalOpenFileContextMenu);
+   connect(fileListWidget, &FileListWidget::signalShowFileHistory, this, &RevisionWidget::signalShowFileHistory);
 }
 
 void RevisionWidget::setup(Domain *rv)
@@ -1,34 +1,343 @@
 #include "RevisionsCache.h"
 
 #include <Revision.h>
+#include <lanes.h>
 
-RevisionsCache::RevisionsCache(QSharedPointer<Git> git, QObject *parent)
+#include <QFile>
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+#include <type_traits>
+
+// slabs are released without running destructors
+static_assert(std::is_trivially_destructible<Revision>::value, "Revision must be trivially destructible");
+
+namespace
+{
+int hexValue(ushort c)
+{
+   if (c >= '0' && c <= '9')
+      return c - '0';
+   if (c >= 'a' && c <= 'f')
+      return c - 'a' + 10;
+   if (c >= 'A' && c <= 'F')
+      return c - 'A' + 10;
+
+   return -1;
+}
+
+template<typename Char>
+bool hexToOid(const Char *data, uchar *oid)
+{
+   for (auto i = 0; i < 20; ++i)
+   {
+      const auto hi = hexValue(static_cast<ushort>(data[2 * i]));
+      const auto lo = hexValue(static_cast<ushort>(data[2 * i + 1]));
+
+      if (hi < 0 || lo < 0)
+         return false;
+
+      oid[i] = static_cast<uchar>((hi << 4) | lo);
+   }
+
+   return true;
+}
+
+bool toOid(const QString &sha, uchar *oid)
+{
+   return sha.length() == 40 && hexToOid(sha.utf16(), oid);
+}
+
+uint oidHash(const uchar *oid)
+{
+   // object ids are already uniformly distributed, their first bytes are a good hash
+   uint h;
+   memcpy(&h, oid, sizeof(h));
+   return h;
+}
+}
+
+RevisionsCache::RevisionsCache(QObject *parent)
    : QObject(parent)
-   , mGit(git)
 {
-   revs.reserve(MAX_DICT_SIZE);
+   rebuildIndex(MAX_DICT_SIZE);
+}
+
+RevisionsCache::~RevisionsCache()
+{
+   clear();
 }
 
 QString RevisionsCache::sha(int row) const
 {
-   return row >= 0 && row < revOrder.count() ? QString(revOrder.at(row)) : QString();
+   if (row < 0 || row >= revOrder.count())
+      return QString();
+
+   return QString::fromLatin1(QByteArray::fromRawData(mOids.constData() + row * OID_SIZE, OID_SIZE).toHex());
 }
 
 const Revision *RevisionsCache::revLookup(int row) const
 {
-   const auto shaStr = sha(row);
-   return !shaStr.isEmpty() ? revs.value(shaStr) : nullptr;
+   return row >= 0 && row < revOrder.count() ? revOrder.at(row) : nullptr;
 }
 
 const Revision *RevisionsCache::revLookup(const QString &sha) const
 {
-   return !sha.isEmpty() ? revs.value(sha) : nullptr;
+   return revLookup(findRow(sha));
+}
+
+bool RevisionsCache::contains(const QString &sha) const
+{
+   return findRow(sha) != -1;
+}
+
+int RevisionsCache::findRow(const QString &sha) const
+{
+   uchar oid[OID_SIZE];
+
+   if (!toOid(sha, oid))
+      return -1;
+
+   const auto slot = mIndex.at(findSlot(oid));
+
+   return slot - 1;
+}
+
+int RevisionsCache::findSlot(const uchar *oid) const
+{
+   auto i = static_cast<int>(oidHash(oid) & static_cast<uint>(mIndexMask));
+
+   forever
+   {
+      const auto slot = mIndex.at(i);
+
+      if (slot == 0 || memcmp(mOids.constData() + (slot - 1) * OID_SIZE, oid, OID_SIZE) == 0)
+         return i;
+
+      i = (i + 1) & mIndexMask;
+   }
 }
 
-void RevisionsCache::insertRevision(const QString sha, const Revision &rev)
+void RevisionsCache::insertIndex(int row)
 {
-   revs.insert(sha, new Revision(rev));
-   revOrder.append(sha);
+   if (2 * (row + 1) > mIndex.count())
+      rebuildIndex(2 * mIndex.count());
+
+   // a duplicated id points to the latest row, as QHash::insert() did
+   const auto oid = reinterpret_cast<const uchar *>(mOids.constData() + row * OID_SIZE);
+   mIndex[findSlot(oid)] = row + 1;
+}
+
+void RevisionsCache::rebuildIndex(int capacity)
+{
+   auto size = 16;
+   while (size < capacity)
+      size <<= 1;
+
+   mIndex.fill(0, size);
+   mIndexMask = size - 1;
+
+   for (auto row = 0, cnt = revOrder.count(); row < cnt; ++row)
+   {
+      const auto oid = reinterpret_cast<const uchar *>(mOids.constData() + row * OID_SIZE);
+      mIndex[findSlot(oid)] = row + 1;
+   }
+}
+
+Revision *RevisionsCache::allocRevision(const Revision &rev)
+{
+   if (mSlabUsed == SLAB_SIZE)
+   {
+      mSlabs.append(static_cast<Revision *>(::operator new(sizeof(Revision) * SLAB_SIZE)));
+      mSlabUsed = 0;
+   }
+
+   return new (mSlabs.last() + mSlabUsed++) Revision(rev);
+}
+
+void RevisionsCache::insertRevision(const QString sha, const Revision &rev, const Columns &columns)
+{
+   uchar oid[OID_SIZE];
+
+   if (!toOid(sha, oid))
+      return;
+
+   const auto id = takeId(oid);
+   mOids.append(reinterpret_cast<const char *>(oid), OID_SIZE);
+   revOrder.append(allocRevision(rev));
+   mTopology.ids.append(id);
+   mTopology.parentsStart.append(0);
+   mTopology.parentsCount.append(0);
+   mTopology.flags.append(0);
+   mIdRows[id] = revOrder.count() - 1;
+   mLaneStart.append(0);
+   mLaneCount.append(0);
+   mAuthorDates.append(columns.authorDate);
+   mAuthorIds.append(columns.authorId);
+
+   insertIndex(revOrder.count() - 1);
+   setTopology(revOrder.count() - 1);
+}
+
+void RevisionsCache::insertRevisions(int row, const QVector<Revision> &revisions, const QVector<Columns> &columns)
+{
+   QByteArray oids;
+   QVector<const Revision *> added;
+   QVector<int> ids;
+   QVector<Columns> addedColumns;
+
+   for (auto i = 0; i < revisions.count(); ++i)
+   {
+      uchar oid[OID_SIZE];
+
+      if (toOid(revisions.at(i).sha(), oid))
+      {
+         oids.append(reinterpret_cast<const char *>(oid), OID_SIZE);
+         added.append(allocRevision(revisions.at(i)));
+         ids.append(takeId(oid));
+         addedColumns.append(columns.value(i));
+      }
+   }
+
+   const auto n = added.count();
+
+   if (n == 0)
+      return;
+
+   revOrder.insert(row, n, nullptr);
+   std::copy(added.constBegin(), added.constEnd(), revOrder.begin() + row);
+   mOids.insert(row * OID_SIZE, oids);
+   mTopology.ids.insert(row, n, 0);
+   std::copy(ids.constBegin(), ids.constEnd(), mTopology.ids.begin() + row);
+   mTopology.parentsStart.insert(row, n, 0);
+   mTopology.parentsCount.insert(row, n, 0);
+   mTopology.flags.insert(row, n, 0);
+   mLaneStart.insert(row, n, 0);
+   mLaneCount.insert(row, n, 0);
+   mAuthorDates.insert(row, n, 0);
+   mAuthorIds.insert(row, n, -1);
+
+   for (auto i = 0; i < n; ++i)
+   {
+      mAuthorDates[row + i] = addedColumns.at(i).authorDate;
+      mAuthorIds[row + i] = addedColumns.at(i).authorId;
+   }
+
+   // rows below are shifted down
+   for (auto i = row; i < revOrder.count(); ++i)
+   {
+      const_cast<Revision *>(revOrder.at(i))->orderIdx = i;
+      mIdRows[mTopology.ids.at(i)] = i;
+   }
+
+   // the lanes below the new rows are kept, the model recomputes them
+   // until they match again
+
+   rebuildIndex(2 * revOrder.count());
+
+   // parents among the new rows are found once they are all indexed
+   for (auto i = row; i < row + n; ++i)
+      setTopology(i);
+}
+
+void RevisionsCache::updateRevision(int row, const Revision &rev)
+{
+   if (row < 0 || row >= revOrder.count())
+      return;
+
+   // the object id does not change, the index is still valid
+   const auto r = allocRevision(rev);
+   r->orderIdx = row;
+   revOrder[row] = r;
+
+   // decoded again from the new revision when next shown
+   mAuthorIds[row] = -1;
+   setFlags(row);
+}
+
+void RevisionsCache::setTopology(int row)
+{
+   // parents are read as they are in the record, no string is built
+   const auto rev = revOrder.at(row);
+   const auto count = static_cast<int>(rev->parentsCount());
+
+   mTopology.parentsStart[row] = mTopology.parents.count();
+   mTopology.parentsCount[row] = count;
+
+   for (auto idx = 0; idx < count; ++idx)
+   {
+      uchar oid[OID_SIZE];
+      mTopology.parents.append(hexToOid(rev->parentData(idx), oid) ? commitId(oid) : -1);
+   }
+
+   setFlags(row);
+}
+
+void RevisionsCache::setFlags(int row)
+{
+   const auto rev = revOrder.at(row);
+   quint8 flags = 0;
+
+   if (rev->isBoundary())
+      flags |= Topology::BOUNDARY;
+
+   if (rev->isApplied)
+      flags |= Topology::APPLIED;
+
+   if (rev->isDiffCache)
+      flags |= Topology::WORKING_DIR;
+
+   mTopology.flags[row] = flags;
+}
+
+void RevisionsCache::decodeColumns(int row) const
+{
+   const auto rev = revOrder.at(row);
+
+   mAuthorDates[row] = rev->authorEpoch();
+   mAuthorIds[row] = authorNameId(QString::fromLocal8Bit(rev->authorNameData()));
+}
+
+int RevisionsCache::authorNameId(const QString &name) const
+{
+   auto it = mAuthorNameIds.constFind(name);
+
+   if (it == mAuthorNameIds.constEnd())
+   {
+      it = mAuthorNameIds.insert(name, mAuthorNames.count());
+      mAuthorNames.append(name);
+   }
+
+   return it.value();
+}
+
+qint64 RevisionsCache::authorDate(int row) const
+{
+   if (row < 0 || row >= mAuthorDates.count())
+      return 0;
+
+   if (mAuthorIds.at(row) == -1)
+      decodeColumns(row);
+
+   return mAuthorDates.at(row);
+}
+
+int RevisionsCache::authorId(int row) const
+{
+   if (row < 0 || row >= mAuthorIds.count())
+      return -1;
+
+   if (mAuthorIds.at(row) == -1)
+      decodeColumns(row);
+
+   return mAuthorIds.at(row);
+}
+
+QString RevisionsCache::subject(int row) const
+{
+   // read from the record of the revision, it is only decoded here
+   return row >= 0 && row < revOrder.count() ? revOrder.at(row)->shortLog() : QString();
 }
 
 QString RevisionsCache::getShortLog(const QString &sha) const
@@ -39,7 +348,119 @@ QString RevisionsCache::getShortLog(const QString &sha) const
 
 int RevisionsCache::row(const QString &sha) const
 {
-   return !sha.isEmpty() && revs.value(sha) ? revs.value(sha)->orderIdx : -1;
+   const auto r = revLookup(sha);
+   return r ? r->orderIdx : -1;
+}
+
+int RevisionsCache::lanesCount(int row) const
+{
+   return row >= 0 && row < mLaneCount.count() ? mLaneCount.at(row) : 0;
+}
+
+LaneType RevisionsCache::lane(int row, int pos) const
+{
+   return mLanePool.at(mLaneStart.at(row) + pos);
+}
+
+void RevisionsCache::setLanes(int row, const QVector<LaneType> &lanes)
+{
+   setLanes(row, lanes.constData(), lanes.count());
+}
+
+void RevisionsCache::setLanes(int row, const LaneType *lanes, int count)
+{
+   if (row < 0 || row >= mLaneCount.count())
+      return;
+
+   const auto start = mLanePool.count();
+   mLanePool.resize(start + count);
+   std::copy(lanes, lanes + count, mLanePool.begin() + start);
+   mLaneStart[row] = start;
+   mLaneCount[row] = count;
+}
+
+void RevisionsCache::resetLanes(int fromRow)
+{
+   // keep the lanes above fromRow, compacting the pool since
+   // the entries of the rows being reset are never reused
+   QVector<LaneType> pool;
+
+   for (auto i = 0; i < mLaneCount.count(); ++i)
+   {
+      if (i >= fromRow)
+         mLaneCount[i] = 0;
+
+      const auto start = pool.count();
+      for (auto j = 0; j < mLaneCount.at(i); ++j)
+         pool.append(mLanePool.at(mLaneStart.at(i) + j));
+
+      mLaneStart[i] = start;
+   }
+
+   mLanePool = pool;
+}
+
+int RevisionsCache::commitId(const QString &sha)
+{
+   uchar oid[OID_SIZE];
+
+   return toOid(sha, oid) ? commitId(oid) : -1;
+}
+
+int RevisionsCache::commitId(const uchar *oid)
+{
+   const auto slot = mIndex.at(findSlot(oid));
+
+   if (slot != 0)
+      return mTopology.ids.at(slot - 1);
+
+   const auto it = mPendingIds.constFind(QByteArray::fromRawData(reinterpret_cast<const char *>(oid), OID_SIZE));
+
+   if (it != mPendingIds.constEnd())
+      return it.value();
+
+   const auto id = mIdRows.count();
+   mIdRows.append(-1);
+   setPending(id, oid);
+
+   return id;
+}
+
+int RevisionsCache::takeId(const uchar *oid)
+{
+   // a commit seen before as a parent keeps its id
+   const auto it = mPendingIds.find(QByteArray::fromRawData(reinterpret_cast<const char *>(oid), OID_SIZE));
+
+   if (it != mPendingIds.end())
+   {
+      const auto id = it.value();
+      mPendingIds.erase(it);
+      mPendingOids.remove(id);
+      return id;
+   }
+
+   mIdRows.append(-1);
+
+   return mIdRows.count() - 1;
+}
+
+void RevisionsCache::setPending(int id, const uchar *oid)
+{
+   const QByteArray key(reinterpret_cast<const char *>(oid), OID_SIZE);
+   mPendingIds.insert(key, id);
+   mPendingOids.insert(id, key);
+}
+
+QString RevisionsCache::commitSha(int id) const
+{
+   const auto row = commitRow(id);
+
+   if (row != -1)
+      return sha(row);
+
+   const auto it = mPendingOids.constFind(id);
+
+   return it != mPendingOids.constEnd() ? QString::fromLatin1(it.value().toHex()) : QString();
 }
 
 void RevisionsCache::flushTail(int earlyOutputCnt, int earlyOutputCntBase)
@@ -49,27 +470,64 @@ void RevisionsCache::flushTail(int earlyOutputCnt, int earlyOutputCntBase)
 
    auto cnt = count() - earlyOutputCnt + 1;
 
-   while (cnt > 0)
+   // the arena slots of the flushed revisions are reclaimed in clear()
+   const auto newCount = qMax(0, count() - cnt);
+
+   // the flushed commits keep their ids, as if never loaded
+   for (auto row = newCount; row < count(); ++row)
    {
-      const QString &sha = revOrder.last();
-      const Revision *c = revs[sha];
-      delete c;
-      revs.remove(sha);
-      revOrder.pop_back();
-      --cnt;
+      const auto id = mTopology.ids.at(row);
+      mIdRows[id] = -1;
+      setPending(id, reinterpret_cast<const uchar *>(mOids.constData() + row * OID_SIZE));
    }
 
+   revOrder.resize(newCount);
+   mTopology.ids.resize(newCount);
+   mTopology.parentsStart.resize(newCount);
+   mTopology.parentsCount.resize(newCount);
+   mTopology.flags.resize(newCount);
+   mOids.resize(newCount * OID_SIZE);
+   mLaneStart.resize(newCount);
+   mLaneCount.resize(newCount);
+   mAuthorDates.resize(newCount);
+   mAuthorIds.resize(newCount);
+
+   // open addressing does not support removals, the index is rebuilt
+   rebuildIndex(mIndex.count());
+
    // reset all lanes, will be redrawn
-   for (int i = earlyOutputCntBase; i < revOrder.count(); i++)
-   {
-      const auto c = const_cast<Revision *>(revs[revOrder[i]]);
-      c->lanes.clear();
-   }
+   resetLanes(earlyOutputCntBase);
 }
 
 void RevisionsCache::clear()
 {
-   qDeleteAll(revs);
-   revs.clear();
    revOrder.clear();
+   mOids.clear();
+   rebuildIndex(MAX_DICT_SIZE);
+
+   for (auto slab : qAsConst(mSlabs))
+      ::operator delete(slab);
+
+   mSlabs.clear();
+   mSlabUsed = SLAB_SIZE;
+
+   qDeleteAll(mLogBuffers);
+   mLogBuffers.clear();
+
+   // buffers on top of a mapping do not own their data, files go last
+   qDeleteAll(mMappedFiles);
+   mMappedFiles.clear();
+
+   mLanePool.clear();
+   mLaneStart.clear();
+   mLaneCount.clear();
+   mTopology = Topology();
+   mIdRows.clear();
+   mPendingIds.clear();
+   mPendingOids.clear();
+
+   mAuthorDates.clear();
+   mAuthorIds.clear();
+   mAuthorNames.clear();
+   mAuthorNameIds.clear();
 }
@@ -25,40 +25,148 @@
 
 #include <QObject>
 #include <QHash>
-#include <QSharedPointer>
+#include <QVector>
 
-class Git;
+class QFile;
 class Revision;
+enum class LaneType : quint8;
 
 class RevisionsCache : public QObject
 {
    Q_OBJECT
 
-signals:
-   void signalCacheUpdated();
-
 public:
-   explicit RevisionsCache(QSharedPointer<Git> git, QObject *parent = nullptr);
+   /* The columns shown in the log, filled by the workers parsing 'git log'
+    * so that adding a row only copies them. A row added without them, or
+    * updated, decodes them from its revision on first access.
+    */
+   struct Columns
+   {
+      qint64 authorDate = 0;
+      int authorId = -1; // -1 until decoded
+   };
+
+   /* The graph of the rows as plain arrays, filled once when a row is added.
+    * They are implicitly shared, so a copy is taken in constant time and is
+    * read by another thread while the cache keeps changing.
+    */
+   struct Topology
+   {
+      enum Flags : quint8
+      {
+         BOUNDARY = 1,
+         APPLIED = 2,
+         WORKING_DIR = 4
+      };
+
+      QVector<int> ids; // row -> commit id
+      QVector<int> parentsStart; // row -> its first parent in parents
+      QVector<int> parentsCount;
+      QVector<int> parents; // commit ids, the entries of removed rows are left until clear()
+      QVector<quint8> flags;
+   };
+
+   explicit RevisionsCache(QObject *parent = nullptr);
+   ~RevisionsCache();
 
    QString sha(int row) const;
    const Revision *revLookup(int row) const;
    const Revision *revLookup(const QString &sha) const;
-   void insertRevision(const QString sha, const Revision &rev);
+   void insertRevision(const QString sha, const Revision &rev, const Columns &columns = Columns());
+   void insertRevisions(int row, const QVector<Revision> &revisions, const QVector<Columns> &columns);
+   void updateRevision(int row, const Revision &rev);
    QString getShortLog(const QString &sha) const;
    int row(const QString &sha) const;
    int count() const { return revOrder.count(); }
    bool isEmpty() const { return revOrder.isEmpty(); }
    void flushTail(int earlyOutputCnt, int earlyOutputCntBase);
    void clear();
-   QString &createRevisionSha(int index) { return revOrder[index]; }
-   QString getRevisionSha(int index) const { return revOrder.at(index); }
    int revOrderCount() const { return revOrder.count(); }
-   bool contains(const QString &sha) { return revs.contains(sha); }
+   bool contains(const QString &sha) const;
+
+   /* The cache owns the raw 'git log' buffers the revisions point into,
+    * and the files mapped in memory backing some of them, so they are
+    * released together with the revisions in clear().
+    */
+   void adoptLogBuffer(QByteArray *buffer) { mLogBuffers.append(buffer); }
+   void adoptMappedFile(QFile *file) { mMappedFiles.append(file); }
+
+   int lanesCount(int row) const;
+   LaneType lane(int row, int pos) const;
+   void setLanes(int row, const QVector<LaneType> &lanes);
+   void setLanes(int row, const LaneType *lanes, int count);
+   void resetLanes(int fromRow);
+
+   /* Every commit taking part in the graph, loaded or only known as a
+    * parent so far, has a small integer id stable until clear(). Loaded
+    * commits are found through the object id index, the parents not
+    * loaded yet through a small table keyed by their object id, and they
+    * keep their id once loaded.
+    */
+   int commitId(int row) const { return mTopology.ids.at(row); }
+   int commitId(const QString &sha);
+   int parentId(int row, int idx) const { return mTopology.parents.at(mTopology.parentsStart.at(row) + idx); }
+   const Topology &topology() const { return mTopology; }
+   int commitRow(int id) const { return id >= 0 && id < mIdRows.count() ? mIdRows.at(id) : -1; }
+   int commitsCount() const { return mIdRows.count(); }
+   QString commitSha(int id) const;
 
-   static const int MAX_DICT_SIZE = 100003; // must be a prime number see QDict docs
+   qint64 authorDate(int row) const;
+   int authorId(int row) const;
+   int internAuthor(const QString &name) { return authorNameId(name); }
+   QString authorName(int id) const { return mAuthorNames.value(id); }
+   int authorsCount() const { return mAuthorNames.count(); }
+   QString subject(int row) const;
+
+   static const int MAX_DICT_SIZE = 100003; // initial capacity of the commit index
 
 private:
-   QSharedPointer<Git> mGit;
-   QHash<QString, const Revision *> revs;
-   QVector<QString> revOrder;
+   static const int SLAB_SIZE = 4096; // revisions per arena block
+   static const int OID_SIZE = 20; // raw SHA-1 bytes
+
+   // Rows are kept in loading order together with the binary object id of
+   // each one. Lookup by id goes through an open-addressing table of
+   // (row + 1) slots, 0 meaning empty, probed linearly and kept at most
+   // half full.
+   QVector<const Revision *> revOrder;
+   QByteArray mOids;
+   QVector<int> mIndex;
+   int mIndexMask = 0;
+
+   // Revisions are copy-constructed into fixed size slabs instead of being
+   // allocated one by one, the whole arena is dropped at once in clear()
+   QVector<Revision *> mSlabs;
+   int mSlabUsed = SLAB_SIZE;
+   QVector<QByteArray *> mLogBuffers;
+   QVector<QFile *> mMappedFiles;
+
+   // Lanes of every row live in a single pool, each row keeps where its
+   // lanes start and how many they are. Lists that are empty for most of
+   // the commits are stored sparsely.
+   QVector<LaneType> mLanePool;
+   QVector<int> mLaneStart;
+   QVector<int> mLaneCount;
+   Topology mTopology;
+   QVector<int> mIdRows; // commit id -> row, -1 while not loaded
+   QHash<QByteArray, int> mPendingIds; // object ids of the commits not loaded
+   QHash<int, QByteArray> mPendingOids;
+
+   // log columns, one entry per row, see Columns
+   mutable QVector<qint64> mAuthorDates;
+   mutable QVector<int> mAuthorIds;
+   mutable QVector<QString> mAuthorNames;
+   mutable QHash<QString, int> mAuthorNameIds;
+
+   Revision *allocRevision(const Revision &rev);
+   int findRow(const QString &sha) const;
+   int findSlot(const uchar *oid) const;
+   void insertIndex(int row);
+   void rebuildIndex(int capacity);
+   int commitId(const uchar *oid);
+   int takeId(const uchar *oid);
+   void setPending(int id, const uchar *oid);
+   void setTopology(int row);
+   void setFlags(int row);
+   void decodeColumns(int row) const;
+   int authorNameId(const QString &name) const;
 };
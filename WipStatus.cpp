@@ -0,0 +1,163 @@
+#include "WipStatus.h"
+
+#include <QProcess>
+#include <QtConcurrent/QtConcurrentRun>
+
+namespace
+{
+const int kTimeout = 60000;
+
+// where the n-th space separated field of a status line starts
+int fieldStart(const QByteArray &record, int field)
+{
+   auto pos = 0;
+
+   for (auto i = 0; i < field && pos != -1; ++i)
+   {
+      pos = record.indexOf(' ', pos);
+
+      if (pos != -1)
+         ++pos;
+   }
+
+   return pos;
+}
+}
+
+WipStatus WipStatus::read(const QString &workingDir)
+{
+   WipStatus status;
+
+   QProcess process;
+   process.setWorkingDirectory(workingDir);
+
+   auto env = QProcessEnvironment::systemEnvironment();
+   env.insert("GIT_TRACE", "0"); // avoid choking on debug traces
+   process.setProcessEnvironment(env);
+
+   // the index is not refreshed on disk: status runs on its own when files
+   // change and must not take index.lock from the git commands of the user
+   process.start("git",
+                 { "--no-optional-locks", "-c", "core.untrackedCache=true", "status", "--porcelain=v2", "-z",
+                   "--branch", "--untracked-files=all" });
+
+   if (!process.waitForFinished(kTimeout) || process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0)
+   {
+      process.kill();
+      return status;
+   }
+
+   status.parse(process.readAllStandardOutput());
+
+   return status;
+}
+
+QFuture<WipStatus> WipStatus::readAsync(const QString &workingDir)
+{
+   return QtConcurrent::run(&WipStatus::read, workingDir);
+}
+
+bool WipStatus::parse(const QByteArray &output)
+{
+   clear();
+
+   // every record ends with a '\0', the original path
+   // of a rename or a copy is a record on its own
+   const auto records = output.split('\0');
+
+   for (auto i = 0; i < records.count(); ++i)
+   {
+      const auto &record = records.at(i);
+
+      if (record.size() < 2)
+         continue;
+
+      switch (record.at(0))
+      {
+         case '#':
+            if (record.startsWith("# branch.oid "))
+            {
+               const auto oid = record.mid(13);
+               mHead = oid == "(initial)" ? QString() : QString::fromLatin1(oid);
+            }
+            else if (record.startsWith("# branch.head "))
+            {
+               const auto head = record.mid(14);
+               mBranch = head == "(detached)" ? QString() : QString::fromUtf8(head);
+            }
+            break;
+         case '1':
+         case '2':
+         case 'u': {
+            // ordinary, renamed or copied and unmerged entries
+            const auto field = record.at(0) == '1' ? 8 : record.at(0) == '2' ? 9 : 10;
+            const auto pathStart = fieldStart(record, field);
+
+            if (pathStart == -1 || record.size() < 4)
+               return false;
+
+            Entry entry;
+            entry.path = QString::fromUtf8(record.mid(pathStart));
+            entry.index = record.at(2);
+            entry.workTree = record.at(3);
+
+            if (record.at(0) == '2' && ++i < records.count())
+               entry.origPath = QString::fromUtf8(records.at(i));
+
+            mChanges.append(entry);
+            break;
+         }
+         case '?':
+            mUntracked.append(QString::fromUtf8(record.mid(2)));
+            break;
+         default:
+            break;
+      }
+   }
+
+   mValid = true;
+
+   return true;
+}
+
+void WipStatus::clear()
+{
+   mValid = false;
+   mHead.clear();
+   mBranch.clear();
+   mChanges.clear();
+   mUntracked.clear();
+}
+
+QString WipStatus::summary() const
+{
+   // a short 'git status', shown as the message of the working dir revision
+   QString staged;
+   QString unstaged;
+
+   for (const auto &change : mChanges)
+   {
+      if (change.isStaged())
+         staged.append(QString("\t%1 %2\n").arg(QChar::fromLatin1(change.index), change.path));
+
+      if (change.workTree != '.')
+         unstaged.append(QString("\t%1 %2\n").arg(QChar::fromLatin1(change.workTree), change.path));
+   }
+
+   auto text = mBranch.isEmpty() ? QString("HEAD detached at %1\n").arg(mHead.left(8))
+                                 : QString("On branch %1\n").arg(mBranch);
+
+   if (!staged.isEmpty())
+      text.append(QString("\nChanges to be committed:\n%1").arg(staged));
+
+   if (!unstaged.isEmpty())
+      text.append(QString("\nChanges not staged for commit:\n%1").arg(unstaged));
+
+   if (!mUntracked.isEmpty())
+      text.append(QString("\nUntracked files:\n\t%1\n").arg(mUntracked.join("\n\t")));
+
+   if (staged.isEmpty() && unstaged.isEmpty() && mUntracked.isEmpty())
+      text.append("\nnothing to commit, working tree clean\n");
+
+   return text;
+}
@@ -0,0 +1,70 @@
+#pragma once
+
+/****************************************************************************************
+ ** GitQlient is an application to manage and operate one or several Git repositories. With
+ ** GitQlient you will be able to add commits, branches and manage all the options Git provides.
+ ** Copyright (C) 2019  Francesc Martinez
+ **
+ ** LinkedIn: www.linkedin.com/in/cescmm/
+ ** Web: www.francescmm.com
+ **
+ ** This program is free software; you can redistribute it and/or
+ ** modify it under the terms of the GNU Lesser General Public
+ ** License as published by the Free Software Foundation; either
+ ** version 2 of the License, or (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY; without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ ** Lesser General Public License for more details.
+ **
+ ** You should have received a copy of the GNU Lesser General Public
+ ** License along with this library; if not, write to the Free Software
+ ** Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA  02110-1301  USA
+ ***************************************************************************************/
+
+
+#include <QFuture>
+#include <QStringList>
+#include <QVector>
+
+/* State of the working directory, that is the current branch and the
+ * staged, unstaged and untracked files, read from a single
+ * 'git status --porcelain=v2 -z' run. Reading it blocks, so it is meant
+ * to run in a worker thread through readAsync(). The untracked cache is
+ * enabled for the run and the fsmonitor configured for the repository,
+ * if any, is used by git as usual.
+ */
+class WipStatus
+{
+public:
+   struct Entry
+   {
+      QString path;
+      QString origPath; // renamed or copied from, if any
+      char index = '.'; // status in the index and in the working tree,
+      char workTree = '.'; // as the XY of 'git status --short'
+
+      bool isStaged() const { return index != '.'; }
+   };
+
+   static WipStatus read(const QString &workingDir);
+   static QFuture<WipStatus> readAsync(const QString &workingDir);
+
+   bool parse(const QByteArray &output);
+   void clear();
+
+   bool isValid() const { return mValid; }
+   QString head() const { return mHead; }
+   QString branch() const { return mBranch; }
+   QVector<Entry> changes() const { return mChanges; }
+   QStringList untracked() const { return mUntracked; }
+   QString summary() const;
+
+private:
+   bool mValid = false;
+   QString mHead; // empty if there are no commits yet
+   QString mBranch; // empty if detached
+   QVector<Entry> mChanges;
+   QStringList mUntracked;
+};
@@ -0,0 +1,19 @@
+# Measures how fast the output of 'git log' is split into revisions,
+# see main.cpp for how to run it
+TEMPLATE = app
+CONFIG += qt warn_on c++17 console release
+CONFIG -= app_bundle
+QMAKE_CXXFLAGS += -Werror
+TARGET = RecordScannerBenchmark
+QT = core
+
+INCLUDEPATH += ../..
+
+HEADERS += \
+    ../../RecordScanner.h \
+    ../../Revision.h
+
+SOURCES += \
+    ../../RecordScanner.cpp \
+    ../../Revision.cpp \
+    main.cpp
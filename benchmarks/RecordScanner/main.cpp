@@ -0,0 +1,140 @@
+/* Measures RecordScanner::scan() alone and followed by indexing every
+ * Revision, as DataLoader does, over captured 'git log' output:
+ *
+ *    RecordScannerBenchmark <log file>    reads output captured before with
+ *                                         the command printed by --command
+ *                                         in the repository
+ *    RecordScannerBenchmark [repository]  captures it from the repository,
+ *                                         the current directory by default
+ *
+ * The log is repeated up to TARGET_SIZE so that small repositories give
+ * stable figures, and the best of RUNS runs is reported.
+ */
+
+#include <RecordScanner.h>
+#include <Revision.h>
+
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QTextStream>
+
+namespace
+{
+// as in Git::logCommand()
+const QString GIT_LOG_FORMAT = "%m%HX%PX%n%cn<%ce>%n%an<%ae>%n%at%n%s%n%b";
+const QStringList GIT_LOG_ARGS = { "log", "--date-order", "--no-color", "--log-size", "--parents", "-z",
+                                   "--pretty=format:" + GIT_LOG_FORMAT, "--boundary", "--all" };
+const int TARGET_SIZE = 512 * 1024 * 1024;
+const int RUNS = 5;
+
+QByteArray captureLog(const QString &workingDir)
+{
+   QProcess git;
+   git.setWorkingDirectory(workingDir);
+   git.start("git", GIT_LOG_ARGS);
+
+   if (!git.waitForFinished(-1) || git.exitCode() != 0)
+      return QByteArray();
+
+   return git.readAllStandardOutput();
+}
+
+double gigabytesPerSecond(qint64 bytes, qint64 nsecs)
+{
+   return nsecs > 0 ? static_cast<double>(bytes) / nsecs : 0.0;
+}
+}
+
+int main(int argc, char *argv[])
+{
+   QCoreApplication app(argc, argv);
+   QTextStream out(stdout);
+   const auto args = app.arguments();
+
+   if (args.value(1) == "--command")
+   {
+      out << "git";
+
+      // the format is quoted for the shell
+      for (const auto &arg : GIT_LOG_ARGS)
+         out << ' ' << (arg.contains('%') ? QString("'%1'").arg(arg) : arg);
+
+      out << " > log.txt" << '\n';
+      return 0;
+   }
+
+   const auto source = args.value(1, ".");
+   QByteArray log;
+
+   if (QFileInfo(source).isDir())
+      log = captureLog(source);
+   else
+   {
+      QFile file(source);
+
+      if (file.open(QIODevice::ReadOnly))
+         log = file.readAll();
+   }
+
+   if (log.isEmpty())
+   {
+      out << "No 'git log' output read from " << source << '\n';
+      return 1;
+   }
+
+   // '-z' separates the records, the last one is terminated too
+   if (!log.endsWith('\0'))
+      log.append('\0');
+
+   QByteArray buffer;
+   buffer.reserve(TARGET_SIZE + log.size());
+
+   do
+      buffer.append(log);
+   while (buffer.size() < TARGET_SIZE);
+
+   qint64 scanTime = -1;
+   qint64 indexTime = -1;
+   auto revisions = 0;
+
+   for (auto run = 0; run < RUNS; ++run)
+   {
+      QElapsedTimer timer;
+      timer.start();
+
+      const auto records = RecordScanner::scan(buffer, 0, buffer.size());
+
+      const auto scanned = timer.nsecsElapsed();
+
+      revisions = 0;
+
+      for (const auto &record : records)
+      {
+         int next;
+         Revision revision(buffer, record, -1, &next);
+
+         if (next < 0)
+            break;
+
+         revision.setup();
+         ++revisions;
+      }
+
+      const auto indexed = timer.nsecsElapsed();
+
+      if (scanTime == -1 || scanned < scanTime)
+         scanTime = scanned;
+
+      if (indexTime == -1 || indexed < indexTime)
+         indexTime = indexed;
+   }
+
+   out << QString("%1 MB, %2 revisions").arg(buffer.size() / (1024 * 1024)).arg(revisions) << '\n';
+   out << QString("scan: %1 GB/s").arg(gigabytesPerSecond(buffer.size(), scanTime), 0, 'f', 2) << '\n';
+   out << QString("scan and index: %1 GB/s").arg(gigabytesPerSecond(buffer.size(), indexTime), 0, 'f', 2) << '\n';
+
+   return 0;
+}
@@ -9,13 +9,29 @@
 #include "git.h"
 #include "dataloader.h"
 
+#include <RecordScanner.h>
+#include <RevisionsCache.h>
+#include <Revision.h>
+
 #include <QDir>
+#include <QFutureWatcher>
+#include <QtConcurrent/QtConcurrentRun>
 #include <QTemporaryFile>
 #include <QTextStream>
 
 #define GUI_UPDATE_INTERVAL 500
 #define READ_BLOCK_SIZE 65535
 
+// revisions indexed by a worker, with the buffer they point into
+struct DataLoader::LogBatch
+{
+   QByteArray *buffer = nullptr;
+   QVector<Revision> revisions;
+   QVector<bool> finalOutput; // "Final output" marker found before the revision
+   QVector<RevisionsCache::Columns> columns; // author ids index the authors of the batch
+   QStringList authors;
+};
+
 class UnbufferedTemporaryFile : public QTemporaryFile
 {
 public:
@@ -26,15 +42,19 @@ public:
    bool unbufOpen() { return open(QIODevice::ReadOnly | QIODevice::Unbuffered); }
 };
 
-DataLoader::DataLoader(Git *git)
+DataLoader::DataLoader(Git *git, LoadMode mode)
    : QProcess()
    , mGit(git)
+   , mLoadMode(mode)
 {
    canceling = parsing = false;
    isProcExited = true;
    halfChunk = nullptr;
    dataFile = nullptr;
    loadedBytes = 0;
+   mRowsAtStart = 0;
+   mFirstRowTime = -1;
+   mLoadFinished = false;
    guiUpdateTimer.setSingleShot(true);
 
    connect(mGit, &Git::cancelAllProcesses, this, &DataLoader::on_cancel);
@@ -47,6 +67,16 @@ DataLoader::~DataLoader()
    // avoid a Qt warning in case we are
    // destroyed while still running
    waitForFinished(1000);
+
+   // workers write into the buffers they parse, let them finish
+   // before releasing what has not been committed to the cache
+   for (auto watcher : qAsConst(mPendingBatches))
+   {
+      watcher->waitForFinished();
+      delete watcher->result().buffer;
+   }
+
+   delete halfChunk;
 }
 
 void DataLoader::on_cancel()
@@ -56,6 +86,10 @@ void DataLoader::on_cancel()
    { // just once
       canceling = true;
       kill(); // SIGKILL (Unix and Mac), TerminateProcess (Windows)
+
+      // nothing else is going to wake us up if only the commit was pending
+      if (mLoadFinished)
+         deleteLater();
    }
 }
 
@@ -70,14 +104,24 @@ bool DataLoader::start(const QStringList &args, const QString &wd, const QString
 
    connect(this, qOverload<int, QProcess::ExitStatus>(&DataLoader::finished), this, &DataLoader::on_finished);
 
-   if (!createTemporaryFile() || !startProcess(this, args, buf))
+   const auto usePipe = mLoadMode == LoadMode::Pipe;
+
+   if (usePipe)
+      connect(this, &DataLoader::readyReadStandardOutput, this, &DataLoader::on_readyRead);
+
+   if ((!usePipe && !createTemporaryFile()) || !startProcess(this, args, buf))
    {
       const auto erorr = readAll();
       deleteLater();
       return false;
    }
+   mRowsAtStart = mGit->mRevCache->count();
    loadTime.start();
-   guiUpdateTimer.start(GUI_UPDATE_INTERVAL);
+
+   // with the pipe data is parsed as soon as it arrives, no polling needed
+   if (!usePipe)
+      guiUpdateTimer.start(GUI_UPDATE_INTERVAL);
+
    return true;
 }
 
@@ -85,10 +129,44 @@ void DataLoader::on_finished(int, QProcess::ExitStatus)
 {
    isProcExited = true;
 
+   if (mLoadMode == LoadMode::Pipe)
+   {
+      if (!canceling)
+      {
+         // drain whatever is still buffered before closing the stream
+         loadedBytes += readPipeData();
+         parseLastBuffer();
+
+         // loaded() is sent once the last batch has been committed
+         mLoadFinished = true;
+         commitParsedBatches();
+      }
+      else
+         deleteLater();
+
+      return;
+   }
+
    if (guiUpdateTimer.isActive()) // no need to wait anymore
       guiUpdateTimer.start(1);
 }
 
+void DataLoader::on_readyRead()
+{
+   if (canceling)
+      return;
+
+   parsing = true;
+   loadedBytes += readPipeData();
+   parsing = false;
+}
+
+void DataLoader::updateFirstRowTime()
+{
+   if (mFirstRowTime == -1 && mGit->mRevCache->count() > mRowsAtStart)
+      mFirstRowTime = loadTime.elapsed();
+}
+
 void DataLoader::on_timeout()
 {
 
@@ -102,12 +180,11 @@ void DataLoader::on_timeout()
    // process could exit while we are processing so save the flag now
    bool lastBuffer = isProcExited;
    loadedBytes += readNewData(lastBuffer);
-   emit newDataReady(); // inserting in list view is about 3% of total time
 
    if (lastBuffer)
    {
-      emit loaded(loadedBytes, loadTime.elapsed(), true, "", "");
-      deleteLater();
+      mLoadFinished = true;
+      commitParsedBatches();
    }
    else if (isProcExited)
       guiUpdateTimer.start(1);
@@ -117,13 +194,16 @@ void DataLoader::on_timeout()
    parsing = false;
 }
 
-void DataLoader::parseSingleBuffer(const QByteArray &ba)
+void DataLoader::parseSingleBuffer(QByteArray *ba)
 {
 
-   if (ba.size() == 0 || canceling)
+   if (ba->size() == 0 || canceling)
+   {
+      delete ba;
       return;
+   }
 
-   int ofs = 0, newOfs, bz = ba.size();
+   int ofs = 0, bz = ba->size();
 
    /* Due to unknown reasons randomly first byte
     * of 'ba' is 0, this seems to happen only when
@@ -131,49 +211,137 @@ void DataLoader::parseSingleBuffer(const QByteArray &ba)
     * interface. Until we discover the real reason
     * workaround this skipping the bogus byte
     */
-   if (ba.at(0) == 0 && bz > 1 && !halfChunk)
+   if (ba->at(0) == 0 && bz > 1 && !halfChunk)
       ofs++;
 
-   while (bz - ofs > 0)
+   if (halfChunk)
+   { // less then 1% of cases with READ_BLOCK_SIZE = 64KB
+
+      int end = ba->indexOf('\0');
+      if (end == -1)
+      { // consecutives half chunks
+         baAppend(&halfChunk, ba->constData(), bz);
+         delete ba;
+         return;
+      }
+
+      ofs = end + 1;
+      baAppend(&halfChunk, ba->constData(), ofs);
+      dispatchRecords(halfChunk, 0, halfChunk->size());
+      halfChunk = nullptr;
+   }
+
+   // only whole records are handed to the workers, the
+   // trailing partial one waits for the next buffer
+   const auto recordsEnd = ba->lastIndexOf('\0') + 1;
+
+   if (bz - qMax(ofs, recordsEnd) > 0)
+      baAppend(&halfChunk, ba->constData() + qMax(ofs, recordsEnd), bz - qMax(ofs, recordsEnd));
+
+   if (recordsEnd > ofs)
+      dispatchRecords(ba, ofs, recordsEnd);
+   else
+      delete ba;
+}
+
+void DataLoader::dispatchRecords(QByteArray *buffer, int start, int end)
+{
+   const auto watcher = new QFutureWatcher<LogBatch>(this);
+   connect(watcher, &QFutureWatcherBase::finished, this, &DataLoader::commitParsedBatches);
+
+   mPendingBatches.enqueue(watcher);
+   watcher->setFuture(QtConcurrent::run(&DataLoader::parseRecords, buffer, start, end));
+}
+
+DataLoader::LogBatch DataLoader::parseRecords(QByteArray *buffer, int start, int end)
+{
+   // runs on a worker thread: it only touches the records in [start, end)
+   // of a buffer no one else is reading, the cache is left to the GUI thread
+   LogBatch batch;
+   batch.buffer = buffer;
+
+   // the records and their lines are found in one pass over the block
+   const auto records = RecordScanner::scan(*buffer, start, end);
+
+   // the authors are interned per batch, the GUI thread maps them once each
+   QHash<QByteArray, int> authorIds;
+
+   for (const auto &record : records)
    {
+      int next;
+      Revision revision(*buffer, record, -1, &next);
 
-      if (!halfChunk)
-      {
+      if (next < 0)
+         break;
+
+      // index all the fields now instead of lazily when first painted
+      revision.setup();
 
-         newOfs = mGit->addChunk(ba, ofs);
-         if (newOfs == -1)
-            break; // half chunk detected
+      const auto author = revision.authorNameData();
+      auto it = authorIds.constFind(author);
 
-         ofs = newOfs;
+      if (it == authorIds.constEnd())
+      {
+         it = authorIds.insert(author, batch.authors.count());
+         batch.authors.append(QString::fromLocal8Bit(author));
       }
-      else
-      { // less then 1% of cases with READ_BLOCK_SIZE = 64KB
 
-         int end = ba.indexOf('\0');
-         if (end == -1) // consecutives half chunks
-            break;
+      RevisionsCache::Columns columns;
+      columns.authorDate = revision.authorEpoch();
+      columns.authorId = it.value();
 
-         ofs = end + 1;
-         baAppend(&halfChunk, ba.constData(), ofs);
-         addSplittedChunks(halfChunk);
-         halfChunk = nullptr;
-      }
+      batch.revisions.append(revision);
+      batch.finalOutput.append(record.finalOutput);
+      batch.columns.append(columns);
    }
-   // save any remaining half chunk
-   if (bz - ofs > 0)
-      baAppend(&halfChunk, ba.constData() + ofs, bz - ofs);
+
+   return batch;
 }
 
-void DataLoader::addSplittedChunks(const QByteArray *hc)
+void DataLoader::commitParsedBatches()
 {
-
-   if (hc->at(hc->size() - 1) != 0)
+   if (canceling)
       return;
 
-   // do not assume we have only one chunk in hc
-   int ofs = 0;
-   while (ofs != -1 && ofs != (int)hc->size())
-      ofs = mGit->addChunk(*hc, ofs);
+   auto committed = false;
+
+   // batches are committed in the same order git produced them,
+   // so a batch parsed early waits for the ones before it
+   while (!mPendingBatches.isEmpty() && mPendingBatches.head()->isFinished())
+   {
+      const auto watcher = mPendingBatches.dequeue();
+      const auto batch = watcher->result();
+
+      QVector<int> authorIds;
+      authorIds.reserve(batch.authors.count());
+
+      for (const auto &author : batch.authors)
+         authorIds.append(mGit->mRevCache->internAuthor(author));
+
+      for (auto i = 0; i < batch.revisions.count(); ++i)
+      {
+         auto columns = batch.columns.at(i);
+         columns.authorId = authorIds.at(columns.authorId);
+         mGit->addRevision(batch.revisions.at(i), batch.finalOutput.at(i), columns);
+      }
+
+      mGit->mRevCache->adoptLogBuffer(batch.buffer);
+      watcher->deleteLater();
+      committed = true;
+   }
+
+   if (committed)
+   {
+      updateFirstRowTime();
+      emit newDataReady();
+   }
+
+   if (mLoadFinished && mPendingBatches.isEmpty())
+   {
+      const auto loadMode = mLoadMode == LoadMode::Pipe ? QString("pipe") : QString("file");
+      emit loaded(loadedBytes, loadTime.elapsed(), mFirstRowTime, true, loadMode);
+      deleteLater();
+   }
 }
 
 void DataLoader::baAppend(QByteArray **baPtr, const char *ascii, int len)
@@ -224,20 +392,51 @@ ulong DataLoader::readNewData(bool lastBuffer)
       dataFile->seek(readPos);
 
       cnt += len;
-      parseSingleBuffer(*ba);
+      parseSingleBuffer(ba);
 
       // avoid reading small chunks if data producer is still running
       if (len < READ_BLOCK_SIZE && !lastBuffer)
          break;
    }
    if (lastBuffer)
-   { // be sure stream is null terminated
-      QByteArray *zb = new QByteArray(1, '\0');
-      parseSingleBuffer(*zb);
+      parseLastBuffer();
+
+   return cnt;
+}
+
+ulong DataLoader::readPipeData()
+{
+   ulong cnt = 0;
+
+   while (bytesAvailable() > 0)
+   {
+      // read straight from the child's stdout, sizing the buffer to what is
+      // actually there so that small writes do not pin whole 64 KB blocks
+      const auto toRead = static_cast<int>(qMin<qint64>(bytesAvailable(), READ_BLOCK_SIZE));
+      QByteArray *ba = new QByteArray();
+      ba->resize(toRead);
+      int len = static_cast<int>(read(ba->data(), toRead));
+
+      if (len <= 0)
+      {
+         delete ba;
+         break;
+      }
+      else if (len < ba->size()) // unlikely
+         ba->resize(len);
+
+      cnt += len;
+      parseSingleBuffer(ba);
    }
    return cnt;
 }
 
+void DataLoader::parseLastBuffer()
+{
+   // be sure stream is null terminated
+   parseSingleBuffer(new QByteArray(1, '\0'));
+}
+
 bool DataLoader::createTemporaryFile()
 {
 
@@ -8,6 +8,7 @@ Copyright: See COPYING file that comes with this distribution
 #define DATALOADER_H
 
 #include <QProcess>
+#include <QQueue>
 #include <QTime>
 #include <QTimer>
 #include <QSharedPointer>
@@ -15,42 +16,70 @@ Copyright: See COPYING file that comes with this distribution
 class Git;
 class QString;
 class UnbufferedTemporaryFile;
+template<typename T>
+class QFutureWatcher;
 
-// data exchange facility with 'git log' could be based on QProcess or on
-// a temporary file (default). Uncomment following line to use QProcess
-// #define USE_QPROCESS
+// data exchange facility with 'git log' could be based on a temporary file or
+// on the stdout pipe of the child process (default). Uncomment following line
+// to read through a temporary file
+// #define USE_TEMPORARY_FILE
 
 class DataLoader : public QProcess
 {
    Q_OBJECT
 public:
-   DataLoader(Git *git);
+   enum class LoadMode
+   {
+      TemporaryFile,
+      Pipe
+   };
+
+#ifdef USE_TEMPORARY_FILE
+   static constexpr LoadMode kDefaultLoadMode = LoadMode::TemporaryFile;
+#else
+   static constexpr LoadMode kDefaultLoadMode = LoadMode::Pipe;
+#endif
+
+   explicit DataLoader(Git *git, LoadMode mode = kDefaultLoadMode);
    ~DataLoader();
    bool start(const QStringList &args, const QString &wd, const QString &buf);
    void on_cancel();
 
 signals:
    void newDataReady();
-   void loaded(ulong, int, bool, const QString &, const QString &);
+   void loaded(ulong byteSize, int loadTime, int firstRowTime, bool normalExit, const QString &loadMode);
 
 private slots:
    void on_finished(int, QProcess::ExitStatus);
    void on_timeout();
+   void on_readyRead();
+   void commitParsedBatches();
 
 private:
+   struct LogBatch;
+
    Git *mGit;
-   void parseSingleBuffer(const QByteArray &ba);
+   void parseSingleBuffer(QByteArray *ba);
+   void dispatchRecords(QByteArray *buffer, int start, int end);
+   static LogBatch parseRecords(QByteArray *buffer, int start, int end);
    void baAppend(QByteArray **src, const char *ascii, int len);
-   void addSplittedChunks(const QByteArray *halfChunk);
    bool createTemporaryFile();
    ulong readNewData(bool lastBuffer);
+   ulong readPipeData();
+   void parseLastBuffer();
+   void updateFirstRowTime();
    bool startProcess(QProcess *proc, QStringList args, const QString &buf = "");
 
    QByteArray *halfChunk;
+   QQueue<QFutureWatcher<LogBatch> *> mPendingBatches;
    UnbufferedTemporaryFile *dataFile;
    QTime loadTime;
    QTimer guiUpdateTimer;
+   LoadMode mLoadMode;
    ulong loadedBytes;
+   int mRowsAtStart;
+   int mFirstRowTime;
+   bool mLoadFinished;
    bool isProcExited;
    bool parsing;
    bool canceling;
@@ -9,6 +9,12 @@
 #include "git.h"
 
 #include <RevisionsCache.h>
+#include <LogCache.h>
+#include <CommitGraph.h>
+#include <FileListCache.h>
+#include <ChangedPathFilters.h>
+#include <Reachability.h>
+#include <BranchBitmaps.h>
 #include <Revision.h>
 #include <RevisionFile.h>
 #include <StateInfo.h>
@@ -19,29 +25,40 @@
 #include "lanes.h"
 #include "GitSyncProcess.h"
 #include "GitAsyncProcess.h"
+#include "GitCommandPool.h"
+#include "GitCatFileBatch.h"
+#include "DiffTreePrefetcher.h"
 #include "domain.h"
 
 #include <QApplication>
+#include <QDataStream>
 #include <QDir>
+#include <QElapsedTimer>
 #include <QFile>
 #include <QImageReader>
 #include <QPalette>
+#include <QProcess>
 #include <QRegExp>
+#include <QSet>
 #include <QSettings>
 #include <QTextCodec>
 #include <QTextDocument>
 #include <QTextStream>
+#include <QtConcurrent/QtConcurrentRun>
 
 #include <QLogger.h>
 
+#include <algorithm>
+#include <map>
+
 using namespace QLogger;
 
 static const QString GIT_LOG_FORMAT = "%m%HX%PX%n%cn<%ce>%n%an<%ae>%n%at%n%s%n";
 static const QString CUSTOM_SHA = "*** CUSTOM * CUSTOM * CUSTOM * CUSTOM **";
-static const uint C_MAGIC = 0xA0B0C0D0;
-static const int C_VERSION = 15;
-
-const QString Git::kCacheFileName = QString("qgit_cache.dat");
+static const int LANES_SYNC_ROWS = 2000; // max rows of lanes computed on request
+static const int REVS_PUBLISH_INTERVAL = 16; // ms, one frame
+static const int REVS_PUBLISH_ROWS = 100000; // publish anyway after these many revisions
+static const int PATH_FILTERS_SLICE_MS = 8; // time budget of each step building the path filters
 
 namespace
 {
@@ -57,6 +74,103 @@ const QString toPersistentSha(const QString &sha, QVector<QByteArray> &v)
 #   include <sys/stat.h> // used by chmod()
 #endif
 
+QVector<QString> nonEmptyLines(const GitExecResult &ret)
+{
+   QVector<QString> lines;
+
+   if (ret.success)
+   {
+      const auto linesTmp = ret.output.toString().split("\n");
+
+      for (auto line : linesTmp)
+         if (line != "\n" && !line.isEmpty())
+            lines.append(line);
+   }
+
+   return lines;
+}
+
+// 'Name<e-mail>' as in GIT_LOG_FORMAT out of an 'author' or 'committer' header
+QByteArray identity(const QByteArray &header, QByteArray *time = nullptr)
+{
+   const auto emailStart = header.indexOf('<');
+   const auto emailEnd = header.indexOf('>', emailStart);
+
+   if (emailStart == -1 || emailEnd == -1)
+      return header;
+
+   if (time)
+      *time = header.mid(emailEnd + 1).trimmed().split(' ').constFirst();
+
+   return header.left(emailStart).trimmed() + header.mid(emailStart, emailEnd - emailStart + 1);
+}
+
+// the commits changing a path, only among the candidates when the path filters gave them
+QStringList readFileHistory(const QString &workingDir, const QString &name, const QStringList &candidates,
+                            bool filtered)
+{
+   if (filtered && candidates.isEmpty())
+      return QStringList();
+
+   QStringList args { "log", "--format=%H" };
+
+   // the candidates come in stdin, in the order of the log, and are not walked
+   if (filtered)
+      args << "--no-walk=unsorted"
+           << "--stdin";
+   else
+      args << "--date-order";
+
+   args << "--" << name;
+
+   QProcess process;
+   process.setWorkingDirectory(workingDir);
+   process.start("git", args);
+
+   if (!process.waitForStarted())
+      return QStringList();
+
+   if (filtered)
+      process.write(candidates.join('\n').toLatin1().append('\n'));
+
+   process.closeWriteChannel();
+
+   if (!process.waitForFinished(-1) || process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0)
+      return QStringList();
+
+   return QString::fromLatin1(process.readAllStandardOutput()).split('\n', QString::SkipEmptyParts);
+}
+
+// the full record of a commit read with 'git cat-file', same as 'git log' would give
+void appendCommitRecord(QByteArray &buffer, const Revision &revision, const QByteArray &content)
+{
+   const auto headersEnd = content.indexOf("\n\n");
+   const auto headers = content.left(headersEnd == -1 ? content.size() : headersEnd).split('\n');
+   QByteArray committer("<>");
+   QByteArray author("<>");
+   QByteArray date;
+
+   for (const auto &header : headers)
+   {
+      if (header.startsWith("author "))
+         author = identity(header.mid(7), &date);
+      else if (header.startsWith("committer "))
+         committer = identity(header.mid(10));
+   }
+
+   auto message = headersEnd == -1 ? QByteArray() : content.mid(headersEnd + 2);
+
+   while (message.endsWith('\n'))
+      message.chop(1);
+
+   // parents are kept as loaded, grafts and replacements included
+   QVector<QByteArray> parents;
+   for (const auto &parent : revision.parents())
+      parents.append(parent.toLatin1());
+
+   CommitGraph::appendRecord(buffer, revision.sha().toLatin1(), parents, committer, author, date, message);
+}
+
 bool writeToFile(const QString &fileName, const QString &data, bool setExecutable = false)
 {
 
@@ -84,10 +198,45 @@ bool writeToFile(const QString &fileName, const QString &data, bool setExecutabl
 
 Git::Git()
    : QObject()
+   , mCommandPool(new GitCommandPool(GitCommandPool::kDefaultMaxRunning, this))
+   , mCatFile(new GitCatFileBatch(this))
+   , mFilesPrefetcher(new DiffTreePrefetcher(this))
 {
    mRevsFiles.reserve(RevisionsCache::MAX_DICT_SIZE);
+
+   connect(this, &Git::cancelAllProcesses, mCommandPool, &GitCommandPool::cancelAll);
+   connect(this, &Git::cancelAllProcesses, mFilesPrefetcher, &DiffTreePrefetcher::cancel);
+   connect(mFilesPrefetcher, &DiffTreePrefetcher::filesReady, this, &Git::onFilesPrefetched);
+
+   mPublishTimer.setSingleShot(true);
+   mPublishTimer.setInterval(REVS_PUBLISH_INTERVAL);
+   connect(&mPublishTimer, &QTimer::timeout, this, &Git::publishRevs);
+
+   mPartialTimer.setSingleShot(true);
+   mPartialTimer.setInterval(0);
+   connect(&mPartialTimer, &QTimer::timeout, this, &Git::completePartialRevisions);
+   connect(mCatFile, &GitCatFileBatch::objectsRead, this, &Git::onPartialObjectsRead);
+
+   mPathFiltersTimer.setSingleShot(true);
+   mPathFiltersTimer.setInterval(0);
+   connect(&mPathFiltersTimer, &QTimer::timeout, this, &Git::buildPathFilters);
+   connect(this, &Git::loadCompleted, this, [this]() {
+      mPathFiltersTimer.start();
+
+      // after every view got the completed load
+      if (mRefreshQueued)
+      {
+         mRefreshQueued = false;
+         QTimer::singleShot(0, this, &Git::refreshRequested);
+      }
+
+      if (mBranchBitmaps)
+         mBranchBitmaps->start();
+   });
 }
 
+Git::~Git() = default;
+
 void Git::userInfo(QStringList &info)
 {
    /*
@@ -229,9 +378,9 @@ const QString Git::getTagMsg(const QString &sha)
 
    if (!rf.tagObj.isEmpty())
    {
-      auto ro = run("git cat-file tag " + rf.tagObj);
-      if (ro.first)
-         rf.tagMsg = ro.second.section("\n\n", 1).remove(pgp).trimmed();
+      const auto tag = mCatFile->read(rf.tagObj);
+      if (tag.type == "tag")
+         rf.tagMsg = QString::fromUtf8(tag.content).section("\n\n", 1).remove(pgp).trimmed();
    }
    return rf.tagMsg;
 }
@@ -311,6 +460,11 @@ QPair<bool, QString> Git::run(const QString &runCmd) const
    return qMakePair(ret, runOutput);
 }
 
+QFuture<GitExecResult> Git::runTask(const QString &runCmd) const
+{
+   return mCommandPool->run(mWorkingDir, runCmd);
+}
+
 void Git::runAsync(const QString &runCmd, QObject *receiver, const QString &buf)
 {
    auto p = new GitAsyncProcess(mWorkingDir, receiver);
@@ -320,24 +474,32 @@ void Git::runAsync(const QString &runCmd, QObject *receiver, const QString &buf)
       delete p;
 }
 
-int Git::findFileIndex(const RevisionFile &rf, const QString &name)
+bool Git::findPathKey(const QString &name, quint64 &key) const
 {
-
    if (name.isEmpty())
-      return -1;
+      return false;
 
-   int idx = name.lastIndexOf('/') + 1;
-   const QString &dr = name.left(idx);
-   const QString &nm = name.mid(idx);
+   const auto idx = name.lastIndexOf('/') + 1;
+   const auto dir = mDirNamesMap.constFind(name.left(idx));
 
-   for (int i = 0, cnt = rf.count(); i < cnt; ++i)
-   {
-      const auto isRevFile = mFileNames[rf.nameAt(i)];
-      const auto isRevDir = mDirNames[rf.dirAt(i)];
-      if (isRevFile == nm && isRevDir == dr)
-         return i;
-   }
-   return -1;
+   if (dir == mDirNamesMap.constEnd())
+      return false;
+
+   const auto file = mFileNamesMap.constFind(name.mid(idx));
+
+   if (file == mFileNamesMap.constEnd())
+      return false;
+
+   key = RevisionFile::pathKey(*dir, *file);
+
+   return true;
+}
+
+int Git::findFileIndex(const RevisionFile &rf, const QString &name)
+{
+   // a name never interned is in no revision
+   quint64 key;
+   return findPathKey(name, key) ? rf.indexOf(key) : -1;
 }
 
 const QString Git::getLaneParent(const QString &fromSHA, int laneNum)
@@ -350,14 +512,14 @@ const QString Git::getLaneParent(const QString &fromSHA, int laneNum)
    for (int idx = rs->orderIdx - 1; idx >= 0; idx--)
    {
 
-      const auto r = mRevCache->revLookup(mRevCache->createRevisionSha(idx));
-      if (laneNum >= r->lanes.count())
+      const auto r = mRevCache->revLookup(idx);
+      if (laneNum >= mRevCache->lanesCount(idx))
          return "";
 
-      if (!isFreeLane(static_cast<LaneType>(r->lanes[laneNum])))
+      if (!isFreeLane(mRevCache->lane(idx, laneNum)))
       {
 
-         auto type = r->lanes[laneNum];
+         auto type = mRevCache->lane(idx, laneNum);
          auto parNum = 0;
          while (!isMerge(type) && type != LaneType::ACTIVE)
          {
@@ -365,7 +527,7 @@ const QString Git::getLaneParent(const QString &fromSHA, int laneNum)
             if (isHead(static_cast<LaneType>(type)))
                parNum++;
 
-            type = r->lanes[--laneNum];
+            type = mRevCache->lane(idx, --laneNum);
          }
          return r->parent(parNum);
       }
@@ -375,29 +537,48 @@ const QString Git::getLaneParent(const QString &fromSHA, int laneNum)
 
 const QStringList Git::getChildren(const QString &parent)
 {
+   if (!mReachability || !mRevCache->revLookup(parent))
+      return QStringList();
 
-   QStringList children;
-   const Revision *r = mRevCache->revLookup(parent);
-   if (!r)
-      return children;
-
-   for (int i = 0; i < r->children.count(); i++)
-      children.append(mRevCache->createRevisionSha(r->children[i]));
+   auto children = mReachability->children(parent);
 
    // reorder children by loading order
-   QStringList::iterator itC(children.begin());
-   for (; itC != children.end(); ++itC)
-   {
-      const Revision *r = mRevCache->revLookup(*itC);
-      (*itC).prepend(QString("%1 ").arg(r->orderIdx, 6));
-   }
-   children.sort();
-   for (itC = children.begin(); itC != children.end(); ++itC)
-      (*itC) = (*itC).section(' ', -1, -1);
+   std::sort(children.begin(), children.end(), [this](const QString &left, const QString &right) {
+      return mRevCache->row(left) < mRevCache->row(right);
+   });
 
    return children;
 }
 
+bool Git::getBranchesContaining(const QString &sha, QStringList &branches) const
+{
+   branches.clear();
+
+   const auto row = mRevCache->row(sha);
+   QVector<BranchBitmaps::Branch> containing;
+
+   if (row == -1 || !mBranchBitmaps || !mBranchBitmaps->branchesContaining(row, containing))
+      return false;
+
+   for (const auto &branch : qAsConst(containing))
+      branches.append(branch.name);
+
+   return true;
+}
+
+bool Git::getNearestTags(const QString &sha, bool descendants, QStringList &tags) const
+{
+   tags.clear();
+
+   // a query never waits for the index to be built
+   if (!mReachability || !mReachability->isBuilt())
+      return false;
+
+   tags = descendants ? mReachability->nearestDescendantTags(sha) : mReachability->nearestAncestorTags(sha);
+
+   return true;
+}
+
 void Git::getDiff(const QString &sha, QObject *receiver, const QString &diffToSha, bool combined)
 {
    if (!sha.isEmpty())
@@ -463,7 +644,7 @@ bool Git::isNothingToCommit()
       return true;
 
    const RevisionFile *rf = mRevsFiles[ZERO_SHA];
-   return rf->count() == workingDirInfo.otherFiles.count();
+   return rf->count() == mWipStatus.untracked().count();
 }
 
 bool Git::resetFile(const QString &fileName)
@@ -478,8 +659,12 @@ QPair<QString, QString> Git::getSplitCommitMsg(const QString &sha)
 {
    const Revision *c = mRevCache->revLookup(sha);
 
-   if (!c)
-      return qMakePair(QString(), QString());
+   if (!c || c->isPartial())
+   {
+      // not loaded, as for commits out of the current history
+      const auto message = readCommitMsg(sha);
+      return qMakePair(message.section('\n', 0, 0), message.section('\n', 1).trimmed());
+   }
 
    return qMakePair(c->shortLog(), c->longLog().trimmed());
 }
@@ -487,12 +672,23 @@ QPair<QString, QString> Git::getSplitCommitMsg(const QString &sha)
 QString Git::getCommitMsg(const QString &sha) const
 {
    const Revision *c = mRevCache->revLookup(sha);
-   if (!c)
-      return "";
+   if (!c || c->isPartial())
+      return readCommitMsg(sha);
 
    return c->shortLog() + "\n\n" + c->longLog().trimmed();
 }
 
+QString Git::readCommitMsg(const QString &sha) const
+{
+   const auto commit = mCatFile->read(sha);
+
+   if (commit.type != "commit")
+      return QString();
+
+   // the message follows the headers after the first empty line
+   return QString::fromUtf8(commit.content).section("\n\n", 1).trimmed();
+}
+
 const QString Git::getLastCommitMsg()
 {
    // FIXME: Make sure the amend action is not called when there is
@@ -539,19 +735,17 @@ const QString Git::getNewCommitMsg()
    return status;
 }
 
-QVector<QString> Git::getSubmodules()
+QFuture<QVector<QString>> Git::getSubmodules() const
 {
-   QVector<QString> submodulesList;
-   const auto ret = run("git config --file .gitmodules --name-only --get-regexp path");
-   if (ret.first)
-   {
-      const auto submodules = ret.second.split('\n');
-      for (auto submodule : submodules)
-         if (!submodule.isEmpty() && submodule != "\n")
-            submodulesList.append(submodule.split('.').at(1));
-   }
+   return mCommandPool->run<QVector<QString>>(
+       mWorkingDir, "git config --file .gitmodules --name-only --get-regexp path", [](const GitExecResult &ret) {
+          QVector<QString> submodulesList;
 
-   return submodulesList;
+          for (const auto &submodule : nonEmptyLines(ret))
+             submodulesList.append(submodule.split('.').at(1));
+
+          return submodulesList;
+       });
 }
 
 bool Git::submoduleAdd(const QString &url, const QString &name)
@@ -640,7 +834,10 @@ const RevisionFile *Git::getFiles(const QString &sha, const QString &diffToSha,
    if (r->parentsCount() > 1 && diffToSha.isEmpty() && allFiles)
       return getAllMergeFiles(r);
 
-   if (!diffToSha.isEmpty() && (sha != ZERO_SHA))
+   // against its only parent a commit shows its own changes, that are cached
+   const auto ownChanges = r->parentsCount() == 1 && diffToSha == r->parent(0) && path.isEmpty();
+
+   if (!diffToSha.isEmpty() && (sha != ZERO_SHA) && !ownChanges)
    {
 
       QString runCmd("git diff-tree --no-color -r -m ");
@@ -662,6 +859,14 @@ const RevisionFile *Git::getFiles(const QString &sha, const QString &diffToSha,
    if (sha == ZERO_SHA)
       return nullptr;
 
+   // computed in a previous session
+   if (const auto cached = loadCachedFiles(sha))
+      return cached;
+
+   // already asked to the prefetcher, waiting is faster than asking again
+   if (mFilesPrefetcher->isInFlight(sha) && mFilesPrefetcher->waitFor(sha) && mRevsFiles.contains(sha))
+      return mRevsFiles[sha];
+
    QString runCmd("git diff-tree --no-color -r -c " + sha), runOutput;
    if (!runDiffTreeWithRenameDetection(runCmd, &runOutput))
       return nullptr;
@@ -670,7 +875,156 @@ const RevisionFile *Git::getFiles(const QString &sha, const QString &diffToSha,
       return mRevsFiles[r->sha()];
 
    mCacheNeedsUpdate = true;
-   return insertNewFiles(sha, runOutput);
+
+   const auto rf = insertNewFiles(sha, runOutput);
+   addPathFilter(sha, *rf);
+
+   return rf;
+}
+
+void Git::prefetchFiles(const QStringList &shas)
+{
+   QStringList missing;
+
+   for (const auto &sha : shas)
+   {
+      if (sha == ZERO_SHA || mRevsFiles.contains(sha) || (mFileListCache && mFileListCache->contains(sha)))
+         continue;
+
+      const auto r = mRevCache->revLookup(sha);
+
+      if (r && r->parentsCount() > 0)
+         missing.append(sha);
+   }
+
+   mFilesPrefetcher->prefetch(missing);
+}
+
+void Git::onFilesPrefetched(const QString &sha, const QString &diff)
+{
+   // a refresh may have dropped the commit meanwhile
+   if (mRevsFiles.contains(sha) || !mRevCache->revLookup(sha))
+      return;
+
+   mCacheNeedsUpdate = true;
+   addPathFilter(sha, *insertNewFiles(sha, diff));
+}
+
+void Git::addPathFilter(const QString &sha, const RevisionFile &rf)
+{
+   // merges list only the files differing from every parent
+   const auto r = mRevCache->revLookup(sha);
+
+   if (!mPathFilters || !r || r->parentsCount() != 1 || mPathFilters->contains(sha))
+      return;
+
+   QStringList paths;
+
+   for (auto i = 0; i < rf.count(); ++i)
+      paths.append(filePath(rf, i));
+
+   mPathFilters->insert(sha, paths);
+}
+
+void Git::buildPathFilters()
+{
+   if (!mPathFilters)
+      return;
+
+   // from the file lists already known, in memory or in the file list cache
+   QElapsedTimer elapsed;
+   elapsed.start();
+
+   // the rows a refresh inserted above the ones already visited
+   while (!mPathFiltersPending.isEmpty() && elapsed.elapsed() < PATH_FILTERS_SLICE_MS)
+      loadPathFilter(mRevCache->revLookup(mPathFiltersPending.takeLast()));
+
+   while (mPathFiltersRow < mRevCache->count() && elapsed.elapsed() < PATH_FILTERS_SLICE_MS)
+      loadPathFilter(mRevCache->revLookup(mPathFiltersRow++));
+
+   if (!mPathFiltersPending.isEmpty() || mPathFiltersRow < mRevCache->count())
+      mPathFiltersTimer.start();
+   else
+      QLog_Debug("Git", QString("Path filters for %1 commits").arg(mPathFilters->count()));
+}
+
+void Git::loadPathFilter(const Revision *r)
+{
+   if (!r || r->parentsCount() != 1)
+      return;
+
+   const auto sha = r->sha();
+
+   if (sha == ZERO_SHA || mPathFilters->contains(sha))
+      return;
+
+   if (const auto rf = mRevsFiles.value(sha))
+      addPathFilter(sha, *rf);
+   else if (mFileListCache)
+   {
+      const auto record = mFileListCache->record(sha);
+
+      if (!record.isEmpty())
+         mPathFilters->insert(sha, decodeFileListPaths(record));
+   }
+}
+
+void Git::resetPathFilters()
+{
+   // the filters built so far are kept, only the rows to visit start again
+   mPathFiltersTimer.stop();
+   mPathFiltersRow = 0;
+   mPathFiltersPending.clear();
+}
+
+QFuture<QStringList> Git::getFileHistory(const QString &path)
+{
+   auto name = path;
+
+   while (name.endsWith('/'))
+      name.chop(1);
+
+   // the false positives of the filters are dropped by git, on the candidates only
+   QStringList candidates;
+   const auto filtered = name.isEmpty() || (mPathFilters && filterFileHistory(name, candidates));
+
+   return QtConcurrent::run(&readFileHistory, mWorkingDir, name, candidates, filtered);
+}
+
+bool Git::filterFileHistory(const QString &name, QStringList &candidates) const
+{
+   const auto keys = ChangedPathFilters::keys(name);
+
+   for (auto row = 0; row < mRevCache->count(); ++row)
+   {
+      const auto r = mRevCache->revLookup(row);
+
+      // merges follow 'git log', they are left out unless they change something on their own
+      if (!r || r->sha() == ZERO_SHA || r->parentsCount() > 1)
+         continue;
+
+      // the initial commits add everything they have
+      if (r->parentsCount() == 0)
+      {
+         candidates.append(r->sha());
+         continue;
+      }
+
+      switch (mPathFilters->test(r->sha(), keys))
+      {
+         case ChangedPathFilters::Match::NO:
+            break;
+         case ChangedPathFilters::Match::MAYBE:
+            candidates.append(r->sha());
+            break;
+         case ChangedPathFilters::Match::UNKNOWN:
+            // too little of the history is covered by the filters, git walks it all
+            candidates.clear();
+            return false;
+      }
+   }
+
+   return true;
 }
 
 bool Git::resetCommits(int parentDepth)
@@ -727,12 +1081,19 @@ const QStringList Git::getOtherFiles(const QStringList &selFiles)
 {
 
    const RevisionFile *files = getFiles(ZERO_SHA); // files != nullptr
+
+   QSet<quint64> selected;
+   quint64 key;
+
+   for (const auto &file : selFiles)
+      if (findPathKey(file, key))
+         selected.insert(key);
+
    QStringList notSelFiles;
    for (auto i = 0; i < files->count(); ++i)
    {
-      const QString &fp = filePath(*files, i);
-      if (selFiles.indexOf(fp) == -1 && files->statusCmp(i, RevisionFile::IN_INDEX))
-         notSelFiles.append(fp);
+      if (files->statusCmp(i, RevisionFile::IN_INDEX) && !selected.contains(files->pathKeyAt(i)))
+         notSelFiles.append(filePath(*files, i));
    }
    return notSelFiles;
 }
@@ -889,24 +1250,91 @@ GitExecResult Git::removeRemoteBranch(const QString &branchName)
    return run(QString("git push --delete origin %1").arg(branchName));
 }
 
-GitExecResult Git::getBranches()
+QFuture<GitExecResult> Git::getBranches() const
 {
-   return run(QString("git branch -a"));
+   return runTask(QString("git branch -a"));
 }
 
-GitExecResult Git::getDistanceBetweenBranches(bool toMaster, const QString &right)
+bool Git::getDistanceBetweenCommits(const QString &leftSha, const QString &rightSha, int &leftOnly,
+                                    int &rightOnly) const
 {
-   const QString firstArg = toMaster ? QString::fromUtf8("--left-right") : QString::fromUtf8("");
-   const QString gitCmd = QString("git rev-list %1 --count %2...%3")
-                              .arg(firstArg)
-                              .arg(toMaster ? QString::fromUtf8("origin/master") : QString::fromUtf8("origin/%3"))
-                              .arg(right);
+   // same as 'git rev-list --left-right --count left...right' but walking the
+   // loaded graph. Rows are in date order, so parents always come after their
+   // children: visiting the pending rows by increasing index, the flags of a
+   // row are final when it is reached and once all of them are reachable
+   // from both sides nothing below can be reachable from one side only.
+   const auto leftRow = mRevCache->row(leftSha);
+   const auto rightRow = mRevCache->row(rightSha);
+
+   if (leftRow == -1 || rightRow == -1)
+      return false;
+
+   enum : uchar
+   {
+      LEFT = 1,
+      RIGHT = 2,
+      BOTH = LEFT | RIGHT
+   };
+
+   std::map<int, uchar> pending;
+   pending[leftRow] |= LEFT;
+   pending[rightRow] |= RIGHT;
+
+   auto uncommon = leftRow == rightRow ? 0 : 2;
+   leftOnly = rightOnly = 0;
 
-   return run(gitCmd);
+   while (uncommon > 0 && !pending.empty())
+   {
+      const auto row = pending.begin()->first;
+      const auto flags = pending.begin()->second;
+      pending.erase(pending.begin());
+
+      if (flags == LEFT)
+         ++leftOnly;
+      else if (flags == RIGHT)
+         ++rightOnly;
+
+      if (flags != BOTH)
+         --uncommon;
+
+      for (const auto &parent : mRevCache->revLookup(row)->parents())
+      {
+         const auto parentRow = mRevCache->row(parent);
+
+         // boundary parents are not loaded
+         if (parentRow == -1)
+            continue;
+
+         auto &parentFlags = pending[parentRow];
+         const auto wasUncommon = parentFlags != 0 && parentFlags != BOTH;
+         parentFlags |= flags;
+
+         if (!wasUncommon && parentFlags != BOTH)
+            ++uncommon;
+         else if (wasUncommon && parentFlags == BOTH)
+            --uncommon;
+      }
+   }
+
+   return true;
 }
 
 GitExecResult Git::getBranchesOfCommit(const QString &sha)
 {
+   const auto row = mRevCache->row(sha);
+   QVector<BranchBitmaps::Branch> containing;
+
+   // same output as git, remote branches get their refs/ prefix stripped
+   if (row != -1 && mBranchBitmaps && mBranchBitmaps->branchesContaining(row, containing))
+   {
+      QString output;
+
+      for (const auto &branch : qAsConst(containing))
+         output.append(QString("  %1%2\n").arg(branch.remote ? QString("remotes/") : QString(), branch.name));
+
+      return qMakePair(true, output);
+   }
+
    return run(QString("git branch --contains %1 --all").arg(sha));
 }
 
@@ -925,40 +1353,22 @@ GitExecResult Git::prune()
    return run("git remote prune origin");
 }
 
-QVector<QString> Git::getTags() const
+QFuture<QVector<QString>> Git::getTags() const
 {
-   const auto ret = run("git tag");
-
-   QVector<QString> tags;
-
-   if (ret.first)
-   {
-      const auto tagsTmp = ret.second.split("\n");
-
-      for (auto tag : tagsTmp)
-         if (tag != "\n" && !tag.isEmpty())
-            tags.append(tag);
-   }
-
-   return tags;
+   return mCommandPool->run<QVector<QString>>(mWorkingDir, "git tag", nonEmptyLines);
 }
 
-QVector<QString> Git::getLocalTags() const
+QFuture<QVector<QString>> Git::getLocalTags() const
 {
-   const auto ret = run("git push --tags --dry-run");
-
-   QVector<QString> tags;
-
-   if (ret.first)
-   {
-      const auto tagsTmp = ret.second.split("\n");
+   return mCommandPool->run<QVector<QString>>(mWorkingDir, "git push --tags --dry-run", [](const GitExecResult &ret) {
+      QVector<QString> tags;
 
-      for (auto tag : tagsTmp)
-         if (tag != "\n" && !tag.isEmpty() && tag.contains("[new tag]"))
+      for (const auto &tag : nonEmptyLines(ret))
+         if (tag.contains("[new tag]"))
             tags.append(tag.split(" -> ").last());
-   }
 
-   return tags;
+      return tags;
+   });
 }
 
 bool Git::addTag(const QString &tagName, const QString &tagMessage, const QString &sha, QByteArray &output)
@@ -992,44 +1402,23 @@ bool Git::pushTag(const QString &tagName, QByteArray &output)
 
 bool Git::getTagCommit(const QString &tagName, QByteArray &output)
 {
-   const auto ret = run(QString("git rev-list -n 1 %1").arg(tagName));
-   output = ret.second.toUtf8();
+   const auto commit = mCatFile->read(QString("%1^{commit}").arg(tagName));
+   output = commit.sha.toUtf8();
 
-   if (ret.first)
-   {
-      output.remove(output.count() - 2, output.count() - 1);
-   }
-
-   return ret.first;
+   return commit.isValid();
 }
 
-QVector<QString> Git::getStashes()
+QFuture<QVector<QString>> Git::getStashes() const
 {
-   const auto ret = run("git stash list");
-
-   QVector<QString> stashes;
-
-   if (ret.first)
-   {
-      const auto tagsTmp = ret.second.split("\n");
-
-      for (auto tag : tagsTmp)
-         if (tag != "\n" && !tag.isEmpty())
-            stashes.append(tag);
-   }
-
-   return stashes;
+   return mCommandPool->run<QVector<QString>>(mWorkingDir, "git stash list", nonEmptyLines);
 }
 
 bool Git::getStashCommit(const QString &stash, QByteArray &output)
 {
-   const auto ret = run(QString("git rev-list %1 -n 1 ").arg(stash));
-   output = ret.second.toUtf8();
-
-   if (ret.first)
-      output.remove(output.count() - 2, output.count() - 1);
+   const auto commit = mCatFile->read(QString("%1^{commit}").arg(stash));
+   output = commit.sha.toUtf8();
 
-   return ret.first;
+   return commit.isValid();
 }
 
 bool Git::getGitDBDir(const QString &wd, QString &gd, bool &changed)
@@ -1194,27 +1583,33 @@ bool Git::getRefs()
    Reference *cur = lookupOrAddReference(toPersistentSha(curBranchSHA, mShaBackupBuf));
    cur->type |= CUR_BRANCH;
 
-   return !mRefsShaMap.empty();
-}
+   QVector<BranchBitmaps::Branch> branches;
+   QVector<Reachability::Ref> tags;
 
-const QStringList Git::getOthersFiles()
-{
-   // add files present in working directory but not in git archive
+   for (auto it = mRefsShaMap.constBegin(); it != mRefsShaMap.constEnd(); ++it)
+   {
+      for (const auto &branch : it.value().branches)
+         branches.append({ branch, it.key(), false });
 
-   QString runCmd("git ls-files --others");
-   QString exFile(".git/info/exclude");
-   QString path = QString("%1/%2").arg(mWorkingDir, exFile);
+      for (const auto &branch : it.value().remoteBranches)
+         branches.append({ branch, it.key(), true });
 
-   if (QFile::exists(path))
-      runCmd.append(" --exclude-from=" + quote(exFile));
+      for (const auto &tag : it.value().tags)
+         tags.append(qMakePair(tag, it.key()));
+   }
+
+   if (mBranchBitmaps)
+      mBranchBitmaps->setBranches(branches);
 
-   runCmd.append(" --exclude-per-directory=" + quote(".gitignore"));
+   if (mReachability)
+      mReachability->setTags(tags);
 
-   const auto runOutput = run(runCmd).second;
-   return runOutput.split('\n', QString::SkipEmptyParts);
+   ++mRefsGeneration;
+
+   return !mRefsShaMap.empty();
 }
 
-Revision *Git::fakeRevData(const QString &sha, const QStringList &parents, const QString &author, const QString &date,
+Revision Git::fakeRevData(const QString &sha, const QStringList &parents, const QString &author, const QString &date,
                            const QString &log, const QString &longLog, const QString &patch, int idx)
 {
 
@@ -1235,97 +1630,134 @@ Revision *Git::fakeRevData(const QString &sha, const QStringList &parents, const
 #endif
    ba->append('\0');
 
+   mRevCache->adoptLogBuffer(ba);
+
    int dummy;
-   Revision *c = new Revision(*ba, 0, idx, &dummy);
-   return c;
+   return Revision(*ba, 0, idx, &dummy);
 }
 
-const Revision *Git::fakeWorkDirRev(const QString &parent, const QString &log, const QString &longLog, int idx)
+Revision Git::fakeWorkDirRev(const QString &parent, const QString &log, const QString &longLog, int idx)
 {
 
    QString patch;
    QString date(QString::number(QDateTime::currentDateTime().toSecsSinceEpoch()));
    QString author("-");
    QStringList parents(parent);
-   Revision *c = fakeRevData(ZERO_SHA, parents, author, date, log, longLog, patch, idx);
-   c->isDiffCache = true;
-   c->lanes.append(LaneType::EMPTY);
+   auto c = fakeRevData(ZERO_SHA, parents, author, date, log, longLog, patch, idx);
+   c.isDiffCache = true;
    return c;
 }
 
-const RevisionFile *Git::fakeWorkDirRevFile(const WorkingDirInfo &wd)
+const RevisionFile *Git::fakeWorkDirRevFile(const WipStatus &wip)
 {
-
    FileNamesLoader fl;
    RevisionFile *rf = new RevisionFile();
-   parseDiffFormat(*rf, wd.diffIndex, fl);
    rf->onlyModified = false;
 
-   for (auto it : wd.otherFiles)
+   // same as 'git diff-index HEAD', staged or not, with
+   // the files already staged marked as in the index
+   for (const auto &change : wip.changes())
    {
+      if (change.index == 'R')
+      {
+         appendFileName(*rf, change.origPath, fl);
+         rf->status.append(RevisionFile::DELETED | RevisionFile::IN_INDEX);
+         rf->mergeParent.append(1);
+      }
 
-      appendFileName(*rf, it, fl);
-      rf->status.append(RevisionFile::UNKNOWN);
+      // renames and copies are not detected by diff-index
+      auto status = change.isStaged() ? change.index : change.workTree;
+
+      if (status == 'R' || status == 'C')
+         status = 'A';
+
+      appendFileName(*rf, change.path, fl);
+      setStatus(*rf, QString(QChar::fromLatin1(status)));
+      rf->mergeParent.append(1);
+
+      if (change.isStaged())
+         rf->status.last() |= RevisionFile::IN_INDEX;
+   }
+
+   for (const auto &file : wip.untracked())
+   {
+      appendFileName(*rf, file, fl);
+      rf->status.append(RevisionFile::UNKNOWN);
       rf->mergeParent.append(1);
    }
-   RevisionFile cachedFiles;
-   parseDiffFormat(cachedFiles, wd.diffIndexCached, fl);
+
    flushFileNames(fl);
 
-   for (auto i = 0; i < rf->count(); i++)
-      if (findFileIndex(cachedFiles, filePath(*rf, i)) != -1)
-         rf->status[i] |= RevisionFile::IN_INDEX;
    return rf;
 }
 
 void Git::updateWipRevision()
 {
+   // a pending asynchronous update would be older than this one
+   ++mWipRequest;
 
-   const auto ret = run("git status");
-   if (!ret.first) // git status refreshes the index, run as first
-      return;
+   const auto status = WipStatus::read(mWorkingDir);
 
-   QString status = ret.second;
-
-   const auto ret2 = run("git rev-parse --revs-only HEAD");
-   if (!ret2.first)
+   if (!status.isValid())
+   {
+      QLog_Warning("Git", "Unable to read the status of the working directory");
       return;
+   }
 
-   QString head = ret2.second;
+   mWipStatus = status;
+   applyWipRevision();
+}
 
-   head = head.trimmed();
-   if (!head.isEmpty())
-   { // repository initialized but still no history
+void Git::updateWipRevisionAsync()
+{
+   // same as updateWipRevision() but git runs and its output
+   // is parsed in a worker thread, only the newest result is kept
+   const auto request = ++mWipRequest;
 
-      const auto ret3 = run("git diff-index " + head);
+   GitCommandPool::then(WipStatus::readAsync(mWorkingDir), this, [this, request](const WipStatus &status) {
+      if (request != mWipRequest)
+         return;
 
-      if (!ret3.first)
+      if (!status.isValid())
+      {
+         QLog_Warning("Git", "Unable to read the status of the working directory");
          return;
+      }
 
-      workingDirInfo.diffIndex = ret3.second;
+      mWipStatus = status;
+      applyWipRevision();
 
-      // check for files already updated in cache, we will
-      // save this information in status third field
-      const auto ret4 = run("git diff-index --cached " + head);
-      if (!ret4.first)
-         return;
+      emit wipRevisionUpdated();
+   });
+}
 
-      workingDirInfo.diffIndexCached = ret4.second;
-   }
-   // get any file not in tree
-   workingDirInfo.otherFiles = getOthersFiles();
+void Git::applyWipRevision()
+{
+   const auto head = mWipStatus.head();
+   const auto status = mWipStatus.summary();
 
    // now mockup a RevisionFile
-   mRevsFiles.insert(ZERO_SHA, fakeWorkDirRevFile(workingDirInfo));
+   mRevsFiles.insert(ZERO_SHA, fakeWorkDirRevFile(mWipStatus));
 
    // then mockup the corresponding Revision
    const QString &log = (isNothingToCommit() ? QString("No local changes") : QString("Local changes"));
-   const Revision *r = fakeWorkDirRev(head, log, status, mRevCache->revOrderCount());
-   mRevCache->insertRevision(ZERO_SHA, *r);
+   const auto wipRow = mRevCache->row(ZERO_SHA);
+
+   if (wipRow != -1)
+   {
+      // already there, the row is kept and only its content changes
+      mRevCache->updateRevision(wipRow, fakeWorkDirRev(head, log, status, wipRow));
+      mRevData->revisionUpdated(wipRow);
+      return;
+   }
+
+   const auto r = fakeWorkDirRev(head, log, status, mRevCache->revOrderCount());
+   mRevCache->insertRevision(ZERO_SHA, r);
+   mRevCache->setLanes(r.orderIdx, { LaneType::EMPTY });
    mRevData->earlyOutputCntBase = mRevCache->revOrderCount();
 
    // finally send it to GUI
-   emit newRevsAdded();
+   publishRevs();
 }
 
 void Git::parseDiffFormatLine(RevisionFile &rf, const QString &line, int parNum, FileNamesLoader &fl)
@@ -1450,37 +1882,429 @@ void Git::parseDiffFormat(RevisionFile &rf, const QString &buf, FileNamesLoader
    }
 }
 
-bool Git::startParseProc(const QStringList &initCmd)
+bool Git::startParseProc(const QStringList &initCmd, const QString &buf)
 {
    DataLoader *dl = new DataLoader(this); // auto-deleted when done
    connect(this, &Git::cancelLoading, dl, &DataLoader::on_cancel);
-   connect(dl, &DataLoader::newDataReady, this, &Git::newRevsAdded);
+   connect(dl, &DataLoader::newDataReady, this, &Git::scheduleRevsPublish);
    connect(dl, &DataLoader::loaded, this, &Git::on_loaded);
 
-   QString buf;
    return dl->start(initCmd, mWorkingDir, buf);
 }
 
-bool Git::startRevList()
+QString Git::logCommand() const
 {
-
    QString baseCmd("git log --date-order --no-color "
 
 #ifndef Q_OS_WIN32
                    "--log-size " // FIXME broken on Windows
 #endif
-                   "--parents --boundary -z "
+                   "--parents -z "
                    "--pretty=format:"
                    + GIT_LOG_FORMAT);
 
    // we don't need log message body for file history
-   baseCmd.append("%b --all");
+   baseCmd.append("%b");
 
-   QStringList initCmd(baseCmd.split(' '));
+   return baseCmd;
+}
+
+bool Git::startRevList()
+{
+   mLogCacheDirty = true;
+
+   QStringList initCmd(QString(logCommand() + " --boundary --all").split(' '));
 
    return startParseProc(initCmd);
 }
 
+QStringList Git::refTips() const
+{
+   QStringList tips;
+
+   for (auto it = mRefsShaMap.constBegin(); it != mRefsShaMap.constEnd(); ++it)
+      if (it.key().length() == 40)
+         tips.append(it.key());
+
+   tips.sort();
+   return tips;
+}
+
+bool Git::startCachedRevList()
+{
+   mLogCache.reset(new LogCache(mGitDir));
+
+   if (!mLogCache->load())
+   {
+      mLogCache.reset();
+      return false;
+   }
+
+   const auto cachedTips = mLogCache->tips();
+   QStringList added;
+
+   if (!diffTips(cachedTips, added))
+   {
+      QLog_Info("Git", "Log cache is outdated, loading the whole history");
+      mLogCache.reset();
+      return false;
+   }
+
+   if (added.isEmpty())
+   {
+      mLogCacheDirty = false;
+      on_loaded(static_cast<ulong>(mLogCache->size()), 0, 0, true, "cache");
+      return true;
+   }
+
+   // ask git only for the new commits, the cached ones are
+   // appended when the delta is loaded, see on_loaded()
+   mLogCacheDirty = true;
+
+   if (!startDeltaRevList(added, cachedTips))
+   {
+      mLogCache.reset();
+      return false;
+   }
+
+   return true;
+}
+
+bool Git::diffTips(const QStringList &oldTips, QStringList &added) const
+{
+   const auto oldSet = oldTips.toSet();
+   const auto tipsSet = refTips().toSet();
+   const auto removed = (oldSet - tipsSet).toList();
+
+   if (!removed.isEmpty())
+   {
+      // every known commit has to be still reachable from the current
+      // refs, it's not the case after a rebase or a deleted branch
+      const auto ret = run(QString("git rev-list --count %1 --not --all").arg(removed.join(' ')));
+
+      if (!ret.first || ret.second.trimmed() != "0")
+         return false;
+   }
+
+   added = (tipsSet - oldSet).toList();
+
+   return true;
+}
+
+bool Git::startDeltaRevList(const QStringList &tips, const QStringList &knownTips)
+{
+   // revisions are passed through stdin, there could be a lot of them
+   QString buf;
+   for (const auto &tip : tips)
+      buf.append(tip + '\n');
+   for (const auto &tip : knownTips)
+      buf.append('^' + tip + '\n');
+
+   QStringList initCmd(QString(logCommand() + " --stdin").split(' '));
+
+   return startParseProc(initCmd, buf);
+}
+
+Git::RefreshResult Git::refreshRevs()
+{
+   if (!mRevData)
+      return RefreshResult::RELOAD;
+
+   // only a fully loaded history can be updated in place, the refs that
+   // change meanwhile are read once the running load completes
+   if (!mRevsLoaded || mIsRefreshing)
+   {
+      mRefreshQueued = true;
+      return RefreshResult::QUEUED;
+   }
+
+   const auto oldTips = refTips();
+
+   if (!getRefs())
+      return RefreshResult::RELOAD;
+
+   QStringList added;
+
+   if (!diffTips(oldTips, added))
+   {
+      QLog_Info("Git", "History was rewritten, loading it again");
+      return RefreshResult::RELOAD;
+   }
+
+   // the working dir row already exists, it is updated in place when ready
+   updateWipRevisionAsync();
+
+   if (added.isEmpty())
+   {
+      // only refs were changed, the new badges are drawn on next update
+      emit loadCompleted(QString("Refs updated"));
+      return RefreshResult::REFRESHED;
+   }
+
+   QLog_Info("Git", QString("Refreshing revisions from %1 new refs...").arg(added.count()));
+
+   mIsRefreshing = true;
+   mPendingRevisions.clear();
+   mPendingColumns.clear();
+
+   if (!startDeltaRevList(added, oldTips))
+   {
+      mIsRefreshing = false;
+      return RefreshResult::RELOAD;
+   }
+
+   return RefreshResult::REFRESHED;
+}
+
+void Git::finishRefresh(int loadTime)
+{
+   mIsRefreshing = false;
+
+   // new commits can't be ancestors of the known ones, so they go
+   // on top, right below the working directory row
+   const auto newRows = mPendingRevisions.count();
+   const auto oldCount = mRevCache->count();
+   mRevData->insertRevisions(mRevData->earlyOutputCntBase, mPendingRevisions, mPendingColumns);
+   mPendingRevisions.clear();
+   mPendingColumns.clear();
+
+   const auto base = mRevData->earlyOutputCntBase;
+   const auto added = mRevCache->count() - oldCount;
+
+   if (mBranchBitmaps)
+      mBranchBitmaps->insertRows(base, added);
+
+   // only the new rows are added to the ancestry
+   if (mReachability)
+      mReachability->addRows(base, added);
+
+   // the new rows are visited apart, the cursor keeps pointing at the same row
+   if (base < mPathFiltersRow)
+   {
+      mPathFiltersRow += added;
+
+      for (auto row = base; row < base + added; ++row)
+         mPathFiltersPending.append(mRevCache->sha(row));
+   }
+
+   mLogCacheDirty = mLogCacheDirty || newRows > 0;
+   mLogCacheLanesEnd = 0;
+
+   const auto msg = QString("Refreshed with %1 new revisions in %2 ms").arg(newRows).arg(loadTime);
+   QLog_Info("Git", msg);
+
+   publishRevs();
+   emit loadCompleted(msg);
+}
+
+bool Git::appendCachedRevs()
+{
+   const auto firstRow = mRevCache->count();
+
+   if (!mLogCache->appendTo(mRevCache.data()))
+   {
+      // the delta alone is not the whole history, start again from scratch
+      QLog_Info("Git", "Log cache is corrupted, loading the whole history");
+      mLogCache.reset();
+      mRevData->clear();
+
+      if (mReachability)
+         mReachability->clear();
+
+      resetPathFilters();
+      updateWipRevision();
+      startRevList();
+      return false;
+   }
+
+   // lanes only match if no commit was added on top of the cached ones
+   if (!mLogCacheDirty && mRevData->lns->isEmpty() && mRevData->firstFreeLane <= static_cast<uint>(firstRow))
+   {
+      const auto lanesRows = mLogCache->restoreLanes(mRevCache.data(), firstRow, *mRevData->lns);
+      ++mRevData->lanesGeneration;
+      mRevData->firstFreeLane = static_cast<uint>(firstRow + lanesRows);
+   }
+
+   mLogCacheLanesEnd = mLogCacheDirty ? 0 : static_cast<int>(mRevData->firstFreeLane);
+   mLogCache.reset();
+
+   return true;
+}
+
+bool Git::startCommitGraphRevList()
+{
+   mCommitGraph.reset(new CommitGraph(mGitDir));
+
+   if (!mCommitGraph->load())
+   {
+      mCommitGraph.reset();
+      return false;
+   }
+
+   // commits made after the file was written are not in it yet
+   QStringList knownTips;
+   QStringList added;
+
+   for (const auto &tip : refTips())
+   {
+      if (mCommitGraph->contains(tip))
+         knownTips.append(tip);
+      else
+         added.append(tip);
+   }
+
+   if (knownTips.isEmpty())
+   {
+      mCommitGraph.reset();
+      return false;
+   }
+
+   QLog_Info("Git", QString("Loading revisions from the commit-graph, %1 commits").arg(mCommitGraph->count()));
+
+   mLogCacheDirty = true;
+
+   if (added.isEmpty())
+   {
+      on_loaded(0, 0, 0, true, "commit-graph");
+      return true;
+   }
+
+   // ask git only for the missing commits, the ones in the
+   // commit-graph are appended when they are loaded, see on_loaded()
+   if (!startDeltaRevList(added, knownTips))
+   {
+      mCommitGraph.reset();
+      return false;
+   }
+
+   return true;
+}
+
+bool Git::appendCommitGraphRevs()
+{
+   // tips already loaded by git are not found in the file and skipped
+   const auto appended = mCommitGraph->appendTo(mRevCache.data(), refTips());
+   mCommitGraph.reset();
+   mLogCacheLanesEnd = 0;
+
+   if (!appended)
+   {
+      QLog_Info("Git", "Unable to read the commit-graph, loading the whole history");
+      mRevData->clear();
+
+      if (mReachability)
+         mReachability->clear();
+
+      resetPathFilters();
+      updateWipRevision();
+      startRevList();
+   }
+
+   return appended;
+}
+
+void Git::completeRevision(int row)
+{
+   if (!mPartialRows.contains(row))
+      mPartialRows.append(row);
+
+   // requests of all the rows painted in this pass go together
+   if (!mPartialTimer.isActive())
+      mPartialTimer.start();
+}
+
+void Git::completePartialRevisions()
+{
+   QStringList shas;
+
+   for (auto row : qAsConst(mPartialRows))
+   {
+      const auto revision = mRevCache->revLookup(row);
+
+      if (revision && revision->isPartial())
+      {
+         const auto sha = revision->sha();
+
+         if (!mPartialShas.contains(sha))
+         {
+            mPartialShas.insert(sha);
+            shas.append(sha);
+         }
+      }
+   }
+
+   mPartialRows.clear();
+
+   // answered in onPartialObjectsRead(), painting never waits for git
+   if (!shas.isEmpty())
+      mPartialRequests.insert(mCatFile->request(shas), shas);
+}
+
+void Git::onPartialObjectsRead(int request, const QVector<GitCatFileBatch::Object> &objects)
+{
+   const auto it = mPartialRequests.find(request);
+
+   if (it == mPartialRequests.end())
+      return;
+
+   // the ones not read are asked again the next time they are painted
+   for (const auto &sha : it.value())
+      mPartialShas.remove(sha);
+
+   mPartialRequests.erase(it);
+
+   const auto records = new QByteArray();
+   QVector<int> starts;
+   QVector<int> completedRows;
+
+   for (const auto &object : objects)
+   {
+      // rows may have moved while git was reading
+      const auto row = mRevCache->row(object.sha);
+      const auto revision = row != -1 ? mRevCache->revLookup(row) : nullptr;
+
+      if (object.type == "commit" && revision && revision->isPartial())
+      {
+         starts.append(records->size());
+         completedRows.append(row);
+         appendCommitRecord(*records, *revision, object.content);
+      }
+   }
+
+   if (completedRows.isEmpty())
+   {
+      delete records;
+      return;
+   }
+
+   mRevCache->adoptLogBuffer(records);
+
+   for (auto i = 0; i < completedRows.count(); ++i)
+   {
+      int next;
+      Revision revision(*records, static_cast<uint>(starts.at(i)), completedRows.at(i), &next);
+      mRevCache->updateRevision(completedRows.at(i), revision);
+      mRevData->revisionUpdated(completedRows.at(i));
+   }
+}
+
+void Git::saveLogCache()
+{
+   if (!mRevsLoaded || !mRevData)
+      return;
+
+   const auto lanesEnd = static_cast<int>(mRevData->firstFreeLane);
+
+   if (!mLogCacheDirty && lanesEnd <= mLogCacheLanesEnd)
+      return;
+
+   if (LogCache::save(mGitDir, refTips(), mRevCache.data(), mRevData->earlyOutputCntBase, lanesEnd, *mRevData->lns))
+   {
+      mLogCacheDirty = false;
+      mLogCacheLanesEnd = lanesEnd;
+   }
+}
+
 void Git::stop(bool saveCache)
 {
    // stop all data sending from process and asks them
@@ -1495,17 +2319,43 @@ void Git::stop(bool saveCache)
       if (!mFilesLoadingCurrentSha.isEmpty()) // we are in the middle of a loading
          mRevsFiles.remove(mFilesLoadingCurrentSha); // remove partial data
 
-      if (!mRevsFiles.isEmpty())
-         saveOnCache(mGitDir, mRevsFiles, mDirNames, mFileNames);
+      saveFileListCache();
    }
+
+   // lanes computed while browsing are worth saving too
+   if (saveCache)
+      saveLogCache();
+
+   if (saveCache && mPathFilters && mPathFilters->isDirty())
+      mPathFilters->save();
 }
 
 void Git::clearRevs()
 {
+   mIsRefreshing = false;
+   mRefreshQueued = false;
+   mPendingRevisions.clear();
+   mPendingColumns.clear();
+   mPublishTimer.stop();
+   mPartialTimer.stop();
+   mPartialRows.clear();
+   mPartialRequests.clear();
+   mPartialShas.clear();
+   mUnpublishedRevs = 0;
+   mRevsPublishCount = 0;
    mRevData->clear();
    mFirstNonStGitPatch = "";
-   workingDirInfo.clear();
+   mWipStatus.clear();
+   ++mWipRequest;
    mRevsFiles.remove(ZERO_SHA);
+
+   if (mBranchBitmaps)
+      mBranchBitmaps->clear();
+
+   if (mReachability)
+      mReachability->clear();
+
+   resetPathFilters();
 }
 
 void Git::clearFileNames()
@@ -1518,6 +2368,9 @@ void Git::clearFileNames()
    mDirNames.clear();
    mFileNames.clear();
    mRevsFilesShaBackupBuf.clear();
+   mFileListCache.reset();
+   mPathFilters.reset();
+   mPathFiltersTimer.stop();
    mCacheNeedsUpdate = false;
 }
 
@@ -1525,6 +2378,12 @@ bool Git::init(const QString &wd, QSharedPointer<RevisionsCache> revCache)
 {
    QLog_Info("Git", "Initializing Git...");
 
+   if (mRevCache != revCache || !mReachability)
+   {
+      mReachability.reset(new Reachability(revCache.data()));
+      mBranchBitmaps.reset(new BranchBitmaps(revCache.data()));
+   }
+
    mRevCache = revCache;
 
    // normally called when changing git directory. Must be called after stop()
@@ -1540,6 +2399,8 @@ bool Git::init(const QString &wd, QSharedPointer<RevisionsCache> revCache)
    {
       bool dummy;
       getBaseDir(wd, mWorkingDir, dummy);
+      mCatFile->setWorkingDir(mWorkingDir);
+      mFilesPrefetcher->setWorkingDir(mWorkingDir);
       clearFileNames();
       mFileCacheAccessed = false;
 
@@ -1560,178 +2421,70 @@ void Git::init2()
 {
    QLog_Info("Git", "Adding revisions...");
 
+   mRevsLoaded = false;
+
    updateWipRevision(); // blocking, we could be in setRepository() now
 
-   startRevList();
+   if (!startCachedRevList() && !startCommitGraphRevList())
+      startRevList();
 
    QLog_Info("Git", "... revisions finished");
 }
 
-void Git::on_loaded(ulong byteSize, int loadTime, bool normalExit)
-{
-   if (normalExit)
-   { // do not send anything if killed
-
-      emit newRevsAdded();
-
-      mRevData->loadTime += loadTime;
-
-      ulong kb = byteSize / 1024;
-      double mbs = static_cast<double>(byteSize) / mRevData->loadTime / 1000;
-      QString tmp;
-      tmp.sprintf("Loaded %i revisions  (%li KB),   "
-                  "time elapsed: %i ms  (%.2f MB/s)",
-                  mRevCache->count(), kb, mRevData->loadTime, mbs);
-
-      emit loadCompleted(tmp);
-   }
-}
-
-bool Git::saveOnCache(const QString &gitDir, const QHash<QString, const RevisionFile *> &rf,
-                      const QVector<QString> &dirs, const QVector<QString> &files)
+void Git::on_loaded(ulong byteSize, int loadTime, int firstRowTime, bool normalExit, const QString &loadMode)
 {
-   if (gitDir.isEmpty() || rf.isEmpty())
-      return false;
-
-   const auto path = QString("%1/%2").arg(gitDir, kCacheFileName);
-   const auto tmpPath = QString("%1.bak").arg(path);
-
-   QDir dir;
-   if (!dir.exists(gitDir))
+   if (normalExit && mIsRefreshing)
    {
-      return false;
+      finishRefresh(loadTime);
+      return;
    }
-   QFile f(tmpPath);
-   if (!f.open(QIODevice::WriteOnly | QIODevice::Unbuffered))
-      return false;
-
-   // compress in memory before write to file
-   QByteArray data;
-   QDataStream stream(&data, QIODevice::WriteOnly);
 
-   // Write a header with a "magic number" and a version
-   stream << static_cast<quint32>(C_MAGIC);
-   stream << static_cast<qint32>(C_VERSION);
-
-   stream << static_cast<qint32>(dirs.count());
-   for (int i = 0; i < dirs.count(); ++i)
-      stream << dirs.at(i);
-
-   stream << static_cast<qint32>(files.count());
-   for (int i = 0; i < files.count(); ++i)
-      stream << files.at(i);
-
-   // to achieve a better compression we save the sha's as
-   // one very long string instead of feeding the stream with
-   // each one. With this trick we gain a 15% size reduction
-   // in the final compressed file. The save/load speed is
-   // almost the same.
-   int bufSize = rf.count() * 41 + 1000; // a little bit more space then required
-
-   QByteArray buf;
-   buf.reserve(bufSize);
-
-   QVector<const RevisionFile *> v;
-   v.reserve(rf.count());
-
-   QVector<QByteArray> ba;
-   QString CUSTOM_SHA_RAW(toPersistentSha(CUSTOM_SHA, ba));
-   int newSize = 0;
-
-   const auto rfEnd = rf.cend();
-   for (auto it = rf.begin(); it != rfEnd; ++it)
-   {
-      const QString &sha = it.key();
-      if (sha == ZERO_SHA || sha == CUSTOM_SHA_RAW || sha[0] == 'A') // ALL_MERGE_FILES + Revision sha
-         continue;
+   if (normalExit)
+   { // do not send anything if killed
 
-      v.append(it.value());
-      buf.append(sha.toUtf8()).append('\0');
-      newSize += 41;
-      if (newSize > bufSize)
+      if (mLogCache)
       {
-         return false;
-      }
-   }
-   buf.resize(newSize);
-   stream << static_cast<qint32>(newSize);
-   stream << buf;
-
-   for (int i = 0; i < v.size(); ++i)
-      *(v.at(i)) >> stream;
+         byteSize += static_cast<ulong>(mLogCache->size());
 
-   f.write(qCompress(data, 1)); // no need to encode with compressed data
-   f.close();
-
-   if (dir.exists(path))
-   {
-      if (!dir.remove(path))
+         if (!appendCachedRevs())
+            return;
+      }
+      else if (mCommitGraph)
       {
-         dir.remove(tmpPath);
-         return false;
+         byteSize += static_cast<ulong>(mCommitGraph->size());
+
+         if (!appendCommitGraphRevs())
+            return;
       }
-   }
-   dir.rename(tmpPath, path);
-   return true;
-}
 
-bool Git::loadFromCache(const QString &gitDir, QHash<QString, const RevisionFile *> &rfm, QVector<QString> &dirs,
-                        QVector<QString> &files, QByteArray &revsFilesShaBuf)
-{
-   // check for cache file
-   QString path = QString("%1/%2").arg(gitDir, kCacheFileName);
-   QFile f(path);
-   if (!f.exists())
-      return true; // no cache file is not an error
+      mRevsLoaded = true;
 
-   if (!f.open(QIODevice::ReadOnly | QIODevice::Unbuffered))
-      return false;
+      if (mReachability)
+         mReachability->addRows(0, mRevCache->count());
 
-   QDataStream stream(qUncompress(f.readAll()));
-   quint32 magic;
-   qint32 version;
-   qint32 dirsNum, filesNum, bufSize;
-   stream >> magic;
-   stream >> version;
-   if (magic != C_MAGIC || version != C_VERSION)
-   {
-      f.close();
-      return false;
-   }
-   // read the data
-   stream >> dirsNum;
-   dirs.resize(dirsNum);
-   for (int i = 0; i < dirsNum; ++i)
-      stream >> dirs[i];
+      publishRevs();
+      QLog_Info("Git", QString("Revisions published to the views in %1 updates").arg(mRevsPublishCount));
 
-   stream >> filesNum;
-   files.resize(filesNum);
-   for (int i = 0; i < filesNum; ++i)
-      stream >> files[i];
-
-   stream >> bufSize;
-   revsFilesShaBuf.clear();
-   revsFilesShaBuf.reserve(bufSize);
-   stream >> revsFilesShaBuf;
-
-   const char *data = revsFilesShaBuf.constData();
+      mRevData->loadTime += loadTime;
 
-   while (!stream.atEnd())
-   {
+      ulong kb = byteSize / 1024;
+      double mbs = static_cast<double>(byteSize) / qMax(mRevData->loadTime, 1) / 1000;
+      QString tmp;
+      tmp.sprintf("Loaded %i revisions  (%li KB),   "
+                  "time elapsed: %i ms  (%.2f MB/s),   first row after %i ms (%s)",
+                  mRevCache->count(), kb, mRevData->loadTime, mbs, firstRowTime, loadMode.toLatin1().constData());
 
-      RevisionFile *rf = new RevisionFile();
-      *rf << stream;
+      QLog_Info("Git", tmp);
 
-      QString sha = QString::fromUtf8(data);
-      rfm.insert(sha, rf);
+      emit loadCompleted(tmp);
 
-      data += 40;
-      if (*data != '\0')
-         return false;
-      data++;
+      saveLogCache();
+   }
+   else
+   {
+      mLogCache.reset();
+      mCommitGraph.reset();
    }
-   f.close();
-   return true;
 }
 
 bool Git::populateRenamedPatches(const QString &renamedSha, const QStringList &newNames, QStringList *oldNames,
@@ -1800,29 +2553,125 @@ bool Git::populateRenamedPatches(const QString &renamedSha, const QStringList &n
    return true;
 }
 
-void Git::populateFileNamesMap()
+void Git::loadFileCache()
 {
+   if (!mFileCacheAccessed)
+   {
+      mFileCacheAccessed = true;
+      mFileListCache.reset(new FileListCache(mGitDir));
+
+      // records are only read when asked for, see getFiles()
+      if (mFileListCache->load())
+         QLog_Info("Git", QString("File list cache with %1 commits").arg(mFileListCache->count()));
 
-   for (int i = 0; i < mDirNames.count(); ++i)
-      mDirNamesMap.insert(mDirNames[i], i);
+      mPathFilters.reset(new ChangedPathFilters(mGitDir));
 
-   for (int i = 0; i < mFileNames.count(); ++i)
-      mFileNamesMap.insert(mFileNames[i], i);
+      if (mPathFilters->load())
+         QLog_Info("Git", QString("Path filters for %1 commits").arg(mPathFilters->count()));
+   }
 }
 
-void Git::loadFileCache()
+const RevisionFile *Git::loadCachedFiles(const QString &sha)
 {
-   if (!mFileCacheAccessed)
+   if (!mFileListCache)
+      return nullptr;
+
+   const auto record = mFileListCache->record(sha);
+
+   if (record.isEmpty())
+      return nullptr;
+
+   const auto rf = decodeFileList(record);
+
+   if (rf)
+      mRevsFiles.insert(toPersistentSha(sha, mRevsFilesShaBackupBuf), rf);
+
+   return rf;
+}
+
+void Git::saveFileListCache()
+{
+   if (!mFileListCache)
+      return;
+
+   // only what was computed in this session is appended
+   QVector<QPair<QString, QByteArray>> records;
+
+   for (auto it = mRevsFiles.constBegin(); it != mRevsFiles.constEnd(); ++it)
    {
-      mFileCacheAccessed = true;
-      QByteArray shaBuf;
+      const auto &sha = it.key();
 
-      if (loadFromCache(mGitDir, mRevsFiles, mDirNames, mFileNames, shaBuf))
-      {
-         mRevsFilesShaBackupBuf.append(shaBuf);
-         populateFileNamesMap();
-      }
+      // not the working dir, custom diffs nor ALL_MERGE_FILES + Revision sha
+      if (sha.length() != 40 || sha == ZERO_SHA || sha == CUSTOM_SHA || mFileListCache->contains(sha))
+         continue;
+
+      records.append(qMakePair(sha, encodeFileList(*it.value())));
+   }
+
+   if (!mFileListCache->append(records))
+      QLog_Warning("Git", "Unable to save the file list cache");
+}
+
+QByteArray Git::encodeFileList(const RevisionFile &rf) const
+{
+   // paths are saved in full, the dir and file name
+   // tables are rebuilt in every session as records are read
+   QVector<QString> paths;
+   paths.reserve(rf.count());
+
+   for (auto i = 0; i < rf.count(); ++i)
+      paths.append(filePath(rf, i));
+
+   QByteArray record;
+   QDataStream stream(&record, QIODevice::WriteOnly);
+   stream << paths;
+   stream << static_cast<quint8>(rf.onlyModified);
+   stream << rf.status;
+   stream << rf.mergeParent;
+   stream << rf.extStatus;
+
+   return record;
+}
+
+RevisionFile *Git::decodeFileList(const QByteArray &record)
+{
+   QDataStream stream(record);
+   QVector<QString> paths;
+   quint8 onlyModified;
+
+   const auto rf = new RevisionFile();
+   stream >> paths;
+   stream >> onlyModified;
+   stream >> rf->status;
+   stream >> rf->mergeParent;
+   stream >> rf->extStatus;
+
+   if (stream.status() != QDataStream::Ok)
+   {
+      delete rf;
+      return nullptr;
    }
+
+   rf->onlyModified = onlyModified != 0;
+
+   FileNamesLoader fl;
+
+   for (const auto &path : qAsConst(paths))
+      appendFileName(*rf, path, fl);
+
+   flushFileNames(fl);
+
+   return rf;
+}
+
+QStringList Git::decodeFileListPaths(const QByteArray &record)
+{
+   // paths come first, see encodeFileList()
+   QDataStream stream(record);
+   QVector<QString> paths;
+   stream >> paths;
+
+   return stream.status() == QDataStream::Ok ? paths.toList() : QStringList();
 }
 
 bool Git::filterEarlyOutputRev(Revision *revision)
@@ -1831,8 +2680,9 @@ bool Git::filterEarlyOutputRev(Revision *revision)
    if (mRevData->earlyOutputCnt < mRevCache->revOrderCount())
    {
 
-      const QString &sha = mRevCache->createRevisionSha(mRevData->earlyOutputCnt++);
-      const auto c = mRevCache->revLookup(sha);
+      const auto row = mRevData->earlyOutputCnt++;
+      const auto sha = mRevCache->sha(row);
+      const auto c = mRevCache->revLookup(row);
       if (c)
       {
          if (revision->sha() != sha || revision->parents() != c->parents())
@@ -1851,48 +2701,49 @@ bool Git::filterEarlyOutputRev(Revision *revision)
    return false;
 }
 
-int Git::addChunk(const QByteArray &ba, int start)
+void Git::addRevision(Revision revision, bool finalOutput, const RevisionsCache::Columns &columns)
 {
-   int nextStart;
-   Revision *revision;
-
-   do
+   if (mIsRefreshing)
    {
-      // only here we create a new Revision
-      revision = new Revision(ba, static_cast<uint>(start), mRevCache->revOrderCount(), &nextStart);
+      // the whole delta is spliced in at once when loaded
+      mPendingRevisions.append(revision);
+      mPendingColumns.append(columns);
+      return;
+   }
 
-      if (nextStart == -2)
-      {
-         delete revision;
-         mRevData->setEarlyOutputState(true);
-         start = ba.indexOf('\n', start) + 1;
-      }
+   if (finalOutput)
+      mRevData->setEarlyOutputState(true);
 
-   } while (nextStart == -2);
+   // the final row is only known now that revisions are committed in order
+   revision.orderIdx = mRevCache->revOrderCount();
 
-   if (nextStart == -1)
-   { // half chunk detected
-      delete revision;
-      return -1;
-   }
+   const auto sha = revision.sha();
 
-   const auto sha = revision->sha();
+   if (mRevData->earlyOutputCnt != -1 && filterEarlyOutputRev(&revision))
+      return;
 
-   if (mRevData->earlyOutputCnt != -1 && filterEarlyOutputRev(revision))
+   if (!(revision.parentsCount() > 1 && mRevCache->contains(sha)))
    {
-      delete revision;
-      return nextStart;
+      mRevCache->insertRevision(sha, revision, columns);
+      ++mUnpublishedRevs;
    }
+}
 
-   if (!(revision->parentsCount() > 1 && mRevCache->contains(sha)))
-   {
-      mRevCache->insertRevision(sha, *revision);
+void Git::scheduleRevsPublish()
+{
+   if (mUnpublishedRevs >= REVS_PUBLISH_ROWS)
+      publishRevs();
+   else if (!mPublishTimer.isActive())
+      mPublishTimer.start();
+}
 
-      emit mRevCache->signalCacheUpdated();
-      emit newRevsAdded();
-   }
+void Git::publishRevs()
+{
+   mPublishTimer.stop();
+   mUnpublishedRevs = 0;
+   ++mRevsPublishCount;
 
-   return nextStart;
+   emit newRevsAdded();
 }
 
 bool Git::copyDiffIndex(const QString &parent)
@@ -1911,85 +2762,80 @@ bool Git::copyDiffIndex(const QString &parent)
       return false;
 
    // insert a custom ZERO_SHA Revision with proper parent
-   const Revision *rf = fakeWorkDirRev(parent, "Working directory changes", "long log\n", 0);
-   mRevCache->insertRevision(ZERO_SHA, *rf);
+   const auto rf = fakeWorkDirRev(parent, "Working directory changes", "long log\n", 0);
+   mRevCache->insertRevision(ZERO_SHA, rf);
+   mRevCache->setLanes(rf.orderIdx, { LaneType::EMPTY });
 
-   emit mRevCache->signalCacheUpdated();
-   emit newRevsAdded();
+   publishRevs();
 
    return true;
 }
 
 void Git::setLane(const QString &sha)
 {
+   const auto row = mRevCache->row(sha);
 
-   Lanes *l = mRevData->lns;
-   uint i = mRevData->firstFreeLane;
-   QVector<QByteArray> ba;
-   const QString &ss = toPersistentSha(sha, ba);
-
-   for (uint cnt = static_cast<uint>(mRevCache->revOrderCount()); i < cnt; ++i)
-   {
-
-      const QString &curSha = mRevCache->getRevisionSha(static_cast<int>(i));
-      Revision *r = const_cast<Revision *>(mRevCache->revLookup(curSha));
-      if (r->lanes.count() == 0)
-         updateLanes(*r, *l, curSha);
+   if (row == -1)
+      return;
 
-      if (curSha == ss)
-         break;
-   }
-   mRevData->firstFreeLane = ++i;
+   // rows far below the last computed one are worked out by a thread,
+   // so that a jump does not freeze the GUI
+   if (row - static_cast<int>(mRevData->firstFreeLane) > LANES_SYNC_ROWS)
+      mRevData->computeLanesAhead(row);
+   else
+      computeLanes(row);
 }
 
-void Git::updateLanes(Revision &c, Lanes &lns, const QString &sha)
+void Git::computeLanes(int lastRow)
 {
-   // we could get third argument from c.sha(), but we are in fast path here
-   // and c.sha() involves a deep copy, so we accept a little redundancy
-
-   if (lns.isEmpty())
-      lns.init(sha);
+   Lanes *l = mRevData->lns;
+   auto i = static_cast<int>(mRevData->firstFreeLane);
+   const auto cnt = qMin(lastRow + 1, mRevCache->revOrderCount());
 
-   bool isDiscontinuity;
-   bool isFork = lns.isFork(sha, isDiscontinuity);
-   bool isMerge = (c.parentsCount() > 1);
-   bool isInitial = (c.parentsCount() == 0);
+   while (i < cnt)
+   {
+      // once the lanes state matches the one computed before new rows were
+      // spliced in, all the lanes below are the same and are kept as they are
+      if (i < mRevData->staleLanesEnd && mRevData->staleCheckpoints.contains(i)
+          && *l == mRevData->staleCheckpoints.value(i))
+      {
+         const auto &stale = mRevData->staleCheckpoints;
 
-   if (isDiscontinuity)
-      lns.changeActiveLane(sha); // uses previous isBoundary state
+         for (auto it = stale.lowerBound(i); it != stale.constEnd(); ++it)
+            mRevData->laneCheckpoints.insert(it.key(), it.value());
 
-   lns.setBoundary(c.isBoundary()); // update must be here
+         *l = mRevData->staleLanesEndState;
+         i = mRevData->staleLanesEnd;
+         mRevData->staleCheckpoints.clear();
+         mRevData->staleLanesEnd = 0;
+         continue;
+      }
 
-   if (isFork)
-      lns.setFork(sha);
-   if (isMerge)
-      lns.setMerge(c.parents());
-   if (c.isApplied)
-      lns.setApplied();
-   if (isInitial)
-      lns.setInitial();
+      if (i % RepositoryModel::LANES_CHECKPOINT_INTERVAL == 0 && !l->isEmpty())
+         mRevData->laneCheckpoints.insert(i, *l);
 
-   lns.setLanes(c.lanes); // here lanes are snapshotted
+      // the working dir revision has its own lanes
+      if (!(mRevCache->topology().flags.at(i) & RevisionsCache::Topology::WORKING_DIR))
+         updateLanes(i, *l);
 
-   const QString &nextSha = (isInitial) ? "" : QString(c.parent(0));
+      ++i;
+   }
 
-   lns.nextParent(nextSha);
+   if (i >= mRevData->staleLanesEnd)
+   {
+      mRevData->staleCheckpoints.clear();
+      mRevData->staleLanesEnd = 0;
+   }
 
-   if (c.isApplied)
-      lns.afterApplied();
-   if (isMerge)
-      lns.afterMerge();
-   if (isFork)
-      lns.afterFork();
-   if (lns.isBranch())
-      lns.afterBranch();
+   mRevData->firstFreeLane = static_cast<uint>(qMax(i, static_cast<int>(mRevData->firstFreeLane)));
+}
 
-   //	QString tmp = "", tmp2;
-   //	for (uint i = 0; i < c.lanes.count(); i++) {
-   //		tmp2.setNum(c.lanes[i]);
-   //		tmp.append(tmp2 + "-");
-   //	}
-   //	qDebug("%s %s", tmp.toUtf8().data(), sha.toUtf8().data());
+void Git::updateLanes(int row, Lanes &lns)
+{
+   // lanes work on the commit ids of the cache, no SHA string is built in this fast path
+   QVector<LaneType> lanes;
+   RepositoryModel::stepLanes(mRevCache->topology(), row, lns, lanes);
+   mRevCache->setLanes(row, lanes);
 }
 
 void Git::flushFileNames(FileNamesLoader &fl)
@@ -2001,6 +2847,7 @@ void Git::flushFileNames(FileNamesLoader &fl)
    QByteArray &b = fl.rf->pathsIdx;
    QVector<int> &dirs = fl.rfDirs;
 
+   fl.rf->resetPathIndex();
    b.clear();
    b.resize(2 * dirs.size() * static_cast<int>(sizeof(int)));
 
@@ -2051,212 +2898,3 @@ void Git::appendFileName(RevisionFile &rf, const QString &name, FileNamesLoader
    else
       fl.rfNames.append(*it);
 }
-
-void Git::updateDescMap(const Revision *r, uint idx, QHash<QPair<uint, uint>, bool> &dm, QHash<uint, QVector<int>> &dv)
-{
-
-   QVector<int> descVec;
-   if (r->descRefsMaster != -1)
-   {
-
-      const Revision *tmp = mRevCache->revLookup(mRevCache->createRevisionSha(r->descRefsMaster));
-      const QVector<int> &nr = tmp->descRefs;
-
-      for (int i = 0; i < nr.count(); i++)
-      {
-
-         if (!dv.contains(nr[i]))
-            return;
-
-         const QVector<int> &dvv = dv[nr[i]];
-
-         // copy the whole vector instead of each element
-         // in the first iteration of the loop below
-         descVec = dvv; // quick (shared) copy
-
-         for (int y = 0; y < dvv.count(); y++)
-         {
-
-            uint v = (uint)dvv[y];
-            QPair<uint, uint> key = qMakePair(idx, v);
-            QPair<uint, uint> keyN = qMakePair(v, idx);
-            dm.insert(key, true);
-            dm.insert(keyN, false);
-
-            // we don't want duplicated entry, otherwise 'dvv' grows
-            // greatly in repos with many tagged development branches
-            if (i > 0 && !descVec.contains(v)) // i > 0 is rare, no
-               descVec.append(v); // need to optimize
-         }
-      }
-   }
-   descVec.append(idx);
-   dv.insert(idx, descVec);
-}
-
-void Git::mergeBranches(Revision *p, const Revision *r)
-{
-
-   int r_descBrnMaster = (checkRef(r->sha(), BRANCH | RMT_BRANCH) ? r->orderIdx : r->descBrnMaster);
-
-   if (p->descBrnMaster == r_descBrnMaster || r_descBrnMaster == -1)
-      return;
-
-   // we want all the descendant branches, so just avoid duplicates
-   const QVector<int> &src1 = mRevCache->revLookup(mRevCache->createRevisionSha(p->descBrnMaster))->descBranches;
-   const QVector<int> &src2 = mRevCache->revLookup(mRevCache->createRevisionSha(r_descBrnMaster))->descBranches;
-   QVector<int> dst(src1);
-   for (int i = 0; i < src2.count(); i++)
-      if (std::find(src1.constBegin(), src1.constEnd(), src2[i]) == src1.constEnd())
-         dst.append(src2[i]);
-
-   p->descBranches = dst;
-   p->descBrnMaster = p->orderIdx;
-}
-
-void Git::mergeNearTags(bool down, Revision *p, const Revision *r, const QHash<QPair<uint, uint>, bool> &dm)
-{
-
-   bool isTag = checkRef(r->sha(), TAG);
-   int r_descRefsMaster = isTag ? r->orderIdx : r->descRefsMaster;
-   int r_ancRefsMaster = isTag ? r->orderIdx : r->ancRefsMaster;
-
-   if (down && (p->descRefsMaster == r_descRefsMaster || r_descRefsMaster == -1))
-      return;
-
-   if (!down && (p->ancRefsMaster == r_ancRefsMaster || r_ancRefsMaster == -1))
-      return;
-
-   // we want the nearest tag only, so remove any tag
-   // that is ancestor of any other tag in p U r
-   const QString &sha1 = mRevCache->getRevisionSha(down ? p->descRefsMaster : p->ancRefsMaster);
-   const QString &sha2 = mRevCache->getRevisionSha(down ? r_descRefsMaster : r_ancRefsMaster);
-   const QVector<int> &src1 = down ? mRevCache->revLookup(sha1)->descRefs : mRevCache->revLookup(sha1)->ancRefs;
-   const QVector<int> &src2 = down ? mRevCache->revLookup(sha2)->descRefs : mRevCache->revLookup(sha2)->ancRefs;
-   QVector<int> dst(src1);
-
-   for (int s2 = 0; s2 < src2.count(); s2++)
-   {
-
-      bool add = false;
-      for (int s1 = 0; s1 < src1.count(); s1++)
-      {
-
-         if (src2[s2] == src1[s1])
-         {
-            add = false;
-            break;
-         }
-         QPair<uint, uint> key = qMakePair((uint)src2[s2], (uint)src1[s1]);
-
-         if (!dm.contains(key))
-         { // could be empty if all tags are independent
-            add = true; // could be an independent path
-            continue;
-         }
-         add = (down && dm[key]) || (!down && !dm[key]);
-         if (add)
-            dst[s1] = -1; // mark for removing
-         else
-            break;
-      }
-      if (add)
-         dst.append(src2[s2]);
-   }
-   QVector<int> &nearRefs = (down ? p->descRefs : p->ancRefs);
-   int &nearRefsMaster = (down ? p->descRefsMaster : p->ancRefsMaster);
-
-   nearRefs.clear();
-   for (int s2 = 0; s2 < dst.count(); s2++)
-      if (dst[s2] != -1)
-         nearRefs.append(dst[s2]);
-
-   nearRefsMaster = p->orderIdx;
-}
-
-void Git::indexTree()
-{
-   if (mRevCache->revOrderCount() == 0)
-      return;
-
-   // we keep the pairs(x, y). Value is true if x is
-   // ancestor of y or false if y is ancestor of x
-   QHash<QPair<uint, uint>, bool> descMap;
-   QHash<uint, QVector<int>> descVect;
-
-   // walk down the tree from latest to oldest,
-   // compute children and nearest descendants
-   for (int i = 0, cnt = mRevCache->revOrderCount(); i < cnt; ++i)
-   {
-
-      const auto shaToLookup = mRevCache->getRevisionSha(i);
-      auto type = checkRef(shaToLookup);
-      auto isB = type & (BRANCH | RMT_BRANCH);
-      auto isT = type & TAG;
-
-      const Revision *r = mRevCache->revLookup(shaToLookup);
-
-      if (isB)
-      {
-         auto rr = const_cast<Revision *>(r);
-
-         if (r->descBrnMaster != -1)
-         {
-            const auto sha = mRevCache->getRevisionSha(r->descBrnMaster);
-            rr->descBranches = mRevCache->revLookup(sha)->descBranches;
-         }
-
-         rr->descBranches.append(i);
-      }
-      if (isT)
-      {
-         updateDescMap(r, i, descMap, descVect);
-         auto rr = const_cast<Revision *>(r);
-         rr->descRefs.clear();
-         rr->descRefs.append(i);
-      }
-      for (uint y = 0; y < r->parentsCount(); y++)
-      {
-         if (auto p = const_cast<Revision *>(mRevCache->revLookup(r->parent(y))))
-         {
-            p->children.append(i);
-
-            if (p->descBrnMaster == -1)
-               p->descBrnMaster = isB ? r->orderIdx : r->descBrnMaster;
-            else
-               mergeBranches(p, r);
-
-            if (p->descRefsMaster == -1)
-               p->descRefsMaster = isT ? r->orderIdx : r->descRefsMaster;
-            else
-               mergeNearTags(true, p, r, descMap);
-         }
-      }
-   }
-   // walk backward through the tree and compute nearest tagged ancestors
-   for (auto i = mRevCache->revOrderCount() - 1; i >= 0; --i)
-   {
-      const auto r = mRevCache->revLookup(mRevCache->getRevisionSha(i));
-      const auto isTag = checkRef(mRevCache->getRevisionSha(i), TAG);
-
-      if (isTag)
-      {
-         Revision *rr = const_cast<Revision *>(r);
-         rr->ancRefs.clear();
-         rr->ancRefs.append(i);
-      }
-      for (int y = 0; y < r->children.count(); y++)
-      {
-         const auto revSha = mRevCache->getRevisionSha(r->children[y]);
-         auto c = const_cast<Revision *>(mRevCache->revLookup(revSha));
-
-         if (c)
-         {
-            if (c->ancRefsMaster == -1)
-               c->ancRefsMaster = isTag ? r->orderIdx : r->ancRefsMaster;
-            else
-               mergeNearTags(false, c, r, descMap);
-         }
-      }
-   }
-}
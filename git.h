@@ -7,14 +7,26 @@
 #ifndef GIT_H
 #define GIT_H
 
+#include <QFuture>
 #include <QObject>
 #include <QVariant>
+#include <QSet>
 #include <QSharedPointer>
+#include <QTimer>
+
+#include <GitCatFileBatch.h>
+#include <RevisionsCache.h>
+#include <WipStatus.h>
 
 template<class, class>
 struct QPair;
 
-class RevisionsCache;
+class LogCache;
+class CommitGraph;
+class FileListCache;
+class ChangedPathFilters;
+class BranchBitmaps;
+class Reachability;
 class RevisionFile;
 class Revision;
 class QRegExp;
@@ -24,11 +36,17 @@ class Domain;
 class RepositoryModel;
 class Lanes;
 class GitAsyncProcess;
+class GitCommandPool;
+class DiffTreePrefetcher;
 
 static const QString ZERO_SHA = "0000000000000000000000000000000000000000";
 
 struct GitExecResult
 {
+   GitExecResult()
+      : success(false)
+   {
+   }
    GitExecResult(const QPair<bool, QString> &result)
       : success(result.first)
       , output(result.second)
@@ -49,8 +67,10 @@ signals:
 signals:
    void newRevsAdded();
    void loadCompleted(const QString &);
+   void refreshRequested(); // a refresh asked for while loading is due
    void cancelLoading();
    void cancelAllProcesses();
+   void wipRevisionUpdated();
 
 public:
    enum class CommitResetType
@@ -59,14 +79,22 @@ public:
       MIXED,
       HARD
    };
+   enum class RefreshResult
+   {
+      REFRESHED, // only the new commits are loaded, if any
+      QUEUED, // a load is running, refreshRequested() is emitted once it completes
+      RELOAD // history was rewritten, it has to be loaded again
+   };
 
    explicit Git();
+   ~Git();
 
    /** START Git CONFIGURATION **/
    bool init(const QString &wd, QSharedPointer<RevisionsCache> revCache);
    void init2();
    void stop(bool saveCache);
    QString getWorkingDir() const { return mWorkingDir; }
+   QString getGitDir() const { return mGitDir; }
    /** END Git CONFIGURATION **/
 
    /** START BRANCHES **/
@@ -77,8 +105,9 @@ public:
    GitExecResult renameBranch(const QString &oldName, const QString &newName);
    GitExecResult removeLocalBranch(const QString &branchName);
    GitExecResult removeRemoteBranch(const QString &branchName);
-   GitExecResult getBranches();
-   GitExecResult getDistanceBetweenBranches(bool toMaster, const QString &right);
+   QFuture<GitExecResult> getBranches() const;
+   bool getDistanceBetweenCommits(const QString &leftSha, const QString &rightSha, int &leftOnly,
+                                  int &rightOnly) const;
    GitExecResult getBranchesOfCommit(const QString &sha);
    GitExecResult getLastCommitOfBranch(const QString &branch);
    GitExecResult prune();
@@ -87,8 +116,8 @@ public:
    /** END BRANCHES **/
 
    /** START TAGS **/
-   QVector<QString> getTags() const;
-   QVector<QString> getLocalTags() const;
+   QFuture<QVector<QString>> getTags() const;
+   QFuture<QVector<QString>> getLocalTags() const;
    bool addTag(const QString &tagName, const QString &tagMessage, const QString &sha, QByteArray &output);
    bool removeTag(const QString &tagName, bool remote);
    bool pushTag(const QString &tagName, QByteArray &output);
@@ -98,7 +127,7 @@ public:
    /**  END  TAGS **/
 
    /** START STASHES **/
-   QVector<QString> getStashes();
+   QFuture<QVector<QString>> getStashes() const;
    bool getStashCommit(const QString &stash, QByteArray &output);
    /**  END  STASHES **/
 
@@ -125,7 +154,7 @@ public:
    /** END COMMIT INFO **/
 
    /** START SUBMODULES **/
-   QVector<QString> getSubmodules();
+   QFuture<QVector<QString>> getSubmodules() const;
    bool submoduleAdd(const QString &url, const QString &name);
    bool submoduleUpdate(const QString &submodule);
    bool submoduleRemove(const QString &submodule);
@@ -154,7 +183,11 @@ public:
 
    void setDefaultModel(RepositoryModel *fh) { mRevData = fh; }
    void setLane(const QString &sha);
+   void computeLanes(int lastRow);
+   void completeRevision(int row);
    void cancelDataLoading();
+   bool isLoadingRevs() const { return !mRevsLoaded || mIsRefreshing; }
+   int revsPublishCount() const { return mRevsPublishCount; }
 
    bool isNothingToCommit();
 
@@ -163,13 +196,19 @@ public:
 
    const RevisionFile *getFiles(const QString &sha, const QString &sha2 = "", bool all = false,
                                 const QString &path = "");
+   void prefetchFiles(const QStringList &shas);
+   QFuture<QStringList> getFileHistory(const QString &path);
 
    const QString getLaneParent(const QString &fromSHA, int laneNum);
    const QStringList getChildren(const QString &parent);
+   bool getBranchesContaining(const QString &sha, QStringList &branches) const;
+   bool getNearestTags(const QString &sha, bool descendants, QStringList &tags) const;
    const Revision *revLookup(const QString &sha) const;
    uint checkRef(const QString &sha, uint mask = ANY_REF) const;
    const QString getRefSha(const QString &refName, RefType type = ANY_REF, bool askGit = true);
    const QStringList getRefNames(const QString &sha, uint mask = ANY_REF) const;
+   QStringList getRefShas() const { return mRefsShaMap.keys(); }
+   int refsGeneration() const { return mRefsGeneration; }
    const QStringList sortShaListByIndex(QStringList &shaList);
    bool merge(const QString &into, QStringList sources, QString *error = nullptr);
 
@@ -178,16 +217,15 @@ public:
    void formatPatchFileHeader(QString *rowName, const QString &sha, const QString &dts, bool cmb, bool all);
    const QString filePath(const RevisionFile &rf, int i) const;
    QPair<bool, QString> run(const QString &cmd) const;
+   QFuture<GitExecResult> runTask(const QString &cmd) const;
 
    void updateWipRevision();
+   void updateWipRevisionAsync();
+   RefreshResult refreshRevs();
 
 private:
    void loadFileCache();
-   void on_loaded(ulong, int, bool);
-   bool saveOnCache(const QString &gitDir, const QHash<QString, const RevisionFile *> &rf, const QVector<QString> &dirs,
-                    const QVector<QString> &files);
-   bool loadFromCache(const QString &gitDir, QHash<QString, const RevisionFile *> &rfm, QVector<QString> &dirs,
-                      QVector<QString> &files, QByteArray &revsFilesShaBuf);
+   void on_loaded(ulong byteSize, int loadTime, int firstRowTime, bool normalExit, const QString &loadMode);
    bool getGitDBDir(const QString &wd, QString &gd, bool &changed);
 
    friend class DataLoader;
@@ -208,18 +246,8 @@ private:
       QString stgitPatch;
    };
 
-   struct WorkingDirInfo
-   {
-      void clear()
-      {
-         diffIndex = diffIndexCached = "";
-         otherFiles.clear();
-      }
-      QString diffIndex;
-      QString diffIndexCached;
-      QStringList otherFiles;
-   };
-   WorkingDirInfo workingDirInfo;
+   WipStatus mWipStatus;
+   int mWipRequest = 0;
 
    struct FileNamesLoader
    {
@@ -236,36 +264,58 @@ private:
 
    bool updateIndex(const QStringList &selFiles);
    const QString getWorkDirDiff(const QString &fileName = "");
+   bool findPathKey(const QString &name, quint64 &key) const;
    int findFileIndex(const RevisionFile &rf, const QString &name);
    void runAsync(const QString &cmd, QObject *rcv, const QString &buf = "");
    bool getRefs();
    void clearRevs();
    void clearFileNames();
    bool startRevList();
-   bool startParseProc(const QStringList &initCmd);
+   bool startCachedRevList();
+   bool startCommitGraphRevList();
+   bool startDeltaRevList(const QStringList &tips, const QStringList &knownTips);
+   bool diffTips(const QStringList &oldTips, QStringList &added) const;
+   void finishRefresh(int loadTime);
+   bool appendCachedRevs();
+   bool appendCommitGraphRevs();
+   void completePartialRevisions();
+   void onPartialObjectsRead(int request, const QVector<GitCatFileBatch::Object> &objects);
+   void saveLogCache();
+   QString logCommand() const;
+   QStringList refTips() const;
+   bool startParseProc(const QStringList &initCmd, const QString &buf = QString());
    bool populateRenamedPatches(const QString &sha, const QStringList &nn, QStringList *on, bool bt);
    bool filterEarlyOutputRev(Revision *revision);
-   int addChunk(const QByteArray &ba, int ofs);
+   void addRevision(Revision revision, bool finalOutput, const RevisionsCache::Columns &columns);
+   void scheduleRevsPublish();
+   void publishRevs();
    void parseDiffFormat(RevisionFile &rf, const QString &buf, FileNamesLoader &fl);
    void parseDiffFormatLine(RevisionFile &rf, const QString &line, int parNum, FileNamesLoader &fl);
-   Revision *fakeRevData(const QString &sha, const QStringList &parents, const QString &author, const QString &date,
-                         const QString &log, const QString &longLog, const QString &patch, int idx);
-   const Revision *fakeWorkDirRev(const QString &parent, const QString &log, const QString &longLog, int idx);
-   const RevisionFile *fakeWorkDirRevFile(const WorkingDirInfo &wd);
+   Revision fakeRevData(const QString &sha, const QStringList &parents, const QString &author, const QString &date,
+                        const QString &log, const QString &longLog, const QString &patch, int idx);
+   Revision fakeWorkDirRev(const QString &parent, const QString &log, const QString &longLog, int idx);
+   const RevisionFile *fakeWorkDirRevFile(const WipStatus &wip);
    bool copyDiffIndex(const QString &parent);
    const RevisionFile *insertNewFiles(const QString &sha, const QString &data);
    const RevisionFile *getAllMergeFiles(const Revision *r);
    bool runDiffTreeWithRenameDetection(const QString &runCmd, QString *runOutput);
-   void indexTree();
-   void updateDescMap(const Revision *r, uint i, QHash<QPair<uint, uint>, bool> &dm, QHash<uint, QVector<int>> &dv);
-   void mergeNearTags(bool down, Revision *p, const Revision *r, const QHash<QPair<uint, uint>, bool> &dm);
-   void mergeBranches(Revision *p, const Revision *r);
-   void updateLanes(Revision &c, Lanes &lns, const QString &sha);
-   const QStringList getOthersFiles();
+   void onFilesPrefetched(const QString &sha, const QString &diff);
+   void addPathFilter(const QString &sha, const RevisionFile &rf);
+   void buildPathFilters();
+   void loadPathFilter(const Revision *r);
+   void resetPathFilters();
+   bool filterFileHistory(const QString &name, QStringList &candidates) const;
+   void updateLanes(int row, Lanes &lns);
+   QString readCommitMsg(const QString &sha) const;
+   void applyWipRevision();
    const QStringList getOtherFiles(const QStringList &selFiles);
    void appendFileName(RevisionFile &rf, const QString &name, FileNamesLoader &fl);
    void flushFileNames(FileNamesLoader &fl);
-   void populateFileNamesMap();
+   const RevisionFile *loadCachedFiles(const QString &sha);
+   void saveFileListCache();
+   QByteArray encodeFileList(const RevisionFile &rf) const;
+   RevisionFile *decodeFileList(const QByteArray &record);
+   static QStringList decodeFileListPaths(const QByteArray &record);
    static const QString quote(const QString &nm);
    static const QString quote(const QStringList &sl);
    void setStatus(RevisionFile &rf, const QString &rowSt);
@@ -284,7 +334,14 @@ private:
    QString mFirstNonStGitPatch;
    QHash<QString, const RevisionFile *> mRevsFiles;
    QVector<QByteArray> mRevsFilesShaBackupBuf;
+   QSharedPointer<FileListCache> mFileListCache;
+   QSharedPointer<ChangedPathFilters> mPathFilters;
+   // filters are built in small steps after every load, see buildPathFilters()
+   QTimer mPathFiltersTimer;
+   int mPathFiltersRow = 0; // next row to visit, the ones above are done
+   QStringList mPathFiltersPending; // rows a refresh inserted above it
    QHash<QString, Reference> mRefsShaMap;
+   int mRefsGeneration = 0; // bumped on every refs reload
    QVector<QByteArray> mShaBackupBuf;
    QVector<QString> mFileNames;
    QVector<QString> mDirNames;
@@ -292,7 +349,30 @@ private:
    QHash<QString, int> mDirNamesMap; // quick lookup directory name
    RepositoryModel *mRevData = nullptr;
    QSharedPointer<RevisionsCache> mRevCache;
-   static const QString kCacheFileName;
+   QSharedPointer<LogCache> mLogCache;
+   bool mLogCacheDirty = false;
+   bool mRevsLoaded = false;
+   bool mIsRefreshing = false;
+   bool mRefreshQueued = false;
+   QVector<Revision> mPendingRevisions;
+   QVector<RevisionsCache::Columns> mPendingColumns;
+   int mLogCacheLanesEnd = 0;
+   QSharedPointer<CommitGraph> mCommitGraph;
+   QSharedPointer<Reachability> mReachability;
+   QSharedPointer<BranchBitmaps> mBranchBitmaps;
+   // rows loaded from the commit-graph get author and message once shown
+   QVector<int> mPartialRows;
+   QTimer mPartialTimer;
+   QHash<int, QStringList> mPartialRequests; // asked to git cat-file, not answered yet
+   QSet<QString> mPartialShas;
+   GitCommandPool *mCommandPool = nullptr;
+   GitCatFileBatch *mCatFile = nullptr;
+   DiffTreePrefetcher *mFilesPrefetcher = nullptr;
+   // revisions are added to the cache as they are parsed but announced
+   // to the views at most once per frame
+   QTimer mPublishTimer;
+   int mUnpublishedRevs = 0;
+   int mRevsPublishCount = 0;
 };
 
 #endif
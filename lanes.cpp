@@ -6,25 +6,25 @@
         Copyright: See COPYING file that comes with this distribution
 
 */
-#include <QStringList>
+#include <QDataStream>
 #include "lanes.h"
-#include <git.h>
+#include <RevisionsCache.h>
 
 #define IS_NODE(x) (x == (NODE) || x == (NODE_R) || x == (NODE_L))
 
-void Lanes::init(const QString &expectedSha)
+void Lanes::init(int expectedId)
 {
    clear();
    activeLane = 0;
    setBoundary(false);
-   add(LaneType::BRANCH, expectedSha, activeLane);
+   add(LaneType::BRANCH, expectedId, activeLane);
 }
 
 void Lanes::clear()
 {
 
    typeVec.clear();
-   nextShaVec.clear();
+   nextIdVec.clear();
 }
 
 void Lanes::setBoundary(bool b)
@@ -40,28 +40,28 @@ void Lanes::setBoundary(bool b)
       typeVec[activeLane] = (LaneType::BOUNDARY);
 }
 
-bool Lanes::isFork(const QString &sha, bool &isDiscontinuity)
+bool Lanes::isFork(int id, bool &isDiscontinuity)
 {
 
-   int pos = findNextSha(sha, 0);
+   int pos = findNextId(id, 0);
    isDiscontinuity = (activeLane != pos);
    if (pos == -1) // new branch case
       return false;
 
-   return findNextSha(sha, pos + 1) != -1;
+   return findNextId(id, pos + 1) != -1;
 }
 
-void Lanes::setFork(const QString &sha)
+void Lanes::setFork(int id)
 {
 
    int rangeStart, rangeEnd, idx;
-   rangeStart = rangeEnd = idx = findNextSha(sha, 0);
+   rangeStart = rangeEnd = idx = findNextId(id, 0);
 
    while (idx != -1)
    {
       rangeEnd = idx;
       typeVec[idx] = LaneType::TAIL;
-      idx = findNextSha(sha, idx + 1);
+      idx = findNextId(id, idx + 1);
    }
    typeVec[activeLane] = (NODE);
 
@@ -93,7 +93,7 @@ void Lanes::setFork(const QString &sha)
    }
 }
 
-void Lanes::setMerge(const QStringList &parents)
+void Lanes::setMerge(const QVector<int> &parents)
 {
    // setFork() must be called before setMerge()
 
@@ -109,11 +109,11 @@ void Lanes::setMerge(const QStringList &parents)
    t = NODE;
 
    int rangeStart = activeLane, rangeEnd = activeLane;
-   QStringList::const_iterator it(parents.constBegin());
+   QVector<int>::const_iterator it(parents.constBegin());
    for (++it; it != parents.constEnd(); ++it)
    { // skip first parent
 
-      int idx = findNextSha(*it, 0);
+      int idx = findNextId(*it, 0);
       if (idx != -1)
       {
 
@@ -188,7 +188,7 @@ void Lanes::setApplied()
    typeVec[activeLane] = (LaneType::APPLIED); // TODO test with boundaries
 }
 
-void Lanes::changeActiveLane(const QString &sha)
+void Lanes::changeActiveLane(int id)
 {
 
    auto &t = typeVec[activeLane];
@@ -197,11 +197,11 @@ void Lanes::changeActiveLane(const QString &sha)
    else
       t = LaneType::NOT_ACTIVE;
 
-   int idx = findNextSha(sha, 0); // find first sha
+   int idx = findNextId(id, 0); // find first id
    if (idx != -1)
       typeVec[idx] = (LaneType::ACTIVE); // called before setBoundary()
    else
-      idx = add(LaneType::BRANCH, sha, activeLane); // new branch
+      idx = add(LaneType::BRANCH, id, activeLane); // new branch
 
    activeLane = idx;
 }
@@ -248,7 +248,7 @@ void Lanes::afterFork()
    while (typeVec.last() == LaneType::EMPTY)
    {
       typeVec.pop_back();
-      nextShaVec.pop_back();
+      nextIdVec.pop_back();
    }
 }
 
@@ -270,17 +270,56 @@ void Lanes::afterApplied()
    typeVec[activeLane] = (LaneType::ACTIVE); // TODO test with boundaries
 }
 
-void Lanes::nextParent(const QString &sha)
+void Lanes::nextParent(int id)
 {
 
-   nextShaVec[activeLane] = (boundary ? "" : sha);
+   nextIdVec[activeLane] = (boundary ? -1 : id);
 }
 
-int Lanes::findNextSha(const QString &next, int pos)
+void Lanes::step(int id, const QVector<int> &parents, bool isBoundary, bool isApplied, QVector<LaneType> &lanes)
+{
+   // one row of the graph, only ids are involved so it runs on any thread
+   if (isEmpty())
+      init(id);
+
+   bool isDiscontinuity;
+   bool isFork = this->isFork(id, isDiscontinuity);
+   bool isMerge = (parents.count() > 1);
+   bool isInitial = parents.isEmpty();
+
+   if (isDiscontinuity)
+      changeActiveLane(id); // uses previous isBoundary state
+
+   setBoundary(isBoundary); // update must be here
+
+   if (isFork)
+      setFork(id);
+   if (isMerge)
+      setMerge(parents);
+   if (isApplied)
+      setApplied();
+   if (isInitial)
+      setInitial();
+
+   setLanes(lanes); // here lanes are snapshotted
+
+   nextParent(isInitial ? -1 : parents.first());
+
+   if (isApplied)
+      afterApplied();
+   if (isMerge)
+      afterMerge();
+   if (isFork)
+      afterFork();
+   if (isBranch())
+      afterBranch();
+}
+
+int Lanes::findNextId(int next, int pos) const
 {
 
-   for (int i = pos; i < nextShaVec.count(); i++)
-      if (nextShaVec[i] == next)
+   for (int i = pos; i < nextIdVec.count(); i++)
+      if (nextIdVec[i] == next)
          return i;
    return -1;
 }
@@ -294,7 +333,7 @@ int Lanes::findType(const LaneType type, int pos)
    return -1;
 }
 
-int Lanes::add(const LaneType type, const QString &next, int pos)
+int Lanes::add(const LaneType type, int next, int pos)
 {
 
    // first check empty lanes starting from pos
@@ -304,12 +343,71 @@ int Lanes::add(const LaneType type, const QString &next, int pos)
       if (pos != -1)
       {
          typeVec[pos] = (type);
-         nextShaVec[pos] = next;
+         nextIdVec[pos] = next;
          return pos;
       }
    }
    // if all lanes are occupied add a new lane
    typeVec.append((type));
-   nextShaVec.append(next);
+   nextIdVec.append(next);
    return typeVec.count() - 1;
 }
+
+void Lanes::write(QDataStream &stream, const RevisionsCache *cache) const
+{
+   // the state needed to go on with the next row, glyph types of the row
+   // already snapshotted are saved by the caller. Commit ids are only valid
+   // within a session so the SHAs are saved instead.
+   stream << static_cast<qint32>(activeLane);
+   stream << static_cast<qint32>(typeVec.count());
+
+   for (auto type : typeVec)
+      stream << static_cast<quint8>(type);
+
+   QVector<QString> nextShaVec;
+   nextShaVec.reserve(nextIdVec.count());
+
+   for (auto id : nextIdVec)
+      nextShaVec.append(id == -1 ? QString() : cache->commitSha(id));
+
+   stream << nextShaVec;
+   stream << boundary;
+}
+
+bool Lanes::operator==(const Lanes &other) const
+{
+   // same state means the same glyphs for all the rows that follow
+   return activeLane == other.activeLane && boundary == other.boundary && typeVec == other.typeVec
+       && nextIdVec == other.nextIdVec;
+}
+
+void Lanes::read(QDataStream &stream, RevisionsCache *cache)
+{
+   qint32 tmp;
+   stream >> tmp;
+   activeLane = tmp;
+
+   stream >> tmp;
+   typeVec.resize(tmp);
+
+   for (auto i = 0; i < typeVec.count(); ++i)
+   {
+      quint8 type;
+      stream >> type;
+      typeVec[i] = static_cast<LaneType>(type);
+   }
+
+   QVector<QString> nextShaVec;
+   stream >> nextShaVec;
+   stream >> boundary;
+
+   nextIdVec.resize(nextShaVec.count());
+
+   for (auto i = 0; i < nextShaVec.count(); ++i)
+      nextIdVec[i] = nextShaVec.at(i).isEmpty() ? -1 : cache->commitId(nextShaVec.at(i));
+
+   // same as setBoundary() but the active lane type is already restored
+   NODE = boundary ? LaneType::BOUNDARY_C : LaneType::MERGE_FORK;
+   NODE_R = boundary ? LaneType::BOUNDARY_R : LaneType::MERGE_FORK_R;
+   NODE_L = boundary ? LaneType::BOUNDARY_L : LaneType::MERGE_FORK_L;
+}
@@ -10,11 +10,14 @@
 #include <QString>
 #include <QVector>
 
-class QStringList;
+class QDataStream;
+class RevisionsCache;
 
 //
 //  At any given time, the Lanes class represents a single revision (row) of the history graph.
-//  The Lanes class contains a vector of the sha1 hashes of the next commit to appear in each lane (column).
+//  The Lanes class contains a vector of the ids of the next commit to appear in each lane (column). Commits
+//  are identified by the small integers given by RevisionsCache::commitId(), derived from its object id
+//  index, so lanes are matched by an int compare.
 //  The Lanes class also contains a vector used to decide which glyph to draw on the history graph.
 //
 //  For each revision (row) (from recent (top) to ancient past (bottom)), the Lanes class is updated, and the
@@ -23,7 +26,7 @@ class QStringList;
 //  The ListView class is responsible for rendering the glyphs.
 //
 
-enum class LaneType
+enum class LaneType : quint8 // one byte per lane in the lanes pool
 {
    EMPTY,
    ACTIVE,
@@ -90,31 +93,35 @@ class Lanes
 public:
    Lanes() {} // init() will setup us later, when data is available
    bool isEmpty() { return typeVec.empty(); }
-   void init(const QString &expectedSha);
+   void init(int expectedId);
    void clear();
-   bool isFork(const QString &sha, bool &isDiscontinuity);
+   bool isFork(int id, bool &isDiscontinuity);
    void setBoundary(bool isBoundary);
-   void setFork(const QString &sha);
-   void setMerge(const QStringList &parents);
+   void setFork(int id);
+   void setMerge(const QVector<int> &parents);
    void setInitial();
    void setApplied();
-   void changeActiveLane(const QString &sha);
+   void changeActiveLane(int id);
    void afterMerge();
    void afterFork();
    bool isBranch();
    void afterBranch();
    void afterApplied();
-   void nextParent(const QString &sha);
+   void nextParent(int id);
+   void step(int id, const QVector<int> &parents, bool isBoundary, bool isApplied, QVector<LaneType> &lanes);
    void setLanes(QVector<LaneType> &ln) { ln = typeVec; } // O(1) vector is implicitly shared
+   void write(QDataStream &stream, const RevisionsCache *cache) const;
+   void read(QDataStream &stream, RevisionsCache *cache);
+   bool operator==(const Lanes &other) const;
 
 private:
-   int findNextSha(const QString &next, int pos);
+   int findNextId(int next, int pos) const;
    int findType(const LaneType type, int pos);
-   int add(const LaneType type, const QString &next, int pos);
+   int add(const LaneType type, int next, int pos);
 
    int activeLane;
    QVector<LaneType> typeVec; // Describes which glyphs should be drawn.
-   QVector<QString> nextShaVec; // The sha1 hashes of the next commit to appear in each lane (column).
+   QVector<int> nextIdVec; // The ids of the next commit to appear in each lane (column), -1 if none.
    bool boundary;
    LaneType NODE, NODE_L, NODE_R;
 };